@@ -11,7 +11,7 @@ use powersync::{
 use reqwest::StatusCode;
 use rusqlite::{Connection, params};
 use serde::{Deserialize, Serialize};
-use serde_json::{Map, Value};
+use serde_json::value::RawValue;
 use tokio::runtime::Runtime;
 
 pub struct TodoEntry {
@@ -140,7 +140,7 @@ impl BackendConnector for TodoDatabase {
                 op: UpdateType,
                 table: String,
                 id: String,
-                data: Option<Map<String, Value>>,
+                data: Option<Box<RawValue>>,
             }
 
             #[derive(Serialize)]
@@ -0,0 +1,147 @@
+//! Measures local database hot paths: notifying many table listeners, re-running watched queries
+//! and draining the CRUD upload queue.
+
+use std::time::{Duration, Instant};
+
+use criterion::{BenchmarkId, Criterion, Throughput, criterion_group, criterion_main};
+use futures_lite::{StreamExt, future};
+use powersync::PowerSyncDatabase;
+use powersync_test_utils::{DatabaseTest, execute};
+use rusqlite::params;
+
+async fn insert_user(db: &PowerSyncDatabase) {
+    execute(
+        db,
+        "INSERT INTO users (id, name, email) VALUES (uuid(), ?, ?)",
+        params!["user", "user@example.org"],
+    )
+    .await;
+}
+
+/// A write notifying `listeners` table listeners, measured until all of them have been woken.
+fn bench_notify_fan_out(c: &mut Criterion) {
+    let mut group = c.benchmark_group("notify_fan_out");
+
+    for listeners in [1, 10, 100, 1000] {
+        let test = DatabaseTest::quiet();
+        let db = test.in_memory_database();
+        let mut streams: Vec<_> = (0..listeners)
+            .map(|_| db.watch_tables(false, ["users"]).boxed())
+            .collect();
+
+        group.throughput(Throughput::Elements(listeners as u64));
+        group.bench_function(BenchmarkId::from_parameter(listeners), |b| {
+            b.iter(|| {
+                future::block_on(async {
+                    insert_user(&db).await;
+                    for stream in &mut streams {
+                        stream.next().await.unwrap();
+                    }
+                })
+            })
+        });
+    }
+
+    group.finish();
+}
+
+/// The latency between a write and a watched query emitting new results.
+fn bench_watch_requery(c: &mut Criterion) {
+    let mut group = c.benchmark_group("watch_requery");
+
+    for rows in [10, 1000, 10_000] {
+        let test = DatabaseTest::quiet();
+        let db = test.in_memory_database();
+        future::block_on(async {
+            for _ in 0..rows {
+                insert_user(&db).await;
+            }
+        });
+
+        let mut results = db
+            .watch_statement(
+                "SELECT id, name, email FROM users".to_string(),
+                params![],
+                |stmt, params| {
+                    let mut rows = stmt.query(params)?;
+                    let mut count = 0usize;
+                    while rows.next()?.is_some() {
+                        count += 1;
+                    }
+                    Ok(count)
+                },
+            )
+            .boxed_local();
+        future::block_on(results.next()).unwrap().unwrap();
+
+        group.bench_function(BenchmarkId::from_parameter(rows), |b| {
+            b.iter(|| {
+                future::block_on(async {
+                    insert_user(&db).await;
+                    results.next().await.unwrap().unwrap()
+                })
+            })
+        });
+    }
+
+    group.finish();
+}
+
+/// Writes `transactions` local transactions, then measures completing all of them.
+fn drain_crud(transactions: usize, batch_size: Option<usize>) -> Duration {
+    let test = DatabaseTest::quiet();
+    let db = test.in_memory_database();
+
+    future::block_on(async {
+        for _ in 0..transactions {
+            insert_user(&db).await;
+        }
+
+        let started = Instant::now();
+        match batch_size {
+            None => {
+                while let Some(tx) = db.next_crud_transaction().await.unwrap() {
+                    tx.complete().await.unwrap();
+                }
+            }
+            Some(size) => {
+                while let Some(batch) = db.next_crud_batch(size, usize::MAX).await.unwrap() {
+                    batch.complete().await.unwrap();
+                }
+            }
+        }
+        started.elapsed()
+    })
+}
+
+fn bench_crud_drain(c: &mut Criterion) {
+    let mut group = c.benchmark_group("crud_drain");
+    group.sample_size(10);
+
+    let transactions = 1000;
+    group.throughput(Throughput::Elements(transactions as u64));
+    for batch_size in [None, Some(10), Some(100)] {
+        let id = match batch_size {
+            None => "transactions".to_string(),
+            Some(size) => format!("batches_of_{size}"),
+        };
+
+        group.bench_function(id, |b| {
+            b.iter_custom(|iterations| {
+                (0..iterations)
+                    .map(|_| drain_crud(transactions, batch_size))
+                    .sum()
+            })
+        });
+    }
+
+    group.finish();
+}
+
+criterion_group!(
+    benches,
+    bench_notify_fan_out,
+    bench_watch_requery,
+    bench_crud_drain
+);
+criterion_main!(benches);
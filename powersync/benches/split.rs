@@ -0,0 +1,105 @@
+//! Measures splitting HTTP response chunks into BSON objects and NDJSON lines, for varying chunk
+//! sizes.
+
+use std::hint::black_box;
+
+use bytes::Bytes;
+use criterion::{BenchmarkId, Criterion, Throughput, criterion_group, criterion_main};
+use futures_lite::{StreamExt, future, stream};
+use powersync::bench::{BsonObjects, LineSplitter};
+use powersync::error::PowerSyncError;
+use powersync::http::ResponseStream;
+
+const LINES: usize = 10_000;
+
+fn payload(i: usize) -> String {
+    format!(
+        "{{\"id\":\"{i}\",\"description\":\"{}\"}}",
+        "x".repeat(i % 200)
+    )
+}
+
+fn ndjson() -> Vec<u8> {
+    let mut data = Vec::new();
+    for i in 0..LINES {
+        data.extend_from_slice(payload(i).as_bytes());
+        data.push(b'\n');
+    }
+    data
+}
+
+/// Encodes documents of the form `{"data": <payload>}`.
+fn bson() -> Vec<u8> {
+    let mut data = Vec::new();
+    for i in 0..LINES {
+        let value = payload(i);
+        // int32 size, type byte, cstring key, int32 string length, string, nul, terminator.
+        let size = 4 + 1 + 5 + 4 + value.len() + 1 + 1;
+
+        data.extend_from_slice(&(size as i32).to_le_bytes());
+        data.push(0x02);
+        data.extend_from_slice(b"data\0");
+        data.extend_from_slice(&(value.len() as i32 + 1).to_le_bytes());
+        data.extend_from_slice(value.as_bytes());
+        data.push(0);
+        data.push(0);
+    }
+    data
+}
+
+fn chunks(data: &[u8], chunk_size: usize) -> Vec<Bytes> {
+    let data = Bytes::copy_from_slice(data);
+    (0..data.len())
+        .step_by(chunk_size)
+        .map(|start| data.slice(start..data.len().min(start + chunk_size)))
+        .collect()
+}
+
+fn response(chunks: &[Bytes]) -> ResponseStream {
+    Box::pin(stream::iter(chunks.to_vec()).map(Ok::<_, PowerSyncError>))
+}
+
+fn bench_split(c: &mut Criterion) {
+    let ndjson = ndjson();
+    let bson = bson();
+
+    let mut group = c.benchmark_group("split");
+    for chunk_size in [64, 1024, 16 * 1024, 256 * 1024] {
+        group.throughput(Throughput::Bytes(ndjson.len() as u64));
+        group.bench_with_input(
+            BenchmarkId::new("ndjson", chunk_size),
+            &chunks(&ndjson, chunk_size),
+            |b, chunks| {
+                b.iter(|| {
+                    future::block_on(async {
+                        let mut lines = LineSplitter::from(response(chunks));
+                        while let Some(line) = lines.next().await {
+                            black_box(line.unwrap());
+                        }
+                    })
+                })
+            },
+        );
+
+        group.throughput(Throughput::Bytes(bson.len() as u64));
+        group.bench_with_input(
+            BenchmarkId::new("bson", chunk_size),
+            &chunks(&bson, chunk_size),
+            |b, chunks| {
+                b.iter(|| {
+                    future::block_on(async {
+                        let mut objects = BsonObjects::new(response(chunks));
+                        while let Some(object) = objects.next().await {
+                            black_box(object.unwrap());
+                        }
+                    })
+                })
+            },
+        );
+    }
+
+    group.finish();
+}
+
+criterion_group!(benches, bench_split);
+criterion_main!(benches);
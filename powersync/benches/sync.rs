@@ -0,0 +1,135 @@
+//! Measures how fast an initial sync of `buckets` × `rows` is applied when served by the mock sync
+//! service.
+
+use std::time::{Duration, Instant};
+
+use criterion::{BenchmarkId, Criterion, Throughput, criterion_group, criterion_main};
+use futures_lite::{StreamExt, future};
+use powersync::{PowerSyncDatabase, SyncOptions, SyncStatusData};
+use powersync_test_utils::{
+    DatabaseTest,
+    mock_sync_service::{PendingSyncResponse, TestConnector},
+    sync_line::{BucketChecksum, Checkpoint, StreamDescription},
+};
+
+const STREAM: &str = "bench";
+const ROWS_PER_LINE: usize = 100;
+
+async fn wait_for_status(
+    db: &PowerSyncDatabase,
+    mut predicate: impl FnMut(&SyncStatusData) -> bool,
+) {
+    let mut stream = db.watch_status();
+    loop {
+        let status = stream.next().await.unwrap();
+        if predicate(&status) {
+            return;
+        }
+    }
+}
+
+fn checkpoint(buckets: &[&'static str], rows: usize) -> Checkpoint<'static> {
+    Checkpoint {
+        last_op_id: (buckets.len() * rows) as i64,
+        write_checkpoint: None,
+        buckets: buckets
+            .iter()
+            .map(|name| BucketChecksum::with_stream(name, rows as i64, None).1)
+            .collect(),
+        streams: vec![StreamDescription {
+            name: STREAM,
+            is_default: true,
+            errors: vec![],
+        }],
+    }
+}
+
+/// Sends a checkpoint with all data lines, returning once the client has applied it.
+async fn sync_checkpoint(
+    db: &PowerSyncDatabase,
+    request: &PendingSyncResponse,
+    buckets: &[&'static str],
+    rows: usize,
+) {
+    let mut oplog_id = 0;
+    request.send_checkpoint(checkpoint(buckets, rows)).await;
+    for bucket in buckets {
+        let mut remaining = rows;
+        while remaining > 0 {
+            let amount = remaining.min(ROWS_PER_LINE);
+            request.bogus_data_line(&mut oplog_id, bucket, amount).await;
+            remaining -= amount;
+        }
+    }
+
+    // Wait for all lines to be received before completing the checkpoint, so that the status
+    // observed afterwards can't be the one from before the checkpoint.
+    let total = (buckets.len() * rows) as i64;
+    wait_for_status(db, |status| {
+        let stream = db.sync_stream(STREAM, None);
+        status
+            .for_stream(&stream)
+            .and_then(|s| s.progress)
+            .is_some_and(|p| p.downloaded == total)
+    })
+    .await;
+
+    request.send_checkpoint_complete(oplog_id, None).await;
+    wait_for_status(db, |status| !status.is_downloading()).await;
+}
+
+fn initial_sync(test: &DatabaseTest, buckets: &[&'static str], rows: usize) -> Duration {
+    let db = test.in_memory_database();
+    let tasks = db.async_tasks().spawn_with(|f| test.ex.spawn(f));
+
+    let (elapsed, request) = future::block_on(test.ex.run(async {
+        db.connect(SyncOptions::new(TestConnector)).await;
+        let request = test.http.receive_requests.recv().await.unwrap();
+        wait_for_status(&db, |s| s.is_connected()).await;
+
+        let started = Instant::now();
+        sync_checkpoint(&db, &request, buckets, rows).await;
+        (started.elapsed(), request)
+    }));
+
+    // Keep the response stream open until the database is closed, so that the client doesn't
+    // attempt to reconnect.
+    drop(db);
+    future::block_on(test.ex.run(async {
+        for task in tasks {
+            task.await;
+        }
+    }));
+    drop(request);
+
+    elapsed
+}
+
+fn bench_initial_sync(c: &mut Criterion) {
+    let mut group = c.benchmark_group("initial_sync");
+    group.sample_size(10);
+
+    for (buckets, rows) in [(1, 10_000), (10, 1_000), (100, 100)] {
+        let names: Vec<&'static str> = (0..buckets)
+            .map(|i| -> &'static str { format!("bucket_{i}").leak() })
+            .collect();
+
+        group.throughput(Throughput::Elements((buckets * rows) as u64));
+        group.bench_with_input(
+            BenchmarkId::new("ndjson", format!("{buckets}x{rows}")),
+            &names,
+            |b, names| {
+                b.iter_custom(|iterations| {
+                    (0..iterations)
+                        .map(|_| initial_sync(&DatabaseTest::quiet(), names, rows))
+                        .sum()
+                })
+            },
+        );
+    }
+
+    group.finish();
+}
+
+criterion_group!(benches, bench_initial_sync);
+criterion_main!(benches);
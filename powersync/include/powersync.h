@@ -0,0 +1,136 @@
+/*
+ * C API of the PowerSync SDK, available when building the `powersync` crate with the `ffi`
+ * feature.
+ *
+ * Databases are opened from Rust (which configures the environment and runs the sync actors) and
+ * handed to C with `powersync::ffi::database_into_raw`. Unless noted otherwise, functions block
+ * the calling thread until they complete. Functions that can fail return false and, if
+ * `out_error` is not null, write an error message to it that must be freed with
+ * `powersync_string_free`.
+ */
+
+#ifndef POWERSYNC_H
+#define POWERSYNC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct PowerSyncDatabase PowerSyncDatabase;
+typedef struct PowerSyncRows PowerSyncRows;
+typedef struct PowerSyncWatch PowerSyncWatch;
+typedef struct PowerSyncCrudBatch PowerSyncCrudBatch;
+
+typedef uint32_t PowerSyncCellKind;
+
+#define POWERSYNC_CELL_NULL ((PowerSyncCellKind)0)
+#define POWERSYNC_CELL_INTEGER ((PowerSyncCellKind)1)
+#define POWERSYNC_CELL_REAL ((PowerSyncCellKind)2)
+/* UTF-8 text at `value.offset` of the data buffer, followed by a null byte not included in
+ * `length`. */
+#define POWERSYNC_CELL_TEXT ((PowerSyncCellKind)3)
+/* Bytes at `value.offset` of the data buffer. */
+#define POWERSYNC_CELL_BLOB ((PowerSyncCellKind)4)
+
+typedef union PowerSyncCellValue {
+  int64_t integer;
+  double real;
+  size_t offset;
+} PowerSyncCellValue;
+
+/* A single value. Text and blob cells reference a range of a data buffer shared by all cells. */
+typedef struct PowerSyncCell {
+  PowerSyncCellKind kind;
+  /* For text and blob cells, the length of the value in bytes. */
+  size_t length;
+  PowerSyncCellValue value;
+} PowerSyncCell;
+
+/* Parameters bound to `?` placeholders of a statement, in order. */
+typedef struct PowerSyncParameters {
+  const PowerSyncCell *cells;
+  size_t count;
+  const uint8_t *data;
+  size_t data_length;
+} PowerSyncParameters;
+
+/* Limits how often a watched query re-runs. Durations of zero are unset. */
+typedef struct PowerSyncWatchOptions {
+  uint64_t min_interval_ms;
+  uint64_t debounce_ms;
+  uint64_t max_latency_ms;
+} PowerSyncWatchOptions;
+
+typedef enum PowerSyncPoll {
+  /* No new results, the wake callback is invoked once that changes. */
+  POWERSYNC_POLL_PENDING = 0,
+  /* New results have been written to `out_rows`. */
+  POWERSYNC_POLL_READY = 1,
+  /* Running the query failed. The watch can be polled again to wait for the next change. */
+  POWERSYNC_POLL_ERROR = 2,
+  /* No further results will be emitted, the watch should be freed. */
+  POWERSYNC_POLL_CLOSED = 3,
+} PowerSyncPoll;
+
+/* Invoked from any thread when a watch should be polled again. Must not poll or free the watch
+ * itself, but should schedule that on the host's event loop (e.g. by writing to an eventfd). */
+typedef void (*PowerSyncWakeCallback)(void *context);
+
+void powersync_database_free(PowerSyncDatabase *db);
+void powersync_string_free(char *string);
+
+/* Result sets. Cells are stored row by row, so column `c` of row `r` is at
+ * `cells[r * column_count + c]`. All pointers are valid until the rows are freed. */
+size_t powersync_rows_column_count(const PowerSyncRows *rows);
+size_t powersync_rows_row_count(const PowerSyncRows *rows);
+const PowerSyncCell *powersync_rows_column_names(const PowerSyncRows *rows);
+const PowerSyncCell *powersync_rows_cells(const PowerSyncRows *rows);
+const uint8_t *powersync_rows_data(const PowerSyncRows *rows);
+void powersync_rows_free(PowerSyncRows *rows);
+
+/* Runs a SELECT statement on a reader connection. `params` may be null. */
+bool powersync_query(const PowerSyncDatabase *db, const char *sql,
+                     const PowerSyncParameters *params, PowerSyncRows **out_rows,
+                     char **out_error);
+
+/* Runs a statement on the writer connection, ignoring returned rows. */
+bool powersync_execute(const PowerSyncDatabase *db, const char *sql,
+                       const PowerSyncParameters *params, char **out_error);
+
+/* Starts watching a SELECT statement, re-running it when tables it reads from change. Poll the
+ * watch for initial results and again whenever `callback` is invoked. `params` and `options`
+ * may be null. `callback` is not invoked after `powersync_watch_free` returns. */
+bool powersync_watch_statement(const PowerSyncDatabase *db, const char *sql,
+                               const PowerSyncParameters *params,
+                               const PowerSyncWatchOptions *options,
+                               PowerSyncWakeCallback callback, void *context,
+                               PowerSyncWatch **out_watch, char **out_error);
+
+/* Polls a watch without blocking. Must not be called concurrently for the same watch. */
+PowerSyncPoll powersync_watch_poll(PowerSyncWatch *watch, PowerSyncRows **out_rows,
+                                   char **out_error);
+void powersync_watch_free(PowerSyncWatch *watch);
+
+/* Reads the oldest local writes to upload, writing null to `out_batch` if there are none.
+ * Entries have the columns client_id, transaction_id, op, type, id, metadata, data and
+ * previous_values, where data and previous_values are JSON objects. */
+bool powersync_crud_batch_next(const PowerSyncDatabase *db, size_t limit_entries,
+                               size_t limit_bytes, PowerSyncCrudBatch **out_batch,
+                               char **out_error);
+const PowerSyncRows *powersync_crud_batch_entries(const PowerSyncCrudBatch *batch);
+bool powersync_crud_batch_has_more(const PowerSyncCrudBatch *batch);
+
+/* Removes uploaded entries from the local queue. `write_checkpoint` may be null. */
+bool powersync_crud_batch_complete(const PowerSyncCrudBatch *batch,
+                                   const int64_t *write_checkpoint, char **out_error);
+void powersync_crud_batch_free(PowerSyncCrudBatch *batch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* POWERSYNC_H */
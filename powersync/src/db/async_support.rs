@@ -1,4 +1,5 @@
-use futures_lite::future::Boxed;
+use futures_lite::FutureExt;
+use futures_lite::future::{self, Boxed};
 #[cfg(feature = "tokio")]
 use tokio::{runtime::Runtime, spawn, task::JoinHandle};
 
@@ -7,11 +8,20 @@ use tokio::{runtime::Runtime, spawn, task::JoinHandle};
 pub struct AsyncDatabaseTasks {
     download: Boxed<()>,
     upload: Boxed<()>,
+    download_pipeline: Boxed<()>,
 }
 
 impl AsyncDatabaseTasks {
-    pub(crate) fn new(download: Boxed<()>, upload: Boxed<()>) -> Self {
-        Self { download, upload }
+    pub(crate) fn new(
+        download: Boxed<()>,
+        upload: Boxed<()>,
+        download_pipeline: Boxed<()>,
+    ) -> Self {
+        Self {
+            download,
+            upload,
+            download_pipeline,
+        }
     }
 
     /// Spawns pending futures.
@@ -21,7 +31,24 @@ impl AsyncDatabaseTasks {
     /// The futures will complete once all [PowerSyncDatabase]s have been closed, so spawned tasks
     /// don't have to be cancelled or dropped manually.
     pub fn spawn_with<T>(self, mut spawner: impl FnMut(Boxed<()>) -> T) -> Vec<T> {
-        vec![spawner(self.download), spawner(self.upload)]
+        vec![
+            spawner(self.download),
+            spawner(self.upload),
+            spawner(self.download_pipeline),
+        ]
+    }
+
+    /// Combines all tasks into a single future polling them concurrently.
+    ///
+    /// This is useful when hosting many databases on a shared executor (see
+    /// [crate::env::PowerSyncHost]), as it only requires a single task for each database.
+    pub fn join(self) -> Boxed<()> {
+        future::zip(
+            self.download,
+            future::zip(self.upload, self.download_pipeline),
+        )
+        .map(|_| ())
+        .boxed()
     }
 
     /// Spawns pending futures as tokio tasks on the given [Runtime].
@@ -1,9 +1,11 @@
 use crate::error::{PowerSyncError, RawPowerSyncError};
 use num_traits::cast::FromPrimitive;
-use powersync_sqlite_nostd::bindings::sqlite3_open_v2;
+use powersync_sqlite_nostd::bindings::{sqlite3_open_v2, sqlite3_total_changes64};
 use powersync_sqlite_nostd::{Connection, ManagedConnection, ManagedStmt, ResultCode, sqlite3};
+use std::cell::RefCell;
 use std::ffi::{CStr, CString, c_int};
 use std::mem::MaybeUninit;
+use std::ops::Deref;
 use std::path::Path;
 use std::ptr::null;
 
@@ -14,6 +16,11 @@ use std::ptr::null;
 /// feature can be useful when a custom SQLite build (e.g. `sqlite3mc`) needs
 /// to be used with the SDK.
 pub struct SqliteConnection {
+    /// Statements prepared with [Self::prepare_cached].
+    ///
+    /// This is declared before the connection so that statements are finalized before the
+    /// connection is closed.
+    statements: RefCell<StatementCache>,
     #[cfg(not(feature = "rusqlite"))]
     raw: RawSqliteConnection,
     #[cfg(feature = "rusqlite")]
@@ -73,6 +80,97 @@ impl SqliteConnection {
             .into()
         })
     }
+
+    /// Returns the total amount of rows inserted, updated or deleted on this connection since it
+    /// has been opened (including changes made by triggers).
+    pub fn total_changes(&self) -> i64 {
+        unsafe {
+            // Safety: Only reads a counter from the connection.
+            sqlite3_total_changes64(self.handle().cast())
+        }
+    }
+
+    /// Prepares a statement, re-using a previously prepared statement for the same SQL from a
+    /// per-connection cache if possible.
+    ///
+    /// The returned statement is reset and put back into the cache when dropped. This should be
+    /// used for statements that the SDK runs frequently.
+    pub fn prepare_cached(&self, sql: &str) -> Result<CachedStatement<'_>, PowerSyncError> {
+        let cached = self.statements.borrow_mut().take(sql);
+        let entry = match cached {
+            Some(entry) => entry,
+            None => (sql.into(), UnsafeSendStmt(self.prepare(sql)?)),
+        };
+
+        Ok(CachedStatement {
+            conn: self,
+            entry: Some(entry),
+        })
+    }
+}
+
+/// A least-recently-used cache of prepared statements, keyed by their SQL.
+#[derive(Default)]
+struct StatementCache {
+    /// Cached statements, with the most recently used statement last.
+    entries: Vec<(Box<str>, UnsafeSendStmt)>,
+}
+
+impl StatementCache {
+    const CAPACITY: usize = 16;
+
+    /// Removes a statement from the cache so that it can be used.
+    ///
+    /// Statements in use are not part of the cache, so using the same SQL in nested calls prepares
+    /// another statement instead of resetting one that is still in use.
+    fn take(&mut self, sql: &str) -> Option<(Box<str>, UnsafeSendStmt)> {
+        let index = self.entries.iter().rposition(|(key, _)| &**key == sql)?;
+        Some(self.entries.remove(index))
+    }
+
+    fn put(&mut self, entry: (Box<str>, UnsafeSendStmt)) {
+        if self.entries.len() >= Self::CAPACITY {
+            // Evict the least recently used statement, which finalizes it.
+            self.entries.remove(0);
+        }
+
+        self.entries.push(entry);
+    }
+}
+
+/// A [ManagedStmt] owned by a [StatementCache].
+struct UnsafeSendStmt(ManagedStmt);
+
+// Safety: Cached statements are only accessed through the [SqliteConnection] owning them, which
+// can't be used concurrently.
+unsafe impl Send for UnsafeSendStmt {}
+
+/// A statement taken from the statement cache of a [SqliteConnection], see
+/// [SqliteConnection::prepare_cached].
+pub struct CachedStatement<'a> {
+    conn: &'a SqliteConnection,
+    entry: Option<(Box<str>, UnsafeSendStmt)>,
+}
+
+impl Deref for CachedStatement<'_> {
+    type Target = ManagedStmt;
+
+    fn deref(&self) -> &Self::Target {
+        &self.entry.as_ref().unwrap().1.0
+    }
+}
+
+impl Drop for CachedStatement<'_> {
+    fn drop(&mut self) {
+        if let Some(entry) = self.entry.take() {
+            let stmt = &entry.1.0;
+            // Reset the statement to release locks, and clear bindings since they may reference
+            // values that are about to be dropped.
+            if stmt.reset().is_ok() && stmt.clear_bindings().is_ok() {
+                self.conn.statements.borrow_mut().put(entry);
+            }
+        }
+    }
 }
 
 /// Utility for running a block in a transaction.
@@ -101,6 +199,12 @@ impl<'a> TransactionGuard<'a> {
         self.inner.exec(c"COMMIT")
     }
 
+    /// Leaves the transaction open without rolling it back, for callers that take over its
+    /// management.
+    pub fn disarm(mut self) {
+        self.active = false;
+    }
+
     fn rollback_internal(&mut self) -> Result<(), PowerSyncError> {
         self.inner.exec(c"ROLLBACK")
     }
@@ -118,14 +222,20 @@ impl Drop for TransactionGuard<'_> {
 #[cfg(feature = "rusqlite")]
 impl From<rusqlite::Connection> for SqliteConnection {
     fn from(value: rusqlite::Connection) -> Self {
-        Self { inner: value }
+        Self {
+            statements: Default::default(),
+            inner: value,
+        }
     }
 }
 
 #[cfg(not(feature = "rusqlite"))]
 impl From<RawSqliteConnection> for SqliteConnection {
     fn from(value: RawSqliteConnection) -> Self {
-        Self { raw: value }
+        Self {
+            statements: Default::default(),
+            raw: value,
+        }
     }
 }
 
@@ -138,6 +248,7 @@ impl From<RawSqliteConnection> for SqliteConnection {
         let _ = std::mem::ManuallyDrop::new(value.0);
 
         Self {
+            statements: Default::default(),
             inner: unsafe {
                 // Safety: The never dropped ManuallyDrop transfers ownership from the
                 // RawSqliteConnection to rusqlite.
@@ -181,7 +292,7 @@ impl RawSqliteConnection {
     }
 }
 
-pub fn exec_stmt(stmt: ManagedStmt) -> Result<(), PowerSyncError> {
+pub fn exec_stmt(stmt: &ManagedStmt) -> Result<(), PowerSyncError> {
     while let ResultCode::ROW = stmt.step().map_err(|e| RawPowerSyncError::RawSqlite {
         code: e,
         context: format!("Stepping through {}", stmt.sql().unwrap_or("unknown SQL")),
@@ -211,3 +322,64 @@ fn path_to_cstring(p: &Path) -> Result<CString, PowerSyncError> {
         })?,
     )
 }
+
+#[cfg(all(test, feature = "rusqlite"))]
+mod test {
+    use powersync_sqlite_nostd::ResultCode;
+
+    use super::SqliteConnection;
+
+    fn in_memory() -> SqliteConnection {
+        rusqlite::Connection::open_in_memory().unwrap().into()
+    }
+
+    #[test]
+    fn cached_statements_are_reset() {
+        let conn = in_memory();
+        {
+            let stmt = conn.prepare_cached("SELECT ? IS NULL").unwrap();
+            stmt.bind_int64(1, 1).unwrap();
+            assert_eq!(stmt.step().unwrap(), ResultCode::ROW);
+            assert_eq!(stmt.column_int64(0), 0);
+        }
+
+        let stmt = conn.prepare_cached("SELECT ? IS NULL").unwrap();
+        assert_eq!(stmt.step().unwrap(), ResultCode::ROW);
+        assert_eq!(stmt.column_int64(0), 1);
+    }
+
+    #[test]
+    fn nested_use_of_cached_statement() {
+        let conn = in_memory();
+        let outer = conn.prepare_cached("SELECT 1").unwrap();
+        let inner = conn.prepare_cached("SELECT 1").unwrap();
+
+        assert_eq!(outer.step().unwrap(), ResultCode::ROW);
+        assert_eq!(inner.step().unwrap(), ResultCode::ROW);
+    }
+
+    #[test]
+    fn evicts_least_recently_used() {
+        let conn = in_memory();
+        for i in 0..32 {
+            let stmt = conn.prepare_cached(&format!("SELECT {i}")).unwrap();
+            assert_eq!(stmt.step().unwrap(), ResultCode::ROW);
+            assert_eq!(stmt.column_int64(0), i);
+        }
+
+        assert_eq!(conn.statements.borrow().entries.len(), 16);
+    }
+
+    #[test]
+    fn total_changes() {
+        let conn = in_memory();
+        conn.exec(c"CREATE TABLE foo (bar TEXT)").unwrap();
+        assert_eq!(conn.total_changes(), 0);
+
+        conn.exec(c"SELECT * FROM foo").unwrap();
+        assert_eq!(conn.total_changes(), 0);
+
+        conn.exec(c"INSERT INTO foo VALUES ('a'), ('b')").unwrap();
+        assert_eq!(conn.total_changes(), 2);
+    }
+}
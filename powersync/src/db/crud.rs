@@ -1,13 +1,16 @@
+use std::mem::take;
 use std::pin::Pin;
 use std::task::{Context, Poll};
 
 use futures_lite::{FutureExt, Stream, ready};
 use pin_project_lite::pin_project;
-use powersync_sqlite_nostd::ResultCode;
+use powersync_sqlite_nostd::{ColumnType, ManagedStmt, ResultCode};
 use serde::{Deserialize, Serialize};
+use serde_json::value::RawValue;
 use serde_json::{Map, Value};
 
 use crate::PowerSyncDatabase;
+use crate::db::connection::SqliteConnection;
 use crate::error::PowerSyncError;
 
 /// All local writes that were made in a single SQLite transaction.
@@ -42,13 +45,75 @@ impl<'a> CrudTransaction<'a> {
     }
 }
 
+/// Local writes spanning one or more complete transactions, returned by
+/// [PowerSyncDatabase::next_crud_batch].
+///
+/// This allows connectors to upload many small transactions with a single request to their
+/// backend.
+pub struct CrudBatch<'a> {
+    pub(crate) db: &'a PowerSyncDatabase,
+    pub last_item_id: i64,
+    /// Whether further transactions were left out of this batch due to its limits.
+    pub has_more: bool,
+    /// List of client-side changes, ordered by [CrudEntry::client_id].
+    ///
+    /// Entries of a transaction are never split across batches.
+    pub crud: Vec<CrudEntry>,
+}
+
+impl<'a> CrudBatch<'a> {
+    /// Call to remove all changes in this batch from the local queue, once successfully
+    /// uploaded.
+    pub async fn complete(self) -> Result<(), PowerSyncError> {
+        self.complete_internal(None).await
+    }
+
+    /// Call to remove all changes in this batch from the local queue, once successfully
+    /// uploaded.
+    pub async fn complete_with_checkpoint(self, checkpoint: i64) -> Result<(), PowerSyncError> {
+        self.complete_internal(Some(checkpoint)).await
+    }
+
+    async fn complete_internal(self, checkpoint: Option<i64>) -> Result<(), PowerSyncError> {
+        self.db
+            .inner
+            .complete_crud_items(self.last_item_id, checkpoint)
+            .await
+    }
+
+    /// Reads whole transactions from `ps_crud` until adding the next transaction would exceed
+    /// `limit_entries` or `limit_bytes` (measured as the size of the JSON data of each entry).
+    ///
+    /// The first transaction is always included, even if it exceeds the limits on its own.
+    pub(crate) async fn next(
+        db: &'a PowerSyncDatabase,
+        limit_entries: usize,
+        limit_bytes: usize,
+    ) -> Result<Option<Self>, PowerSyncError> {
+        let (crud, has_more) = db
+            .inner
+            .read_blocking(move |reader| {
+                CrudEntry::read_batch(reader.sqlite_connection(), limit_entries, limit_bytes)
+            })
+            .await?;
+
+        Ok(crud.last().map(|last| CrudBatch {
+            db,
+            last_item_id: last.client_id,
+            has_more,
+            crud,
+        }))
+    }
+}
+
 /// A single client-side change.
 pub struct CrudEntry {
     /// Auto-incrementing client-side id.
     ///
     /// Reset whenever the database is re-created.
     pub client_id: i64,
-    /// Auto-incrementing transaction id.
+    /// Auto-incrementing transaction id, or `0` for changes recorded without an explicit
+    /// transaction.
     ///
     /// Reset whenever the database is re-created.
     pub transaction_id: i64,
@@ -71,32 +136,37 @@ pub struct CrudEntry {
     /// For PATCH, this contains the columns that changed.
     ///
     /// For DELETE, this is null.
-    pub data: Option<Map<String, Value>>,
-    /// Old values before an update.
+    ///
+    /// This is the raw JSON object as stored in `ps_crud`, so that connectors can forward it to
+    /// their backend without parsing it. Use [Self::parsed_data] to parse it into a map, which is
+    /// what this field contained before version 0.0.6.
+    pub data: Option<Box<RawValue>>,
+    /// Old values before an update, as a raw JSON object.
     ///
     /// This is only tracked for tables for which this has been enabled by setting
-    /// the [Table::track_previous_values].
-    pub previous_values: Option<Map<String, Value>>,
+    /// the [Table::track_previous_values]. Use [Self::parsed_previous_values] to parse it into a
+    /// map, which is what this field contained before version 0.0.6.
+    pub previous_values: Option<Box<RawValue>>,
 }
 
 impl CrudEntry {
-    fn parse(id: i64, tx_id: i64, data: &str) -> Result<Self, PowerSyncError> {
+    fn parse(id: i64, tx_id: Option<i64>, data: &str) -> Result<Self, PowerSyncError> {
         #[derive(Deserialize)]
         struct CrudData {
             op: UpdateType,
             #[serde(rename = "type")]
             table: String,
             id: String,
-            data: Option<Map<String, Value>>,
+            data: Option<Box<RawValue>>,
             metadata: Option<String>,
-            old: Option<Map<String, Value>>,
+            old: Option<Box<RawValue>>,
         }
 
         let data: CrudData = serde_json::from_str(data)?;
 
         Ok(Self {
             client_id: id,
-            transaction_id: tx_id,
+            transaction_id: tx_id.unwrap_or(0),
             update_type: data.op,
             table: data.table,
             id: data.id,
@@ -105,6 +175,124 @@ impl CrudEntry {
             previous_values: data.old,
         })
     }
+
+    /// Reads entries of whole transactions for a [CrudBatch], returning them along with whether
+    /// further transactions were left out due to the limits.
+    fn read_batch(
+        conn: &SqliteConnection,
+        limit_entries: usize,
+        limit_bytes: usize,
+    ) -> Result<(Vec<Self>, bool), PowerSyncError> {
+        let stmt = conn.prepare_cached("SELECT id, tx_id, data FROM ps_crud ORDER BY id")?;
+
+        let mut crud = vec![];
+        let mut bytes = 0;
+        // Entries of the transaction currently being read, which are only added to the batch once
+        // the transaction is complete.
+        let mut pending = Vec::<CrudEntry>::new();
+        let mut pending_tx = None::<i64>;
+        let mut pending_bytes = 0;
+        let mut has_more = false;
+
+        loop {
+            let row = match stmt.step()? {
+                ResultCode::ROW => Some((stmt.column_int64(0), Self::read_tx_id(&stmt, 1)?)),
+                _ => None,
+            };
+
+            if !pending.is_empty()
+                && row.is_none_or(|(_, tx_id)| !Self::in_transaction(pending_tx, tx_id))
+            {
+                crud.append(&mut pending);
+                bytes += take(&mut pending_bytes);
+            }
+
+            let Some((id, tx_id)) = row else {
+                break;
+            };
+            let data = stmt.column_text(2)?;
+
+            // Stop as soon as the current transaction is known not to fit into this batch.
+            if !crud.is_empty()
+                && (crud.len() + pending.len() >= limit_entries
+                    || bytes + pending_bytes + data.len() > limit_bytes)
+            {
+                has_more = true;
+                break;
+            }
+
+            pending_tx = tx_id;
+            pending_bytes += data.len();
+            pending.push(CrudEntry::parse(id, tx_id, data)?);
+        }
+
+        Ok((crud, has_more))
+    }
+
+    /// Reads the `tx_id` column of `ps_crud`, which is `NULL` for entries recorded without an
+    /// explicit transaction.
+    fn read_tx_id(stmt: &ManagedStmt, column: i32) -> Result<Option<i64>, PowerSyncError> {
+        Ok(match stmt.column_type(column)? {
+            ColumnType::Null => None,
+            _ => Some(stmt.column_int64(column)),
+        })
+    }
+
+    /// Whether an entry with `tx_id` belongs to the transaction `current`.
+    ///
+    /// Entries without a transaction id are transactions of their own.
+    fn in_transaction(current: Option<i64>, tx_id: Option<i64>) -> bool {
+        current.is_some() && current == tx_id
+    }
+
+    /// Reads entries of the first transaction after the entry with the id `last`, along with the
+    /// ids of its last entry and the transaction.
+    fn read_transaction(
+        conn: &SqliteConnection,
+        last: i64,
+    ) -> Result<(Vec<Self>, Option<(i64, Option<i64>)>), PowerSyncError> {
+        // A range scan over the rowid of `ps_crud`, which is stopped after the first transaction.
+        let stmt =
+            conn.prepare_cached("SELECT id, tx_id, data FROM ps_crud WHERE id > ? ORDER BY id")?;
+        stmt.bind_int64(1, last)?;
+
+        let mut crud_entries = vec![];
+        let mut last = None::<(i64, Option<i64>)>;
+
+        while let ResultCode::ROW = stmt.step()? {
+            let id = stmt.column_int64(0);
+            let tx_id = Self::read_tx_id(&stmt, 1)?;
+            if let Some((_, current_tx)) = last
+                && !Self::in_transaction(current_tx, tx_id)
+            {
+                // We've reached the first entry of the next transaction.
+                break;
+            }
+
+            let data = stmt.column_text(2)?;
+            last = Some((id, tx_id));
+            crud_entries.push(CrudEntry::parse(id, tx_id, data)?);
+        }
+
+        Ok((crud_entries, last))
+    }
+
+    /// Parses [Self::data] into a JSON map.
+    pub fn parsed_data(&self) -> Result<Option<Map<String, Value>>, PowerSyncError> {
+        Self::parse_object(self.data.as_deref())
+    }
+
+    /// Parses [Self::previous_values] into a JSON map.
+    pub fn parsed_previous_values(&self) -> Result<Option<Map<String, Value>>, PowerSyncError> {
+        Self::parse_object(self.previous_values.as_deref())
+    }
+
+    fn parse_object(raw: Option<&RawValue>) -> Result<Option<Map<String, Value>>, PowerSyncError> {
+        Ok(match raw {
+            Some(raw) => Some(serde_json::from_str(raw.get())?),
+            None => None,
+        })
+    }
 }
 
 /// Type of local change.
@@ -121,6 +309,94 @@ pub enum UpdateType {
     Delete,
 }
 
+/// Transactions read ahead by pipelined uploads (see [crate::SyncOptions::with_pipelined_upload])
+/// while the connector is uploading the transaction before them.
+///
+/// A prefetched transaction is only returned by [PowerSyncDatabase::next_crud_transaction] once
+/// the transaction before it has been completed, since it is the oldest transaction from then on:
+/// Entries are immutable and new entries always have larger ids.
+#[derive(Default)]
+pub(crate) struct CrudPrefetch {
+    current: std::sync::Mutex<PrefetchState>,
+}
+
+#[derive(Default)]
+struct PrefetchState {
+    /// The `last_item_id` of the transaction completed most recently.
+    completed: Option<i64>,
+    transactions: Vec<PrefetchedTransaction>,
+}
+
+pub(crate) struct PrefetchedTransaction {
+    /// The last entry of the transaction before this one.
+    after: i64,
+    id: Option<i64>,
+    last_item_id: i64,
+    crud: Vec<CrudEntry>,
+}
+
+impl CrudPrefetch {
+    /// Reads the transaction following the oldest one, to be returned after the oldest one has
+    /// been completed.
+    pub fn read(conn: &SqliteConnection) -> Result<Option<PrefetchedTransaction>, PowerSyncError> {
+        let (_, Some((after, _))) = CrudEntry::read_transaction(conn, -1)? else {
+            return Ok(None);
+        };
+        let (crud, Some((last_item_id, tx_id))) = CrudEntry::read_transaction(conn, after)? else {
+            return Ok(None);
+        };
+
+        Ok(Some(PrefetchedTransaction {
+            after,
+            id: tx_id,
+            last_item_id,
+            crud,
+        }))
+    }
+
+    pub fn store(&self, transaction: PrefetchedTransaction) {
+        let mut state = self.current.lock().unwrap();
+        // Transactions before the last completed one have been completed too.
+        if state
+            .completed
+            .is_some_and(|completed| transaction.after < completed)
+            || state
+                .transactions
+                .iter()
+                .any(|t| t.after == transaction.after)
+        {
+            return;
+        }
+
+        state.transactions.push(transaction);
+    }
+
+    /// Called after entries up until `last_item_id` (inclusive) have been removed from `ps_crud`.
+    pub fn completed(&self, last_item_id: i64) {
+        let mut state = self.current.lock().unwrap();
+        state.completed = Some(last_item_id);
+        state.transactions.retain(|t| t.after >= last_item_id);
+    }
+
+    /// Returns the prefetched transaction following the last completed one, if there is one.
+    pub fn take_oldest<'a>(&self, db: &'a PowerSyncDatabase) -> Option<CrudTransaction<'a>> {
+        let mut state = self.current.lock().unwrap();
+        let completed = state.completed?;
+        let index = state
+            .transactions
+            .iter()
+            .position(|t| t.after == completed)?;
+        let transaction = state.transactions.swap_remove(index);
+
+        Some(CrudTransaction {
+            db,
+            last_item_id: transaction.last_item_id,
+            id: transaction.id,
+            crud: transaction.crud,
+        })
+    }
+}
+
 type Boxed<'a, T> = Pin<Box<dyn Future<Output = T> + Send + 'a>>;
 
 pin_project! {
@@ -146,27 +422,17 @@ impl<'a> CrudTransactionStream<'a> {
         last: Option<i64>,
     ) -> Result<Option<(i64, CrudTransaction<'a>)>, PowerSyncError> {
         let last = last.unwrap_or(-1);
-        let reader = db.reader().await?;
-        let conn = reader.sqlite_connection();
-        let stmt = conn.prepare(Self::SQL)?;
-        stmt.bind_int64(1, last)?;
-
-        let mut crud_entries = vec![];
-        let mut last = None::<(i64, i64)>;
-
-        while let ResultCode::ROW = stmt.step()? {
-            let id = stmt.column_int64(0);
-            let tx_id = stmt.column_int64(1);
-            let data = stmt.column_text(2)?;
-
-            last = Some((id, tx_id));
-            crud_entries.push(CrudEntry::parse(id, tx_id, data)?);
-        }
+        let (crud_entries, last) = db
+            .inner
+            .read_blocking(move |reader| {
+                CrudEntry::read_transaction(reader.sqlite_connection(), last)
+            })
+            .await?;
 
         Ok(if let Some((id, tx_id)) = last {
             let tx = CrudTransaction {
                 db,
-                id: Some(tx_id),
+                id: tx_id,
                 last_item_id: id,
                 crud: crud_entries,
             };
@@ -176,17 +442,6 @@ impl<'a> CrudTransactionStream<'a> {
             None
         })
     }
-
-    const SQL: &'static str = "
-WITH RECURSIVE crud_entries AS (
-  SELECT id, tx_id, data FROM ps_crud WHERE id = (SELECT min(id) FROM ps_crud WHERE id > ?)
-  UNION ALL
-  SELECT ps_crud.id, ps_crud.tx_id, ps_crud.data FROM ps_crud
-    INNER JOIN crud_entries ON crud_entries.id + 1 = rowid
-  WHERE crud_entries.tx_id = ps_crud.tx_id
-)
-SELECT * FROM crud_entries;
-";
 }
 
 impl<'a> Stream for CrudTransactionStream<'a> {
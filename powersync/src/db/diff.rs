@@ -0,0 +1,214 @@
+use std::collections::HashMap;
+use std::hash::{DefaultHasher, Hash, Hasher};
+
+use rusqlite::{
+    Params, Row, Statement,
+    types::{Value, ValueRef},
+};
+
+use crate::error::PowerSyncError;
+
+/// Changes to the results of a query between two runs, as emitted by
+/// [crate::PowerSyncDatabase::watch_statement_diff].
+///
+/// Rows are identified by a key column, which can have any SQLite type. Since only changed rows are
+/// reported, the order of rows in the query is not preserved.
+#[derive(Debug)]
+pub struct QueryDiff<T> {
+    /// Rows with a key that was not part of the previous results.
+    pub added: Vec<T>,
+    /// Rows with a key that was part of the previous results, but with different values.
+    pub updated: Vec<T>,
+    /// Keys of rows that were part of the previous results, but no longer are.
+    pub removed: Vec<Value>,
+}
+
+impl<T> QueryDiff<T> {
+    /// Whether the results have not changed.
+    pub fn is_empty(&self) -> bool {
+        self.added.is_empty() && self.updated.is_empty() && self.removed.is_empty()
+    }
+}
+
+/// The keys and row hashes of the results last emitted by a diffing watch.
+#[derive(Default)]
+pub(crate) struct ResultSnapshot {
+    rows: Option<HashMap<RowKey, u64>>,
+}
+
+/// A value of the key column, compared and hashed by its SQLite type and value.
+///
+/// Real values are compared by their bits so that keys are consistent with their hash.
+struct RowKey(Value);
+
+impl PartialEq for RowKey {
+    fn eq(&self, other: &Self) -> bool {
+        match (&self.0, &other.0) {
+            (Value::Real(a), Value::Real(b)) => a.to_bits() == b.to_bits(),
+            (a, b) => a == b,
+        }
+    }
+}
+
+impl Eq for RowKey {}
+
+impl Hash for RowKey {
+    fn hash<H: Hasher>(&self, state: &mut H) {
+        ResultSnapshot::hash_value(ValueRef::from(&self.0), state);
+    }
+}
+
+impl ResultSnapshot {
+    /// Runs the statement and compares its results with the previous run.
+    ///
+    /// `map` is only invoked for added or updated rows. Returns [None] if the results are
+    /// identical to the previous run. The first run always returns a diff, reporting all rows as
+    /// added.
+    pub fn update<T>(
+        &mut self,
+        stmt: &mut Statement,
+        params: impl Params,
+        key_column: &str,
+        map: impl Fn(&Row) -> Result<T, PowerSyncError>,
+    ) -> Result<Option<QueryDiff<T>>, PowerSyncError> {
+        let column_count = stmt.column_count();
+        let key_index = stmt.column_index(key_column)?;
+        let no_rows = HashMap::new();
+        let previous = self.rows.as_ref().unwrap_or(&no_rows);
+
+        let mut rows = stmt.query(params)?;
+        let mut current = HashMap::with_capacity(previous.len());
+        let mut diff = QueryDiff {
+            added: vec![],
+            updated: vec![],
+            removed: vec![],
+        };
+
+        while let Some(row) = rows.next()? {
+            let key = RowKey(row.get_ref(key_index)?.into());
+            let hash = Self::hash_row(row, column_count)?;
+
+            match previous.get(&key) {
+                None => diff.added.push(map(row)?),
+                Some(previous) if *previous != hash => diff.updated.push(map(row)?),
+                Some(_) => {}
+            }
+
+            current.insert(key, hash);
+        }
+
+        diff.removed = previous
+            .keys()
+            .filter(|key| !current.contains_key(*key))
+            .map(|key| key.0.clone())
+            .collect();
+        let is_initial = self.rows.replace(current).is_none();
+
+        Ok((is_initial || !diff.is_empty()).then_some(diff))
+    }
+
+    fn hash_row(row: &Row, column_count: usize) -> Result<u64, PowerSyncError> {
+        let mut hasher = DefaultHasher::new();
+        for i in 0..column_count {
+            Self::hash_value(row.get_ref(i)?, &mut hasher);
+        }
+
+        Ok(hasher.finish())
+    }
+
+    fn hash_value(value: ValueRef, hasher: &mut impl Hasher) {
+        match value {
+            ValueRef::Null => 0u8.hash(hasher),
+            ValueRef::Integer(value) => (1u8, value).hash(hasher),
+            ValueRef::Real(value) => (2u8, value.to_bits()).hash(hasher),
+            ValueRef::Text(value) => (3u8, value).hash(hasher),
+            ValueRef::Blob(value) => (4u8, value).hash(hasher),
+        }
+    }
+}
+
+#[cfg(test)]
+mod test {
+    use rusqlite::{Connection, params, types::Value};
+
+    use super::ResultSnapshot;
+    use crate::error::PowerSyncError;
+
+    fn names(
+        conn: &Connection,
+        snapshot: &mut ResultSnapshot,
+    ) -> Option<(Vec<String>, Vec<String>, Vec<Value>)> {
+        let mut stmt = conn.prepare("SELECT id, name FROM users").unwrap();
+        let diff = snapshot
+            .update(&mut stmt, params![], "id", |row| {
+                Ok::<String, PowerSyncError>(row.get(1)?)
+            })
+            .unwrap()?;
+
+        let mut removed = diff.removed;
+        removed.sort_by_key(|key| format!("{key:?}"));
+        Some((diff.added, diff.updated, removed))
+    }
+
+    #[test]
+    fn diffs_results() {
+        let conn = Connection::open_in_memory().unwrap();
+        conn.execute_batch(
+            "CREATE TABLE users (id TEXT PRIMARY KEY, name TEXT);
+             INSERT INTO users VALUES ('1', 'a'), ('2', 'b'), ('3', 'c');",
+        )
+        .unwrap();
+
+        let mut snapshot = ResultSnapshot::default();
+        let (added, updated, removed) = names(&conn, &mut snapshot).unwrap();
+        assert_eq!(added, ["a", "b", "c"]);
+        assert!(updated.is_empty());
+        assert!(removed.is_empty());
+
+        // Identical results are suppressed.
+        assert!(names(&conn, &mut snapshot).is_none());
+
+        conn.execute_batch(
+            "UPDATE users SET name = 'B' WHERE id = '2';
+             DELETE FROM users WHERE id IN ('1', '3');
+             INSERT INTO users VALUES ('4', 'd');",
+        )
+        .unwrap();
+        let (added, updated, removed) = names(&conn, &mut snapshot).unwrap();
+        assert_eq!(added, ["d"]);
+        assert_eq!(updated, ["B"]);
+        assert_eq!(removed, [Value::Text("1".into()), Value::Text("3".into())]);
+    }
+
+    #[test]
+    fn distinguishes_key_types() {
+        let conn = Connection::open_in_memory().unwrap();
+        conn.execute_batch(
+            "CREATE TABLE users (id, name TEXT);
+             INSERT INTO users VALUES (1, 'integer'), ('1', 'text'), (X'01', 'blob');",
+        )
+        .unwrap();
+
+        let mut snapshot = ResultSnapshot::default();
+        let (added, _, _) = names(&conn, &mut snapshot).unwrap();
+        assert_eq!(added.len(), 3);
+
+        conn.execute("DELETE FROM users WHERE id = 1", params![])
+            .unwrap();
+        let (added, updated, removed) = names(&conn, &mut snapshot).unwrap();
+        assert!(added.is_empty() && updated.is_empty());
+        assert_eq!(removed, [Value::Integer(1)]);
+    }
+
+    #[test]
+    fn emits_initial_empty_results() {
+        let conn = Connection::open_in_memory().unwrap();
+        conn.execute_batch("CREATE TABLE users (id TEXT PRIMARY KEY, name TEXT);")
+            .unwrap();
+
+        let mut snapshot = ResultSnapshot::default();
+        let (added, updated, removed) = names(&conn, &mut snapshot).unwrap();
+        assert!(added.is_empty() && updated.is_empty() && removed.is_empty());
+        assert!(names(&conn, &mut snapshot).is_none());
+    }
+}
@@ -2,18 +2,23 @@ use crate::db::connection::{SqliteConnection, TransactionGuard, exec_stmt};
 use crate::schema::SchemaOrCustom;
 use crate::{
     db::{
-        core_extension::CoreExtensionVersion, pool::LeasedConnection, streams::SyncStreamTracker,
+        core_extension::CoreExtensionVersion, crud::CrudPrefetch, pool::LeasedConnection,
+        snapshot::SharedSnapshot, streams::SyncStreamTracker, writer_lock::WriterPriority,
     },
     env::PowerSyncEnvironment,
     error::PowerSyncError,
-    sync::{MAX_OP_ID, coordinator::SyncCoordinator, status::SyncStatus, status::SyncStatusData},
+    sync::{
+        MAX_OP_ID, coordinator::SyncCoordinator, credentials::CredentialsCache,
+        download::StartPayloadCache, options::ReconnectPolicy, status::SyncStatus,
+        status::SyncStatusData,
+    },
     util::SharedFuture,
 };
 use event_listener::EventListener;
 use futures_lite::{FutureExt, Stream, StreamExt, ready};
 use powersync_sqlite_nostd::{Destructor, ResultCode};
-use std::sync::{Mutex, Weak};
-use std::time::Duration;
+use serde_json::value::RawValue;
+use std::sync::{Mutex, OnceLock, Weak};
 use std::{
     pin::Pin,
     sync::Arc,
@@ -25,6 +30,9 @@ pub struct InnerPowerSyncState {
     pub env: PowerSyncEnvironment,
     /// Whether the database has been initialized.
     did_initialize: SharedFuture<Result<(), PowerSyncError>>,
+    /// Whether readers can be used, which doesn't require initializing the database if its
+    /// schema is up-to-date.
+    did_initialize_readers: SharedFuture<Result<(), PowerSyncError>>,
     /// The schema passed to the database.
     ///
     /// This is forwarded to the sync client for raw tables.
@@ -37,7 +45,15 @@ pub struct InnerPowerSyncState {
     /// reference to [InnerPowerSyncState], we only keep a weak reference here to ensure we can drop
     /// actors through the channels owned by [SyncCoordinator].
     pub(crate) sync: Weak<SyncCoordinator>,
-    pub(crate) retry_delay: Mutex<Option<Duration>>,
+    pub(crate) reconnect_policy: Mutex<Option<ReconnectPolicy>>,
+    /// Credentials shared by the upload and download actors.
+    pub(crate) credentials: CredentialsCache,
+    /// The [Self::schema] serialized to JSON, see [Self::serialized_schema].
+    serialized_schema: OnceLock<Arc<RawValue>>,
+    /// The payload of the last `start` event of the sync client.
+    pub(crate) start_payload: StartPayloadCache,
+    /// Transactions read ahead by pipelined uploads.
+    pub(crate) crud_prefetch: CrudPrefetch,
 }
 
 impl InnerPowerSyncState {
@@ -49,10 +65,15 @@ impl InnerPowerSyncState {
         Self {
             env,
             did_initialize: SharedFuture::new(),
+            did_initialize_readers: SharedFuture::new(),
             schema: Arc::new(schema),
             status: SyncStatus::new(),
             current_streams: SyncStreamTracker::default(),
-            retry_delay: Default::default(),
+            reconnect_policy: Default::default(),
+            credentials: Default::default(),
+            serialized_schema: OnceLock::new(),
+            start_payload: Default::default(),
+            crud_prefetch: Default::default(),
             sync: Arc::downgrade(sync),
         }
     }
@@ -61,13 +82,13 @@ impl InnerPowerSyncState {
         let pool = &self.env.pool;
         self.did_initialize
             .run(|| async {
-                let conn = pool.writer().await;
-                let conn = conn.sqlite_connection();
-                CoreExtensionVersion::check_from_db(conn)?;
+                let mut conn = pool.writer().await;
+                let version = CoreExtensionVersion::check_from_db(conn.sqlite_connection())?;
 
-                conn.exec(c"SELECT powersync_init()")?;
+                conn.sqlite_connection().exec(c"SELECT powersync_init()")?;
 
-                self.update_schema_internal(conn)?;
+                self.update_schema_internal(conn.sqlite_connection_mut(), &version)?;
+                let conn = conn.sqlite_connection();
                 self.status.update(|old| old.resolve_offline_state(conn))?;
 
                 Ok(())
@@ -76,22 +97,141 @@ impl InnerPowerSyncState {
             .clone()
     }
 
-    fn update_schema_internal(&self, conn: &SqliteConnection) -> Result<(), PowerSyncError> {
+    /// Prepares the database for readers.
+    ///
+    /// If the database has been initialized with the current schema before, readers can use it
+    /// right away instead of waiting for [Self::initialize] to lease the writer, which may be
+    /// busy (e.g. with the sync client applying a checkpoint).
+    async fn initialize_readers(&self) -> Result<(), PowerSyncError> {
+        let pool = &self.env.pool;
+        self.did_initialize_readers
+            .run(|| async {
+                {
+                    let reader = pool.reader().await;
+                    let conn = reader.sqlite_connection();
+                    let version = CoreExtensionVersion::check_from_db(conn)?;
+
+                    if self.has_current_schema(conn, &version)? {
+                        self.status.update(|old| old.resolve_offline_state(conn))?;
+                        return Ok(());
+                    }
+
+                    // Pools with a single connection hand out the writer to readers, so this
+                    // lease needs to be returned before initializing.
+                }
+
+                self.initialize().await
+            })
+            .await
+            .clone()
+    }
+
+    fn update_schema_internal(
+        &self,
+        conn: &mut SqliteConnection,
+        version: &CoreExtensionVersion,
+    ) -> Result<(), PowerSyncError> {
+        if self.has_current_schema(conn, version)? {
+            return Ok(());
+        }
+
         if let SchemaOrCustom::Schema(schema) = self.schema.as_ref() {
             schema.validate()?;
         };
 
-        let serialized_schema = serde_json::to_string(&self.schema)?;
-        let stmt = conn.prepare("SELECT powersync_replace_schema(?)")?;
-        // Fine because we drop the statement before the serialized schema
-        stmt.bind_text(1, &serialized_schema, Destructor::STATIC)?;
-        exec_stmt(stmt)?;
+        let serialized_schema = self.serialized_schema()?;
+        let tx = TransactionGuard::new(conn)?;
+        {
+            let stmt = tx.inner.prepare("SELECT powersync_replace_schema(?)")?;
+            // Fine because we drop the statement before the serialized schema
+            stmt.bind_text(1, serialized_schema.get(), Destructor::STATIC)?;
+            exec_stmt(&stmt)?;
+        }
+        {
+            let fingerprint = self.schema_fingerprint(tx.inner, version)?;
+            let stmt = tx
+                .inner
+                .prepare("INSERT OR REPLACE INTO ps_kv (key, value) VALUES (?, ?)")?;
+            stmt.bind_text(1, Self::SCHEMA_FINGERPRINT_KEY, Destructor::STATIC)?;
+            stmt.bind_text(2, &fingerprint, Destructor::STATIC)?;
+            exec_stmt(&stmt)?;
+        }
+        tx.commit()?;
 
         // TODO: Update readers? Should be fine at the moment because we're only doing this during
         // initialization.
         Ok(())
     }
 
+    /// The key in `ps_kv` storing the fingerprint of the last schema applied by this SDK.
+    const SCHEMA_FINGERPRINT_KEY: &'static str = "native_schema_fingerprint";
+
+    /// Identifies the schema of this database as applied with the given core extension version.
+    ///
+    /// The fingerprint includes the `schema_version` of SQLite, which is changed by every
+    /// migration. A fingerprint stored after applying the schema thus no longer matches if the
+    /// database schema has been changed in another way, e.g. by another SDK or an extension
+    /// upgrade running migrations in `powersync_init()`.
+    fn schema_fingerprint(
+        &self,
+        conn: &SqliteConnection,
+        version: &CoreExtensionVersion,
+    ) -> Result<String, PowerSyncError> {
+        let stmt = conn.prepare("PRAGMA schema_version")?;
+        let ResultCode::ROW = stmt.step()? else {
+            panic!("Expected row") // Can't happen, pragma returns a value
+        };
+        let schema_version = stmt.column_int64(0);
+
+        // FNV-1a, which is stable across Rust versions unlike the hashers of std.
+        let serialized_schema = self.serialized_schema()?;
+        let hash = serialized_schema
+            .get()
+            .bytes()
+            .fold(0xcbf29ce484222325u64, |hash, byte| {
+                (hash ^ byte as u64).wrapping_mul(0x100000001b3)
+            });
+
+        Ok(format!("{version}/{hash:016x}/{schema_version}"))
+    }
+
+    /// Whether the schema of this database has been applied to `conn` already, so that the
+    /// `powersync_replace_schema` call can be skipped.
+    fn has_current_schema(
+        &self,
+        conn: &SqliteConnection,
+        version: &CoreExtensionVersion,
+    ) -> Result<bool, PowerSyncError> {
+        // On new databases, ps_kv is only created by powersync_init().
+        let stmt =
+            conn.prepare("SELECT 1 FROM sqlite_schema WHERE type = 'table' AND name = 'ps_kv'")?;
+        if stmt.step()? != ResultCode::ROW {
+            return Ok(false);
+        }
+        drop(stmt);
+
+        let stmt = conn.prepare("SELECT value FROM ps_kv WHERE key = ?")?;
+        stmt.bind_text(1, Self::SCHEMA_FINGERPRINT_KEY, Destructor::STATIC)?;
+        if stmt.step()? != ResultCode::ROW {
+            return Ok(false);
+        }
+
+        Ok(stmt.column_text(0)? == self.schema_fingerprint(conn, version)?)
+    }
+
+    /// The schema of this database serialized to JSON, which is passed to the core extension
+    /// when initializing the database and when starting sync iterations.
+    ///
+    /// The schema is serialized once and shared afterwards.
+    pub fn serialized_schema(&self) -> Result<Arc<RawValue>, PowerSyncError> {
+        if let Some(serialized) = self.serialized_schema.get() {
+            return Ok(serialized.clone());
+        }
+
+        let serialized: Arc<RawValue> = serde_json::value::to_raw_value(&self.schema)?.into();
+        Ok(self.serialized_schema.get_or_init(|| serialized).clone())
+    }
+
     /// Marks all crud items up until the `last_client_id` (inclusive) as handled and optionally
     /// applies a custom write checkpoint.
     pub async fn complete_crud_items(
@@ -99,53 +239,119 @@ impl InnerPowerSyncState {
         last_client_id: i64,
         write_checkpoint: Option<i64>,
     ) -> Result<(), PowerSyncError> {
-        let mut writer = self.writer().await?;
-        let writer = TransactionGuard::new(writer.sqlite_connection_mut())?;
+        self.write_blocking(move |writer| {
+            let writer = TransactionGuard::new(writer.sqlite_connection_mut())?;
 
-        {
-            let stmt = writer.inner.prepare("DELETE FROM ps_crud WHERE id <= ?")?;
-            stmt.bind_int64(1, last_client_id)?;
-            exec_stmt(stmt)?;
-        }
+            {
+                let stmt = writer
+                    .inner
+                    .prepare_cached("DELETE FROM ps_crud WHERE id <= ?")?;
+                stmt.bind_int64(1, last_client_id)?;
+                exec_stmt(&stmt)?;
+            }
 
-        let mut target_op: i64 = MAX_OP_ID;
-        if let Some(write_checkpoint) = write_checkpoint {
-            // If there are no remaining crud items we can set the target op to the checkpoint.
-            let stmt = writer.inner.prepare("SELECT 1 FROM ps_crud LIMIT 1")?;
-            if let ResultCode::OK = stmt.step()? {
-                target_op = write_checkpoint;
+            let mut target_op: i64 = MAX_OP_ID;
+            if let Some(write_checkpoint) = write_checkpoint {
+                // If there are no remaining crud items we can set the target op to the checkpoint.
+                let stmt = writer
+                    .inner
+                    .prepare_cached("SELECT 1 FROM ps_crud LIMIT 1")?;
+                if let ResultCode::OK = stmt.step()? {
+                    target_op = write_checkpoint;
+                }
             }
-        }
 
-        Self::set_local_target_op(writer.inner, target_op)?;
-        writer.commit()
+            Self::set_local_target_op(writer.inner, target_op)?;
+            writer.commit()
+        })
+        .await?;
+
+        self.crud_prefetch.completed(last_client_id);
+        Ok(())
     }
 
     pub fn set_local_target_op(writer: &SqliteConnection, op: i64) -> Result<(), PowerSyncError> {
-        let stmt = writer.prepare("UPDATE ps_buckets SET target_op = ? WHERE name = ?")?;
+        let stmt = writer.prepare_cached("UPDATE ps_buckets SET target_op = ? WHERE name = ?")?;
         stmt.bind_int64(1, op)?;
         stmt.bind_text(2, "$local", Destructor::STATIC)?;
-        exec_stmt(stmt)
+        exec_stmt(&stmt)
     }
 
     pub async fn reader(&self) -> Result<LeasedConnection, PowerSyncError> {
-        self.initialize().await?;
+        self.initialize_readers().await?;
         Ok(self.env.pool.reader().await)
     }
 
+    /// Returns a snapshot of the latest write shared between watched queries.
+    pub(crate) async fn shared_snapshot(&self) -> Result<Arc<SharedSnapshot>, PowerSyncError> {
+        self.initialize_readers().await?;
+        self.env.pool.shared_snapshot().await
+    }
+
     pub async fn writer(&self) -> Result<LeasedConnection, PowerSyncError> {
+        self.writer_with_priority(WriterPriority::Foreground).await
+    }
+
+    /// Leases the writer for background work, which yields to writers leased through
+    /// [Self::writer].
+    pub async fn background_writer(&self) -> Result<LeasedConnection, PowerSyncError> {
+        self.writer_with_priority(WriterPriority::Background).await
+    }
+
+    async fn writer_with_priority(
+        &self,
+        priority: WriterPriority,
+    ) -> Result<LeasedConnection, PowerSyncError> {
         self.initialize().await?;
-        Ok(self.env.pool.writer().await)
+        // Only wait for a permit of the host once this database can use its writer, so that
+        // databases queued on a contended writer don't hold permits other databases could use.
+        let mut writer = self.env.pool.writer_with_priority(priority).await;
+        let permit = self.env.writer_permit(priority).await;
+        writer.hold_permit(permit);
+
+        Ok(writer)
+    }
+
+    /// Runs `work` on the [crate::env::BlockingPool] of the environment, or inline if none has
+    /// been configured.
+    pub async fn run_blocking<R: Send + 'static>(
+        &self,
+        work: impl FnOnce() -> R + Send + 'static,
+    ) -> R {
+        match &self.env.blocking {
+            Some(pool) => pool.run(work).await,
+            None => work(),
+        }
+    }
+
+    /// Leases a reader connection and runs `read` with it through [Self::run_blocking].
+    pub async fn read_blocking<R: Send + 'static>(
+        &self,
+        read: impl FnOnce(&LeasedConnection) -> Result<R, PowerSyncError> + Send + 'static,
+    ) -> Result<R, PowerSyncError> {
+        let reader = self.reader().await?;
+        self.run_blocking(move || read(&reader)).await
+    }
+
+    /// Leases the writer connection and runs `write` with it through [Self::run_blocking].
+    pub async fn write_blocking<R: Send + 'static>(
+        &self,
+        write: impl FnOnce(&mut LeasedConnection) -> Result<R, PowerSyncError> + Send + 'static,
+    ) -> Result<R, PowerSyncError> {
+        let mut writer = self.writer().await?;
+        self.run_blocking(move || write(&mut writer)).await
     }
 
-    pub async fn sync_iteration_delay(&self) {
-        let delay = {
-            let guard = self.retry_delay.lock().unwrap();
+    /// Waits before retrying after `failures` consecutive failed sync iterations or uploads,
+    /// according to the [ReconnectPolicy] of the current connection.
+    pub async fn sync_iteration_delay(&self, failures: u32) {
+        let policy = {
+            let guard = self.reconnect_policy.lock().unwrap();
             *guard
         };
 
-        if let Some(delay) = delay {
-            self.env.timer.delay_once(delay).await
+        if let Some(policy) = policy {
+            self.env.timer.delay_once(policy.delay(failures)).await
         }
     }
 
@@ -4,18 +4,30 @@ use std::fmt::{Debug, Formatter};
 use std::sync::Arc;
 
 use crate::db::async_support::AsyncDatabaseTasks;
+#[cfg(feature = "rusqlite")]
+use crate::db::diff::{QueryDiff, ResultSnapshot};
+use crate::db::update_hook::RowUpdate;
 use crate::db::watch::ListenerConfiguration;
 use crate::schema::SchemaOrCustom;
 use crate::sync::coordinator::SyncCoordinator;
 use crate::{
     CrudTransaction, SyncOptions,
     db::{
-        crud::CrudTransactionStream, internal::InnerPowerSyncState, pool::LeasedConnection,
+        crud::{CrudBatch, CrudTransactionStream},
+        internal::InnerPowerSyncState,
+        pool::LeasedConnection,
+        snapshot::ReadSnapshot,
         streams::SyncStream,
     },
     env::PowerSyncEnvironment,
     error::PowerSyncError,
-    sync::{download::DownloadActor, status::SyncStatusData, upload::UploadActor},
+    sync::{
+        download::{DownloadActor, DownloadPipeline},
+        progress::PersistedDownload,
+        status::SyncStatusData,
+        upload::UploadActor,
+    },
+    util::{Throttled, WatchOptions},
 };
 use futures_lite::{FutureExt, Stream, StreamExt};
 
@@ -23,16 +35,21 @@ mod async_support;
 pub(crate) mod connection;
 pub mod core_extension;
 pub mod crud;
+#[cfg(feature = "rusqlite")]
+pub mod diff;
 pub(crate) mod internal;
 pub mod pool;
 pub mod schema;
+pub mod snapshot;
 pub mod streams;
+pub mod update_hook;
 pub mod watch;
+pub mod writer_lock;
 
 #[derive(Clone)]
 pub struct PowerSyncDatabase {
     sync: Arc<SyncCoordinator>,
-    inner: Arc<InnerPowerSyncState>,
+    pub(crate) inner: Arc<InnerPowerSyncState>,
 }
 
 /// An opened database managed by the PowerSync SDK.
@@ -74,15 +91,27 @@ impl PowerSyncDatabase {
     pub fn async_tasks(&self) -> AsyncDatabaseTasks {
         let mut downloads = DownloadActor::new(self.inner.clone(), &self.sync);
         let mut uploads = UploadActor::new(self.inner.clone(), &self.sync);
+        let mut pipeline = DownloadPipeline::new(&self.sync);
 
         AsyncDatabaseTasks::new(
             async move { downloads.run().await }.boxed(),
             async move { uploads.run().await }.boxed(),
+            async move { pipeline.run().await }.boxed(),
         )
     }
 
     /// Requests the download actor, started with [Self::download_actor], to start establishing a
     /// connection to the PowerSync service.
+    ///
+    /// If the client is already connected, it only reconnects if `options` use a different
+    /// connector or change how data is downloaded. Other options, such as the [ReconnectPolicy],
+    /// apply to the next connection attempt.
+    ///
+    /// Connectors are compared by identity: [SyncOptions::new] wraps its connector in a new
+    /// [Arc], so every call with options created by it reconnects. To keep the connection, pass a
+    /// clone of the previous options or create them with [SyncOptions::from_shared].
+    ///
+    /// [ReconnectPolicy]: crate::ReconnectPolicy
     pub async fn connect(&self, options: SyncOptions) {
         self.sync.connect(options, &self.inner).await
     }
@@ -103,19 +132,62 @@ impl PowerSyncDatabase {
         emit_initially: bool,
         tables: Tables,
     ) -> impl Stream<Item = ()> + 'static {
-        let config = ListenerConfiguration::if_matches(
-            tables
-                .into_iter()
-                .flat_map(|s| {
-                    let s = s.into();
-
-                    [
-                        format!("{}{s}", Self::PS_DATA_PREFIX),
-                        format!("{}{s}", Self::PS_DATA_LOCAL_PREFIX),
-                        Cow::into_owned(s),
-                    ]
-                })
-                .collect(),
+        self.watch_tables_with(emit_initially, tables, &WatchOptions::default())
+    }
+
+    /// Like [Self::watch_tables], but limiting how often the stream emits according to
+    /// `options`.
+    ///
+    /// Writes made while an event is delayed are merged into that event. With `emit_initially`,
+    /// the initial event is not delayed.
+    pub fn watch_tables_with<'a, Tables: IntoIterator<Item = impl Into<Cow<'a, str>>>>(
+        &self,
+        emit_initially: bool,
+        tables: Tables,
+        options: &WatchOptions,
+    ) -> impl Stream<Item = ()> + 'static {
+        let config =
+            ListenerConfiguration::if_matches(Self::watched_tables(tables), emit_initially);
+        let notifications = self
+            .inner
+            .env
+            .pool
+            .update_notifiers()
+            .listen(config)
+            .map(|_| ());
+
+        Throttled::new(
+            notifications,
+            *options,
+            self.inner.env.timer,
+            emit_initially,
+        )
+    }
+
+    /// Like [Self::watch_tables], but only emitting when `filter` matches a written row.
+    ///
+    /// Filters receive the name of the table (as passed to this method) and the PowerSync `id` of
+    /// each written row. Column values aren't available, so filters can't match rows by their
+    /// contents (e.g. `list_id = ?`). Instead, filters typically check whether the id is one of the
+    /// rows they're interested in, queried with `SELECT id FROM <table> WHERE list_id = ?`
+    /// beforehand.
+    ///
+    /// Ids of deleted rows are only known with the `preupdate_hook` feature, which requires SQLite
+    /// to be compiled with `SQLITE_ENABLE_PREUPDATE_HOOK`. Without it, deletes match every filter,
+    /// as do writes to tables that aren't PowerSync views.
+    ///
+    /// Rows are only tracked if the connection pool has been opened with
+    /// [crate::PoolOptions::with_row_update_tracking]. Otherwise, or for large writes touching
+    /// many rows, this behaves like [Self::watch_tables] and emits for every write to a table.
+    pub fn watch_table_rows<'a, Tables: IntoIterator<Item = impl Into<Cow<'a, str>>>>(
+        &self,
+        emit_initially: bool,
+        tables: Tables,
+        filter: impl Fn(&RowUpdate) -> bool + Send + Sync + 'static,
+    ) -> impl Stream<Item = ()> + 'static {
+        let config = ListenerConfiguration::if_rows_match(
+            Self::watched_tables(tables),
+            filter,
             emit_initially,
         );
 
@@ -127,6 +199,24 @@ impl PowerSyncDatabase {
             .map(|_| ())
     }
 
+    /// Expands table names to the internal tables backing PowerSync views with that name.
+    fn watched_tables<'a>(
+        tables: impl IntoIterator<Item = impl Into<Cow<'a, str>>>,
+    ) -> HashSet<String> {
+        tables
+            .into_iter()
+            .flat_map(|s| {
+                let s = s.into();
+
+                [
+                    format!("{}{s}", Self::PS_DATA_PREFIX),
+                    format!("{}{s}", Self::PS_DATA_LOCAL_PREFIX),
+                    Cow::into_owned(s),
+                ]
+            })
+            .collect()
+    }
+
     /// Returns a stream emitting an item whenever any table in the local database is written to.
     pub fn watch_all_updates(&self) -> impl Stream<Item = HashSet<String>> + 'static {
         self.inner
@@ -153,6 +243,26 @@ impl PowerSyncDatabase {
         params: P,
         read: F,
     ) -> impl Stream<Item = Result<T, PowerSyncError>> + 'static
+    where
+        for<'a> F:
+            (Fn(&'a mut rusqlite::Statement, P) -> Result<T, PowerSyncError>) + 'static + Clone,
+    {
+        self.watch_statement_with(sql, params, &WatchOptions::default(), read)
+    }
+
+    /// Like [Self::watch_statement], but limiting how often the statement is re-run according to
+    /// `options`.
+    ///
+    /// This is useful for queries on tables that are written to frequently, e.g. while the sync
+    /// client is downloading a large amount of data. The initial snapshot is not delayed.
+    #[cfg(feature = "rusqlite")]
+    pub fn watch_statement_with<T, F, P: rusqlite::Params + Clone + 'static>(
+        &self,
+        sql: String,
+        params: P,
+        options: &WatchOptions,
+        read: F,
+    ) -> impl Stream<Item = Result<T, PowerSyncError>> + 'static
     where
         for<'a> F:
             (Fn(&'a mut rusqlite::Statement, P) -> Result<T, PowerSyncError>) + 'static + Clone,
@@ -161,7 +271,7 @@ impl PowerSyncDatabase {
         // SQL query and parameters. We also want this to emit initially without an update so that
         // this stream can emit the initial snapshot.
         let update_notifications =
-            self.emit_on_statement_changes(true, sql.to_string(), params.clone());
+            self.emit_on_statement_changes(true, sql.to_string(), params.clone(), options);
 
         let db = self.clone();
         // Note that this does not necessarily re-run for every update notification: If multiple
@@ -179,7 +289,9 @@ impl PowerSyncDatabase {
                     return Err(e);
                 }
 
-                let reader = db.reader().await?;
+                // Other watchers notified about the same write can share this snapshot.
+                let snapshot = db.inner.shared_snapshot().await?;
+                let reader = snapshot.lock().await;
                 let mut stmt = reader.prepare_cached(&sql)?;
 
                 mapper(&mut stmt, params)
@@ -187,21 +299,78 @@ impl PowerSyncDatabase {
         })
     }
 
+    /// Returns an asynchronous [Stream] emitting changes to the results of a `SELECT` statement
+    /// every time source tables are modified.
+    ///
+    /// Rows are identified by the `key_column` of the statement, which must be unique (typically
+    /// the `id` column). Between runs, this only keeps a hash of each row: The `map` function is
+    /// only called for rows that were added or changed, and no event is emitted when a write
+    /// didn't affect results. The first event reports all rows as added.
+    ///
+    /// Compared to [Self::watch_statement], this is useful for large result sets where writes
+    /// typically affect few rows, allowing callers to apply [QueryDiff]s to their own copy of the
+    /// results.
+    #[cfg(feature = "rusqlite")]
+    pub fn watch_statement_diff<T, F, P: rusqlite::Params + Clone + 'static>(
+        &self,
+        sql: String,
+        params: P,
+        key_column: impl Into<String>,
+        map: F,
+    ) -> impl Stream<Item = Result<QueryDiff<T>, PowerSyncError>> + 'static
+    where
+        F: (Fn(&rusqlite::Row<'_>) -> Result<T, PowerSyncError>) + 'static + Clone,
+    {
+        let update_notifications = self.emit_on_statement_changes(
+            true,
+            sql.to_string(),
+            params.clone(),
+            &WatchOptions::default(),
+        );
+        let key_column = key_column.into();
+        let snapshot = Arc::new(std::sync::Mutex::new(ResultSnapshot::default()));
+
+        let db = self.clone();
+        update_notifications
+            .then(move |notification| {
+                let db = db.clone();
+                let sql = sql.clone();
+                let params = params.clone();
+                let key_column = key_column.clone();
+                let snapshot = snapshot.clone();
+                let map = map.clone();
+
+                async move {
+                    notification?;
+
+                    let shared = db.inner.shared_snapshot().await?;
+                    let reader = shared.lock().await;
+                    let mut stmt = reader.prepare_cached(&sql)?;
+                    let mut snapshot = snapshot.lock().unwrap();
+
+                    snapshot.update(&mut stmt, params, &key_column, map)
+                }
+            })
+            .filter_map(Result::transpose)
+    }
+
     #[cfg(feature = "rusqlite")]
     fn emit_on_statement_changes(
         &self,
         emit_initially: bool,
         sql: String,
         params: impl rusqlite::Params + 'static,
+        options: &WatchOptions,
     ) -> impl Stream<Item = Result<(), PowerSyncError>> + 'static {
         // Stream emitting referenced tables once.
         let tables = futures_lite::stream::once_future(self.clone().find_tables(sql, params));
 
         // Stream emitting updates, or a single error if we couldn't resolve tables.
         let db = self.clone();
+        let options = *options;
         tables.flat_map(move |referenced_tables| match referenced_tables {
             Ok(referenced_tables) => db
-                .watch_tables(emit_initially, referenced_tables)
+                .watch_tables_with(emit_initially, referenced_tables, &options)
                 .map(Ok)
                 .boxed(),
             Err(e) => futures_lite::stream::once(Err(e)).boxed(),
@@ -244,18 +413,19 @@ impl PowerSyncDatabase {
 
         Ok(found_tables
             .into_iter()
-            .map(|table| {
-                if let Some(name) = table.strip_prefix(Self::PS_DATA_PREFIX) {
-                    name.to_string()
-                } else if let Some(name) = table.strip_prefix(Self::PS_DATA_LOCAL_PREFIX) {
-                    name.to_string()
-                } else {
-                    table
-                }
-            })
+            .map(|table| Self::watched_table_name(&table).to_string())
             .collect())
     }
 
+    /// Maps a table reported by SQLite to the name used by [Self::watch_tables], stripping the
+    /// prefix of internal tables backing views of the schema.
+    pub(crate) fn watched_table_name(table: &str) -> &str {
+        table
+            .strip_prefix(Self::PS_DATA_PREFIX)
+            .or_else(|| table.strip_prefix(Self::PS_DATA_LOCAL_PREFIX))
+            .unwrap_or(table)
+    }
+
     /// Returns a [Stream] traversing through transactions that have been completed on this
     /// database.
     ///
@@ -270,13 +440,45 @@ impl PowerSyncDatabase {
     /// Returns the first transaction that has not been marked as completed.
     ///
     /// This is always the first item of [Self::crud_transactions], see that method for details.
+    /// With [crate::SyncOptions::with_pipelined_upload], the transaction may have been read while
+    /// the previous one was being uploaded.
     pub async fn next_crud_transaction<'a>(
         &'a self,
     ) -> Result<Option<CrudTransaction<'a>>, PowerSyncError> {
+        if let Some(prefetched) = self.inner.crud_prefetch.take_oldest(self) {
+            return Ok(Some(prefetched));
+        }
+
         let mut stream = self.crud_transactions();
         stream.try_next().await
     }
 
+    /// Returns the oldest local writes that have not been marked as completed, grouped into a
+    /// single [CrudBatch] of whole transactions.
+    ///
+    /// Transactions are added to the batch as long as it contains at most `limit_entries` entries
+    /// and `limit_bytes` bytes of JSON data. The oldest transaction is always included, even if it
+    /// exceeds these limits on its own. Compared to [Self::next_crud_transaction], this allows
+    /// backend connectors to upload many small transactions at once.
+    pub async fn next_crud_batch<'a>(
+        &'a self,
+        limit_entries: usize,
+        limit_bytes: usize,
+    ) -> Result<Option<CrudBatch<'a>>, PowerSyncError> {
+        CrudBatch::next(self, limit_entries, limit_bytes).await
+    }
+
+    /// Returns how much data has been downloaded and stored without its checkpoint having
+    /// completed yet.
+    ///
+    /// After a download has been interrupted, this is the progress that the next sync iteration
+    /// resumes from. See [PersistedDownload] for details.
+    pub async fn persisted_download(&self) -> Result<PersistedDownload, PowerSyncError> {
+        self.inner
+            .read_blocking(|reader| PersistedDownload::read(reader.sqlite_connection()))
+            .await
+    }
+
     /// Returns the current [SyncStatusData] snapshot reporting the sync state of this database.
     pub fn status(&self) -> Arc<SyncStatusData> {
         self.inner.status.current_snapshot()
@@ -310,45 +512,19 @@ impl PowerSyncDatabase {
         self.inner.reader().await
     }
 
-    /// Obtains a [LeasedConnection] allowing reading and writing queries.
-    pub async fn writer(&self) -> Result<LeasedConnection, PowerSyncError> {
-        self.inner.writer().await
-    }
-
-    /*
-    /// Returns the shared [InnerPowerSyncState] backing this database.
+    /// Obtains a reader connection in a read transaction, so that all queries run on it observe
+    /// the same state of the database.
     ///
-    /// This is meant to be used internally to build the PowerSync C++ SDK.
-    #[cfg(feature = "ffi")]
-    pub fn into_raw(self) -> *const InnerPowerSyncState {
-        Arc::into_raw(self.inner)
+    /// Unlike with [Self::reader], writes committed while the snapshot is in use (e.g. by the sync
+    /// client) are not visible to later queries. See [ReadSnapshot] for details.
+    pub async fn snapshot(&self) -> Result<ReadSnapshot, PowerSyncError> {
+        ReadSnapshot::begin(self.inner.reader().await?)
     }
 
-    /// Creates a [Self] from the raw inner pointer.
-    ///
-    /// ## Safety
-    ///
-    /// The inner pointer must have been obtained from [Self::into_raw] without calling
-    /// [Self::drop_raw] on it in the meantime.
-    #[cfg(feature = "ffi")]
-    pub unsafe fn interpret_raw(inner: *const InnerPowerSyncState) -> Self {
-        unsafe { Arc::increment_strong_count(inner) };
-        Self {
-            inner: unsafe { Arc::from_raw(inner) },
-        }
-    }
-
-    /// Frees resources from a [Self::into_raw] pointer.
-    ///
-    /// ## Safety
-    ///
-    /// This method must be called at most once on a pointer previously returned by
-    /// [Self::into:raw].
-    #[cfg(feature = "ffi")]
-    pub unsafe fn drop_raw(inner: *const InnerPowerSyncState) {
-        drop(unsafe { Arc::from_raw(inner) });
+    /// Obtains a [LeasedConnection] allowing reading and writing queries.
+    pub async fn writer(&self) -> Result<LeasedConnection, PowerSyncError> {
+        self.inner.writer().await
     }
-     */
 }
 
 impl Debug for PowerSyncDatabase {
@@ -1,16 +1,30 @@
 #[cfg(feature = "rusqlite")]
 use std::ops::{Deref, DerefMut};
-use std::{collections::HashSet, mem::MaybeUninit, path::Path, sync::Arc};
+use std::{
+    collections::HashSet,
+    mem::MaybeUninit,
+    path::Path,
+    sync::{
+        Arc, OnceLock, Weak,
+        atomic::{AtomicUsize, Ordering},
+    },
+    time::{Duration, Instant},
+};
 
 use async_channel::{Receiver, Sender};
-use async_lock::{Mutex, MutexGuardArc};
+use async_lock::{MutexGuardArc, SemaphoreGuardArc};
+use log::warn;
 use powersync_sqlite_nostd::ResultCode;
 use powersync_sqlite_nostd::bindings::{
     SQLITE_OPEN_CREATE, SQLITE_OPEN_READONLY, SQLITE_OPEN_READWRITE,
 };
 use serde::Deserialize;
 
-use crate::db::connection::{RawSqliteConnection, SqliteConnection};
+use crate::db::connection::{RawSqliteConnection, SqliteConnection, exec_stmt};
+use crate::db::snapshot::{ReadSnapshot, SharedSnapshot, SnapshotCache};
+use crate::db::update_hook::RowUpdateTracker;
+use crate::db::writer_lock::{WriterLock, WriterLockStats, WriterPriority};
+use crate::env::MetricsObserver;
 use crate::{db::watch::TableNotifiers, error::PowerSyncError};
 
 /// A raw connection pool, giving out both synchronous and asynchronous leases to SQLite
@@ -21,15 +35,30 @@ pub struct ConnectionPool {
 }
 
 impl ConnectionPool {
-    fn prepare_writer(connection: SqliteConnection) -> Arc<Mutex<SqliteConnection>> {
-        connection
-            .exec(c"SELECT powersync_update_hooks('install');")
-            .expect("could not install update hook");
+    fn prepare_writer(
+        connection: SqliteConnection,
+        row_updates: Option<&Arc<RowUpdateTracker>>,
+    ) -> WriterLock {
+        match row_updates {
+            Some(tracker) => tracker.install(&connection),
+            None => connection
+                .exec(c"SELECT powersync_update_hooks('install');")
+                .expect("could not install update hook"),
+        }
 
-        Arc::new(Mutex::new(connection))
+        WriterLock::new(connection)
     }
 
+    /// Opens a pool for the database at `path` with default [PoolOptions].
     pub fn open<P: AsRef<Path>>(path: P) -> Result<Self, PowerSyncError> {
+        Self::open_with(path, &PoolOptions::default())
+    }
+
+    /// Opens a pool for the database at `path`, configuring connections according to `options`.
+    pub fn open_with<P: AsRef<Path>>(
+        path: P,
+        options: &PoolOptions,
+    ) -> Result<Self, PowerSyncError> {
         let writer = SqliteConnection::from(RawSqliteConnection::open_path(
             &path,
             SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
@@ -38,19 +67,49 @@ impl ConnectionPool {
         writer.exec(c"PRAGMA journal_mode = WAL")?;
         writer.exec(c"PRAGMA journal_size_limit = 6291456")?; // 6 * 1024 * 1024
         writer.exec(c"PRAGMA busy_timeout = 30000")?;
-        writer.exec(c"PRAGMA cache_size = -51200")?; // -(50 * 1024)
-
-        let mut readers = vec![];
-        for _ in 0..5 {
-            let reader = SqliteConnection::from(RawSqliteConnection::open_path(
-                &path,
-                SQLITE_OPEN_READONLY,
-            )?);
-            reader.exec(c"PRAGMA query_only = 1")?;
-            readers.push(reader);
+        options.configure(&writer, options.writer_cache_size_kib)?;
+
+        let row_updates = options
+            .track_row_updates
+            .then(|| Arc::new(RowUpdateTracker::default()));
+        if options.readers == 0 {
+            return Ok(Self::from_parts(writer, None, row_updates));
         }
 
-        Ok(Self::wrap_connections(writer, readers))
+        let open_reader = {
+            let path = path.as_ref().to_path_buf();
+            let options = options.clone();
+
+            move || options.open_reader(&path)
+        };
+
+        let readers = match options.adaptive_readers {
+            None => {
+                let mut readers = vec![];
+                for _ in 0..options.readers {
+                    readers.push(open_reader()?);
+                }
+
+                PoolReaders::new(readers, None)
+            }
+            Some(idle_timeout) => {
+                // Open one reader eagerly, so that there's always a connection to wait for if
+                // opening additional readers fails.
+                let first = open_reader()?;
+
+                PoolReaders::new(
+                    [first],
+                    Some(AdaptiveReaders {
+                        open_reader: Box::new(open_reader),
+                        opened: AtomicUsize::new(1),
+                        max_readers: options.readers,
+                        idle_timeout,
+                    }),
+                )
+            }
+        };
+
+        Ok(Self::from_parts(writer, Some(readers), row_updates))
     }
 
     /// Creates a pool backed by a single write and multiple reader connections.
@@ -60,31 +119,28 @@ impl ConnectionPool {
         writer: impl Into<SqliteConnection>,
         readers: impl IntoIterator<Item = impl Into<SqliteConnection>>,
     ) -> Self {
-        let writer = Self::prepare_writer(writer.into());
-        let (release, consume) = async_channel::unbounded::<SqliteConnection>();
-        for reader in readers {
-            release.send_blocking(reader.into()).unwrap();
-        }
-
-        Self {
-            state: Arc::new(PoolState {
-                writer,
-                readers: Some(PoolReaders {
-                    take_reader: consume,
-                    release_reader: release,
-                }),
-                table_notifiers: Default::default(),
-            }),
-        }
+        let readers = PoolReaders::new(readers.into_iter().map(Into::into), None);
+        Self::from_parts(writer.into(), Some(readers), None)
     }
 
     /// Creates a connection pool backed by a single sqlite connection.
     pub fn single_connection(conn: impl Into<SqliteConnection>) -> Self {
+        Self::from_parts(conn.into(), None, None)
+    }
+
+    fn from_parts(
+        writer: SqliteConnection,
+        readers: Option<PoolReaders>,
+        row_updates: Option<Arc<RowUpdateTracker>>,
+    ) -> Self {
         Self {
             state: Arc::new(PoolState {
-                writer: Self::prepare_writer(conn.into()),
-                readers: None,
+                writer: Self::prepare_writer(writer, row_updates.as_ref()),
+                readers,
+                row_updates,
                 table_notifiers: Default::default(),
+                metrics: OnceLock::new(),
+                snapshots: Default::default(),
             }),
         }
     }
@@ -93,35 +149,127 @@ impl ConnectionPool {
         &self.state.table_notifiers
     }
 
+    /// Reports connection waits and update notifications of this pool to `observer`, unless
+    /// another observer has been installed before.
+    pub(crate) fn set_metrics_observer(&self, observer: Arc<dyn MetricsObserver>) {
+        let _ = self.state.metrics.set(observer);
+    }
+
+    /// Starts measuring an operation if a [MetricsObserver] has been installed.
+    fn start_measuring(&self) -> Option<(&dyn MetricsObserver, Instant)> {
+        let metrics = self.state.metrics.get()?;
+        Some((metrics.as_ref(), Instant::now()))
+    }
+
     fn take_connection_sync(&'_ self, writer: bool) -> LeasedConnection {
+        let measuring = self.start_measuring();
+
         if !writer && let Some(readers) = &self.state.readers {
-            let reader = readers
-                .take_reader
-                .recv_blocking()
-                .expect("should receive connection");
+            let reader = readers.try_take().unwrap_or_else(|| {
+                readers
+                    .take_reader
+                    .recv_blocking()
+                    .expect("should receive connection")
+                    .connection
+            });
+            if let Some((metrics, started)) = measuring {
+                metrics.reader_wait(started.elapsed());
+            }
 
             LeasedConnection {
                 inner: OwnedConnectionLease::Reader {
                     connection: MaybeUninit::new(reader),
                     pool: self.clone(),
                 },
+                permit: None,
             }
         } else {
-            let guard = self.state.writer.lock_arc_blocking();
+            let guard = self.state.writer.lock_blocking();
+            if let Some((metrics, started)) = measuring {
+                metrics.writer_wait(false, started.elapsed());
+            }
+
             LeasedConnection {
                 inner: OwnedConnectionLease::Writer {
+                    changes_before: guard.total_changes(),
                     connection: guard,
                     pool: self.clone(),
                 },
+                permit: None,
             }
         }
     }
 
-    fn take_update_notifications(
-        &self,
-        writer: &SqliteConnection,
-    ) -> Result<SqliteUpdateNotification, PowerSyncError> {
-        let stmt = writer.prepare("SELECT powersync_update_hooks('get');")?;
+    /// Returns a [ReadSnapshot] of the latest write, shared with other callers while it's in use
+    /// and until the next write changing the database is committed.
+    ///
+    /// Watched queries re-running after a write use this to read on one connection and a
+    /// consistent state, instead of leasing a reader for each query. Once all queries using the
+    /// snapshot are done, its reader returns to the pool. Pools with less than two
+    /// readers don't share snapshots, since an idle snapshot would block other reads (or the
+    /// writer, if reads use the writer connection).
+    pub(crate) async fn shared_snapshot(&self) -> Result<Arc<SharedSnapshot>, PowerSyncError> {
+        let generation = {
+            let cache = self.state.snapshots.lock().unwrap();
+            if let Some(current) = cache.current.upgrade() {
+                return Ok(current);
+            }
+
+            cache.generation
+        };
+
+        let snapshot = SharedSnapshot::new(ReadSnapshot::begin(self.reader().await)?);
+        if self.shares_snapshots() {
+            let mut cache = self.state.snapshots.lock().unwrap();
+            // Only share the snapshot if no write has been committed while it was created.
+            if cache.generation == generation && cache.current.strong_count() == 0 {
+                cache.current = Arc::downgrade(&snapshot);
+            }
+        }
+
+        Ok(snapshot)
+    }
+
+    /// Whether snapshots can be kept around until the next write. This requires other readers to
+    /// be available for queries while the shared snapshot is idle.
+    fn shares_snapshots(&self) -> bool {
+        self.state
+            .readers
+            .as_ref()
+            .is_some_and(|readers| readers.capacity > 1)
+    }
+
+    /// Stops sharing the current snapshot with queries started after this call.
+    pub(crate) fn invalidate_shared_snapshot(&self) {
+        let mut cache = self.state.snapshots.lock().unwrap();
+        cache.generation += 1;
+        cache.current = Weak::new();
+    }
+
+    fn take_update_notifications(&self, writer: &SqliteConnection) -> Result<(), PowerSyncError> {
+        // Queries notified about this write must not read from an older snapshot.
+        self.invalidate_shared_snapshot();
+
+        if let Some(tracker) = &self.state.row_updates {
+            let mut updates = tracker.take();
+            if !updates.tables.is_empty() {
+                // Rows with unresolved ids match all filters, so notifying is still correct if
+                // this fails.
+                if let Err(e) = updates.resolve_ids(writer) {
+                    warn!("Could not resolve ids of updated rows: {e}");
+                }
+
+                let measuring = self.start_measuring();
+                self.state.table_notifiers.notify_row_updates(&updates);
+                if let Some((metrics, started)) = measuring {
+                    metrics.update_notifications(updates.tables.len(), started.elapsed());
+                }
+            }
+
+            return Ok(());
+        }
+
+        let stmt = writer.prepare_cached("SELECT powersync_update_hooks('get');")?;
 
         match stmt.step()? {
             ResultCode::ROW => {
@@ -129,10 +277,14 @@ impl ConnectionPool {
                     serde_json::from_str::<SqliteUpdateNotification>(stmt.column_text(0)?)?;
 
                 if !updates.tables.is_empty() {
+                    let measuring = self.start_measuring();
                     self.state.table_notifiers.notify_updates(&updates.tables);
+                    if let Some((metrics, started)) = measuring {
+                        metrics.update_notifications(updates.tables.len(), started.elapsed());
+                    }
                 }
 
-                Ok(updates)
+                Ok(())
             }
             code => Err(code.into()),
         }
@@ -140,26 +292,50 @@ impl ConnectionPool {
 
     async fn take_connection_async(&self, writer: bool) -> LeasedConnection {
         if !writer && let Some(readers) = &self.state.readers {
-            let reader = readers
-                .take_reader
-                .recv()
-                .await
-                .expect("should receive connection");
+            let measuring = self.start_measuring();
+            let reader = match readers.try_take() {
+                Some(reader) => reader,
+                None => {
+                    readers
+                        .take_reader
+                        .recv()
+                        .await
+                        .expect("should receive connection")
+                        .connection
+                }
+            };
+            if let Some((metrics, started)) = measuring {
+                metrics.reader_wait(started.elapsed());
+            }
 
             LeasedConnection {
                 inner: OwnedConnectionLease::Reader {
                     connection: MaybeUninit::new(reader),
                     pool: self.clone(),
                 },
+                permit: None,
             }
         } else {
-            let guard = self.state.writer.lock_arc().await;
-            LeasedConnection {
-                inner: OwnedConnectionLease::Writer {
-                    connection: guard,
-                    pool: self.clone(),
-                },
-            }
+            self.writer_with_priority(WriterPriority::Foreground).await
+        }
+    }
+
+    /// Leases the writer connection, letting foreground writers go before background writers
+    /// waiting for the connection.
+    pub(crate) async fn writer_with_priority(&self, priority: WriterPriority) -> LeasedConnection {
+        let measuring = self.start_measuring();
+        let guard = self.state.writer.lock(priority).await;
+        if let Some((metrics, started)) = measuring {
+            metrics.writer_wait(priority == WriterPriority::Background, started.elapsed());
+        }
+
+        LeasedConnection {
+            inner: OwnedConnectionLease::Writer {
+                changes_before: guard.total_changes(),
+                connection: guard,
+                pool: self.clone(),
+            },
+            permit: None,
         }
     }
 
@@ -167,6 +343,31 @@ impl ConnectionPool {
         self.take_connection_async(true).await
     }
 
+    /// Returns how long writers have waited for the writer connection of this pool.
+    ///
+    /// Writers leased by the application are preferred over the sync client applying downloaded
+    /// data, so foreground waits are bounded by the [crate::DownloadBatchLimits] of the sync
+    /// client.
+    pub fn writer_lock_stats(&self) -> WriterLockStats {
+        self.state.writer.stats()
+    }
+
+    /// Returns the amount of reader connections currently opened by this pool, including readers
+    /// that are leased.
+    ///
+    /// For pools using [PoolOptions::with_adaptive_readers], this changes as readers are opened
+    /// on demand and closed when idle.
+    pub fn open_readers(&self) -> usize {
+        match &self.state.readers {
+            Some(PoolReaders {
+                adaptive: Some(adaptive),
+                ..
+            }) => adaptive.opened.load(Ordering::SeqCst),
+            Some(readers) => readers.capacity,
+            None => 0,
+        }
+    }
+
     pub fn writer_sync(&self) -> LeasedConnection {
         self.take_connection_sync(true)
     }
@@ -180,6 +381,134 @@ impl ConnectionPool {
     }
 }
 
+/// Options controlling how [ConnectionPool::open_with] opens and configures connections.
+#[derive(Clone, Debug)]
+pub struct PoolOptions {
+    readers: usize,
+    adaptive_readers: Option<Duration>,
+    writer_cache_size_kib: Option<u32>,
+    reader_cache_size_kib: Option<u32>,
+    mmap_size: Option<u64>,
+    temp_store: Option<TempStore>,
+    track_row_updates: bool,
+}
+
+impl PoolOptions {
+    /// The amount of read-only connections to open (5 by default).
+    ///
+    /// With [Self::with_adaptive_readers], this is the maximum amount of readers. When set to
+    /// zero, reads use the writer connection.
+    pub fn with_readers(&mut self, readers: usize) -> &mut Self {
+        self.readers = readers;
+        self
+    }
+
+    /// Opens reader connections lazily as concurrent reads require them, instead of opening all
+    /// of them when the pool is created.
+    ///
+    /// Readers that have not been used for `idle_timeout` are closed when another reader is
+    /// requested, but the pool always keeps at least one reader open.
+    pub fn with_adaptive_readers(&mut self, idle_timeout: Duration) -> &mut Self {
+        self.adaptive_readers = Some(idle_timeout);
+        self
+    }
+
+    /// The page cache size of the writer connection, in KiB (50 MiB by default).
+    pub fn with_writer_cache_size_kib(&mut self, size: u32) -> &mut Self {
+        self.writer_cache_size_kib = Some(size);
+        self
+    }
+
+    /// The page cache size of each reader connection, in KiB (SQLite's default if unset).
+    pub fn with_reader_cache_size_kib(&mut self, size: u32) -> &mut Self {
+        self.reader_cache_size_kib = Some(size);
+        self
+    }
+
+    /// Configures `PRAGMA mmap_size` on all connections.
+    pub fn with_mmap_size(&mut self, bytes: u64) -> &mut Self {
+        self.mmap_size = Some(bytes);
+        self
+    }
+
+    /// Configures `PRAGMA temp_store` on all connections.
+    pub fn with_temp_store(&mut self, temp_store: TempStore) -> &mut Self {
+        self.temp_store = Some(temp_store);
+        self
+    }
+
+    /// Tracks updated rows on the writer connection with a custom update hook, allowing
+    /// [crate::PowerSyncDatabase::watch_table_rows] to skip writes to rows that it's not
+    /// interested in.
+    ///
+    /// Without this option, only the names of updated tables are tracked. Tracking rows has a
+    /// small overhead for each written row.
+    pub fn with_row_update_tracking(&mut self) -> &mut Self {
+        self.track_row_updates = true;
+        self
+    }
+
+    fn open_reader(&self, path: &Path) -> Result<SqliteConnection, PowerSyncError> {
+        let reader =
+            SqliteConnection::from(RawSqliteConnection::open_path(path, SQLITE_OPEN_READONLY)?);
+        reader.exec(c"PRAGMA query_only = 1")?;
+        self.configure(&reader, self.reader_cache_size_kib)?;
+
+        Ok(reader)
+    }
+
+    fn configure(
+        &self,
+        conn: &SqliteConnection,
+        cache_size_kib: Option<u32>,
+    ) -> Result<(), PowerSyncError> {
+        if let Some(size) = cache_size_kib {
+            // Negative values are interpreted as KiB instead of pages.
+            exec_stmt(&conn.prepare(&format!("PRAGMA cache_size = -{size}"))?)?;
+        }
+        if let Some(size) = self.mmap_size {
+            exec_stmt(&conn.prepare(&format!("PRAGMA mmap_size = {size}"))?)?;
+        }
+        if let Some(temp_store) = self.temp_store {
+            exec_stmt(&conn.prepare(&format!("PRAGMA temp_store = {}", temp_store.as_sql()))?)?;
+        }
+
+        Ok(())
+    }
+}
+
+impl Default for PoolOptions {
+    fn default() -> Self {
+        Self {
+            readers: 5,
+            adaptive_readers: None,
+            writer_cache_size_kib: Some(50 * 1024),
+            reader_cache_size_kib: None,
+            mmap_size: None,
+            temp_store: None,
+            track_row_updates: false,
+        }
+    }
+}
+
+/// Values for `PRAGMA temp_store`, controlling where temporary tables and indices are stored.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum TempStore {
+    Default,
+    File,
+    Memory,
+}
+
+impl TempStore {
+    fn as_sql(self) -> &'static str {
+        match self {
+            TempStore::Default => "DEFAULT",
+            TempStore::File => "FILE",
+            TempStore::Memory => "MEMORY",
+        }
+    }
+}
+
 #[derive(Clone, Deserialize)]
 #[serde(transparent)]
 pub struct SqliteUpdateNotification {
@@ -187,20 +516,115 @@ pub struct SqliteUpdateNotification {
 }
 
 struct PoolState {
-    writer: Arc<Mutex<SqliteConnection>>,
+    writer: WriterLock,
     readers: Option<PoolReaders>,
+    /// Set when the writer uses a [RowUpdateTracker] instead of the update hooks of the core
+    /// extension. Declared after the writer so that it outlives the connection.
+    row_updates: Option<Arc<RowUpdateTracker>>,
     table_notifiers: Arc<TableNotifiers>,
+    metrics: OnceLock<Arc<dyn MetricsObserver>>,
+    snapshots: std::sync::Mutex<SnapshotCache>,
 }
 
 struct PoolReaders {
-    take_reader: Receiver<SqliteConnection>,
-    release_reader: Sender<SqliteConnection>,
+    take_reader: Receiver<IdleReader>,
+    release_reader: Sender<IdleReader>,
+    /// Set when readers are opened on demand instead of being passed to the pool upfront.
+    adaptive: Option<AdaptiveReaders>,
+    /// The maximum amount of readers in the pool.
+    capacity: usize,
+}
+
+struct IdleReader {
+    connection: SqliteConnection,
+    released_at: Instant,
+}
+
+struct AdaptiveReaders {
+    open_reader: Box<dyn Fn() -> Result<SqliteConnection, PowerSyncError> + Send + Sync>,
+    /// The amount of reader connections currently opened by the pool.
+    opened: AtomicUsize,
+    max_readers: usize,
+    idle_timeout: Duration,
+}
+
+impl PoolReaders {
+    fn new(
+        connections: impl IntoIterator<Item = SqliteConnection>,
+        adaptive: Option<AdaptiveReaders>,
+    ) -> Self {
+        let (release, consume) = async_channel::unbounded::<IdleReader>();
+        let mut readers = Self {
+            take_reader: consume,
+            release_reader: release,
+            capacity: adaptive.as_ref().map_or(0, |adaptive| adaptive.max_readers),
+            adaptive,
+        };
+
+        for connection in connections {
+            readers.release(connection);
+            if readers.adaptive.is_none() {
+                readers.capacity += 1;
+            }
+        }
+        readers
+    }
+
+    fn release(&self, connection: SqliteConnection) {
+        self.release_reader
+            .send_blocking(IdleReader {
+                connection,
+                released_at: Instant::now(),
+            })
+            .expect("should send connection into pool");
+    }
+
+    /// Takes a reader connection without waiting.
+    ///
+    /// For adaptive pools, this closes readers that have been idle for too long and opens a new
+    /// reader if all of them are in use. Returns [None] if callers need to wait for a reader to
+    /// be returned to the pool.
+    fn try_take(&self) -> Option<SqliteConnection> {
+        while let Ok(idle) = self.take_reader.try_recv() {
+            if let Some(adaptive) = &self.adaptive
+                && !self.take_reader.is_empty()
+                && idle.released_at.elapsed() > adaptive.idle_timeout
+            {
+                // Other readers are available, so close this one (connections are released in
+                // order, so this is the reader that has been idle for the longest time).
+                adaptive.opened.fetch_sub(1, Ordering::SeqCst);
+                continue;
+            }
+
+            return Some(idle.connection);
+        }
+
+        let adaptive = self.adaptive.as_ref()?;
+        adaptive
+            .opened
+            .fetch_update(Ordering::SeqCst, Ordering::SeqCst, |opened| {
+                (opened < adaptive.max_readers).then_some(opened + 1)
+            })
+            .ok()?;
+
+        match (adaptive.open_reader)() {
+            Ok(reader) => Some(reader),
+            Err(e) => {
+                warn!("Could not open additional reader connection: {e}");
+                adaptive.opened.fetch_sub(1, Ordering::SeqCst);
+                None
+            }
+        }
+    }
 }
 
 enum OwnedConnectionLease {
     Writer {
         connection: MutexGuardArc<SqliteConnection>,
         pool: ConnectionPool,
+        /// [SqliteConnection::total_changes] when the lease was created, used to skip querying
+        /// update hooks if nothing was written.
+        changes_before: i64,
     },
     Reader {
         connection: MaybeUninit<SqliteConnection>,
@@ -211,9 +635,15 @@ enum OwnedConnectionLease {
 impl Drop for OwnedConnectionLease {
     fn drop(&mut self) {
         match self {
-            OwnedConnectionLease::Writer { connection, pool } => {
+            OwnedConnectionLease::Writer {
+                connection,
+                pool,
+                changes_before,
+            } => {
                 // Send update notifications for writes made on this connection while leased.
-                let _ = pool.take_update_notifications(connection);
+                if connection.total_changes() != *changes_before {
+                    let _ = pool.take_update_notifications(connection);
+                }
             }
             OwnedConnectionLease::Reader { connection, pool } => {
                 let connection = std::mem::replace(connection, MaybeUninit::uninit());
@@ -222,13 +652,7 @@ impl Drop for OwnedConnectionLease {
                     connection.assume_init()
                 };
 
-                pool.state
-                    .readers
-                    .as_ref()
-                    .unwrap()
-                    .release_reader
-                    .send_blocking(connection)
-                    .expect("should send connection into pool");
+                pool.state.readers.as_ref().unwrap().release(connection);
             }
         }
     }
@@ -239,9 +663,16 @@ impl Drop for OwnedConnectionLease {
 /// The connection is released into the pool when dropped.
 pub struct LeasedConnection {
     inner: OwnedConnectionLease,
+    /// A permit from a [crate::env::PowerSyncHost] limiting concurrent writers, released after
+    /// the connection has been returned to the pool.
+    permit: Option<SemaphoreGuardArc>,
 }
 
 impl LeasedConnection {
+    pub(crate) fn hold_permit(&mut self, permit: Option<SemaphoreGuardArc>) {
+        self.permit = permit;
+    }
+
     pub(crate) fn sqlite_connection(&self) -> &SqliteConnection {
         match &self.inner {
             OwnedConnectionLease::Writer { connection, .. } => connection,
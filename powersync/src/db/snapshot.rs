@@ -0,0 +1,86 @@
+use std::ops::Deref;
+use std::sync::{Arc, Weak};
+
+use async_lock::{Mutex, MutexGuard};
+
+use crate::db::connection::exec_stmt;
+use crate::db::pool::LeasedConnection;
+use crate::error::PowerSyncError;
+
+/// A reader connection pinned to a single read transaction.
+///
+/// Every query run on the connection observes the same state of the database, even if writes
+/// (such as the sync client applying a checkpoint) are committed in the meantime. This allows
+/// consistently reading data across multiple queries, e.g. a list along with counts and details.
+///
+/// The transaction ends and the connection is returned to the pool when the snapshot is dropped.
+/// Since SQLite can't reset the WAL while a reader uses it, snapshots shouldn't be kept around
+/// for longer than necessary.
+pub struct ReadSnapshot {
+    connection: LeasedConnection,
+}
+
+impl ReadSnapshot {
+    pub(crate) fn begin(connection: LeasedConnection) -> Result<Self, PowerSyncError> {
+        connection.sqlite_connection().exec(c"BEGIN")?;
+        let snapshot = Self { connection };
+
+        // Deferred transactions only start reading with their first statement, which pins the
+        // snapshot to the current end of the WAL.
+        exec_stmt(
+            &snapshot
+                .connection
+                .sqlite_connection()
+                .prepare_cached("SELECT 1 FROM sqlite_schema LIMIT 1")?,
+        )?;
+
+        Ok(snapshot)
+    }
+}
+
+impl Deref for ReadSnapshot {
+    type Target = LeasedConnection;
+
+    fn deref(&self) -> &Self::Target {
+        &self.connection
+    }
+}
+
+impl Drop for ReadSnapshot {
+    fn drop(&mut self) {
+        let _ = self.connection.sqlite_connection().exec(c"COMMIT");
+    }
+}
+
+/// A [ReadSnapshot] shared by queries reading the database after the same write.
+pub(crate) struct SharedSnapshot {
+    snapshot: Mutex<ReadSnapshot>,
+}
+
+impl SharedSnapshot {
+    pub fn new(snapshot: ReadSnapshot) -> Arc<Self> {
+        Arc::new(Self {
+            snapshot: Mutex::new(snapshot),
+        })
+    }
+
+    /// Locks the connection of the snapshot, which can only be used by one query at a time.
+    ///
+    /// This is an async lock, so that watchers sharing the snapshot wait for each other's queries
+    /// without blocking threads of the executor.
+    pub async fn lock(&self) -> MutexGuard<'_, ReadSnapshot> {
+        self.snapshot.lock().await
+    }
+}
+
+/// The [SharedSnapshot] of the most recent write, cleared when another write is committed.
+///
+/// The cache only keeps a weak reference, so that the snapshot's reader returns to the pool once
+/// the queries notified about a write are done with it. Keeping the read transaction open while
+/// the database is idle would prevent SQLite from restarting the WAL.
+#[derive(Default)]
+pub(crate) struct SnapshotCache {
+    /// Incremented for each committed write that changed the database.
+    pub generation: u64,
+    pub current: Weak<SharedSnapshot>,
+}
@@ -89,11 +89,13 @@ impl<'a> SyncStream<'a> {
         let writer = TransactionGuard::new(writer.sqlite_connection_mut())?;
 
         {
-            let stmt = writer.inner.prepare("SELECT powersync_control(?, ?)")?;
+            let stmt = writer
+                .inner
+                .prepare_cached("SELECT powersync_control(?, ?)")?;
             stmt.bind_text(1, "subscriptions", Destructor::STATIC)?;
             // Fine because we drop the statement before serialized
             stmt.bind_text(2, &serialized, Destructor::STATIC)?;
-            exec_stmt(stmt)?;
+            exec_stmt(&stmt)?;
         }
 
         writer.commit()?;
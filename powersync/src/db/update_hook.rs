@@ -0,0 +1,394 @@
+use std::collections::{HashMap, HashSet};
+use std::ffi::{CStr, c_char, c_int, c_void};
+use std::mem::take;
+use std::sync::{Arc, Mutex};
+
+use powersync_sqlite_nostd::ResultCode;
+use powersync_sqlite_nostd::bindings::{
+    SQLITE_DELETE, SQLITE_INSERT, sqlite3_commit_hook, sqlite3_rollback_hook, sqlite3_update_hook,
+};
+
+use crate::PowerSyncDatabase;
+use crate::db::connection::SqliteConnection;
+use crate::error::PowerSyncError;
+
+// The preupdate hook is only available if SQLite has been compiled with
+// `SQLITE_ENABLE_PREUPDATE_HOOK`, so these functions are declared here instead of being part of
+// the bindings.
+#[cfg(feature = "preupdate_hook")]
+unsafe extern "C" {
+    fn sqlite3_preupdate_hook(
+        db: *mut c_void,
+        hook: Option<
+            unsafe extern "C" fn(
+                ctx: *mut c_void,
+                db: *mut c_void,
+                op: c_int,
+                db_name: *const c_char,
+                table: *const c_char,
+                old_rowid: i64,
+                new_rowid: i64,
+            ),
+        >,
+        ctx: *mut c_void,
+    ) -> *mut c_void;
+    fn sqlite3_preupdate_old(db: *mut c_void, column: c_int, value: *mut *mut c_void) -> c_int;
+    fn sqlite3_value_text(value: *mut c_void) -> *const c_char;
+}
+
+/// The kind of write that changed a row.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum RowUpdateKind {
+    Insert,
+    Update,
+    Delete,
+}
+
+/// A row that has been changed by a write, as reported to filters of
+/// [crate::PowerSyncDatabase::watch_table_rows].
+#[derive(Clone, Copy, Debug)]
+pub struct RowUpdate<'a> {
+    /// The name of the table as used by [crate::PowerSyncDatabase::watch_tables], e.g. `todos` for
+    /// writes to the `ps_data__todos` table backing a PowerSync view.
+    pub table: &'a str,
+    pub kind: RowUpdateKind,
+    /// The PowerSync `id` of the row.
+    pub id: &'a str,
+}
+
+/// A row recorded by a [RowUpdateTracker].
+#[derive(Debug)]
+struct TrackedRow {
+    kind: RowUpdateKind,
+    rowid: i64,
+    /// The PowerSync `id` of the row, if it's known.
+    ///
+    /// Ids of inserted and updated rows are resolved by [RowUpdates::resolve_ids], ids of deleted
+    /// rows are only known if they've been captured by a preupdate hook.
+    id: Option<String>,
+}
+
+/// Tables and rows written to on a connection, collected by a [RowUpdateTracker].
+#[derive(Default)]
+pub struct RowUpdates {
+    pub tables: HashSet<String>,
+    /// Changed rows for each table in [Self::tables], or [None] if more than
+    /// [RowUpdateTracker::MAX_ROWS_PER_TABLE] rows have changed.
+    rows: HashMap<String, Option<Vec<TrackedRow>>>,
+}
+
+impl RowUpdates {
+    /// Calls `f` for each changed row in `table`, returning whether `f` has returned `true` for
+    /// any row.
+    ///
+    /// If individual rows of the table or the id of a changed row are unknown, this returns `true`
+    /// without calling `f` for those rows.
+    pub fn any_row(&self, table: &str, f: impl Fn(&RowUpdate) -> bool) -> bool {
+        let Some(Some(rows)) = self.rows.get(table) else {
+            return true;
+        };
+
+        let table = PowerSyncDatabase::watched_table_name(table);
+        rows.iter().any(|row| match &row.id {
+            Some(id) => f(&RowUpdate {
+                table,
+                kind: row.kind,
+                id,
+            }),
+            None => true,
+        })
+    }
+
+    pub(crate) fn record(
+        &mut self,
+        table: &str,
+        kind: RowUpdateKind,
+        rowid: i64,
+        id: Option<String>,
+    ) {
+        let row = TrackedRow { kind, rowid, id };
+        let Some(rows) = self.rows.get_mut(table) else {
+            self.tables.insert(table.to_string());
+            self.rows.insert(table.to_string(), Some(vec![row]));
+            return;
+        };
+
+        if let Some(tracked) = rows {
+            if tracked.len() >= RowUpdateTracker::MAX_ROWS_PER_TABLE {
+                *rows = None;
+            } else {
+                tracked.push(row);
+            }
+        }
+    }
+
+    /// Looks up the PowerSync `id` of inserted and updated rows in PowerSync tables by their
+    /// `rowid`.
+    ///
+    /// This must run on the writer before it's released, since rowids of PowerSync tables aren't
+    /// stable: The sync client replaces rows, assigning them a new rowid. Rows that have been
+    /// deleted since they were recorded keep an unknown id.
+    pub(crate) fn resolve_ids(&mut self, conn: &SqliteConnection) -> Result<(), PowerSyncError> {
+        for (table, rows) in &mut self.rows {
+            let Some(rows) = rows else {
+                continue;
+            };
+
+            if PowerSyncDatabase::watched_table_name(table).len() == table.len() {
+                // Not a PowerSync table, so there's no id column to resolve.
+                continue;
+            }
+
+            let mut unresolved = rows
+                .iter_mut()
+                .filter(|row| row.id.is_none() && row.kind != RowUpdateKind::Delete)
+                .peekable();
+            if unresolved.peek().is_none() {
+                continue;
+            }
+
+            let stmt = conn.prepare_cached(&format!(
+                "SELECT id FROM \"{}\" WHERE rowid = ?",
+                table.replace('"', "\"\"")
+            ))?;
+            for row in unresolved {
+                stmt.bind_int64(1, row.rowid)?;
+                if stmt.step()? == ResultCode::ROW {
+                    row.id = Some(stmt.column_text(0)?.to_string());
+                }
+                stmt.reset()?;
+            }
+        }
+
+        Ok(())
+    }
+
+    /// Adds all updates from `other` to this set.
+    fn extend(&mut self, other: RowUpdates) {
+        for (table, rows) in other.rows {
+            match rows {
+                Some(rows) => {
+                    for row in rows {
+                        self.record(&table, row.kind, row.rowid, row.id);
+                    }
+                }
+                None => {
+                    self.tables.insert(table.clone());
+                    self.rows.insert(table, None);
+                }
+            }
+        }
+    }
+}
+
+/// Collects updated tables and rows with a `sqlite3_update_hook` on the writer connection.
+///
+/// This is used instead of the update hooks installed by the core extension if the pool has been
+/// opened with [crate::PoolOptions::with_row_update_tracking].
+#[derive(Default)]
+pub struct RowUpdateTracker {
+    state: Mutex<TrackerState>,
+}
+
+#[derive(Default)]
+struct TrackerState {
+    /// Updates made in the current transaction, which are discarded if it's rolled back.
+    pending: RowUpdates,
+    /// Updates from committed transactions that haven't been taken yet.
+    committed: RowUpdates,
+}
+
+impl RowUpdateTracker {
+    /// Bounds the memory used to track rows in large writes, such as when applying a sync
+    /// checkpoint. Listeners treat all rows as potentially changed afterwards.
+    const MAX_ROWS_PER_TABLE: usize = 1024;
+
+    /// Installs update, commit and rollback hooks on the connection.
+    ///
+    /// With the `preupdate_hook` feature, this also installs a preupdate hook capturing the ids of
+    /// deleted rows, which can't be resolved after the write.
+    ///
+    /// SQLite only supports one hook of each kind per connection, so this replaces any hooks the
+    /// application has installed on the writer. The tracker must outlive the connection.
+    pub fn install(self: &Arc<Self>, conn: &SqliteConnection) {
+        let ctx = Arc::as_ptr(self) as *mut c_void;
+
+        unsafe {
+            // Safety: The pool keeps the tracker alive for as long as the writer connection.
+            let db = conn.handle().cast();
+            sqlite3_update_hook(db, Some(Self::update_hook), ctx);
+            sqlite3_commit_hook(db, Some(Self::commit_hook), ctx);
+            sqlite3_rollback_hook(db, Some(Self::rollback_hook), ctx);
+            #[cfg(feature = "preupdate_hook")]
+            sqlite3_preupdate_hook(db.cast(), Some(Self::preupdate_hook), ctx);
+        }
+    }
+
+    /// Returns and clears updates committed since the last call.
+    pub fn take(&self) -> RowUpdates {
+        take(&mut self.state.lock().unwrap().committed)
+    }
+
+    /// ## Safety
+    ///
+    /// `ctx` must be a pointer passed to [Self::install].
+    unsafe fn from_context<'a>(ctx: *mut c_void) -> &'a Self {
+        unsafe { &*(ctx as *const RowUpdateTracker) }
+    }
+
+    unsafe extern "C" fn update_hook(
+        ctx: *mut c_void,
+        op: c_int,
+        _db: *const c_char,
+        table: *const c_char,
+        rowid: i64,
+    ) {
+        let tracker = unsafe { Self::from_context(ctx) };
+        let Ok(table) = unsafe { CStr::from_ptr(table) }.to_str() else {
+            return;
+        };
+
+        let kind = match op as u32 {
+            SQLITE_INSERT => RowUpdateKind::Insert,
+            // Deletes are recorded with their id by the preupdate hook.
+            #[cfg(feature = "preupdate_hook")]
+            SQLITE_DELETE => return,
+            #[cfg(not(feature = "preupdate_hook"))]
+            SQLITE_DELETE => RowUpdateKind::Delete,
+            _ => RowUpdateKind::Update,
+        };
+
+        tracker
+            .state
+            .lock()
+            .unwrap()
+            .pending
+            .record(table, kind, rowid, None);
+    }
+
+    #[cfg(feature = "preupdate_hook")]
+    unsafe extern "C" fn preupdate_hook(
+        ctx: *mut c_void,
+        db: *mut c_void,
+        op: c_int,
+        _db_name: *const c_char,
+        table: *const c_char,
+        old_rowid: i64,
+        _new_rowid: i64,
+    ) {
+        if op as u32 != SQLITE_DELETE {
+            return;
+        }
+
+        let tracker = unsafe { Self::from_context(ctx) };
+        let Ok(table) = unsafe { CStr::from_ptr(table) }.to_str() else {
+            return;
+        };
+
+        // The id is the first column of PowerSync tables. Other tables are recorded without an id.
+        let mut id = None;
+        if PowerSyncDatabase::watched_table_name(table).len() != table.len() {
+            let mut value = std::ptr::null_mut();
+            // Safety: We're in a preupdate hook for a delete, so reading old values is allowed.
+            if unsafe { sqlite3_preupdate_old(db, 0, &mut value) } == 0 {
+                let text = unsafe { sqlite3_value_text(value) };
+                if !text.is_null() {
+                    id = unsafe { CStr::from_ptr(text) }
+                        .to_str()
+                        .ok()
+                        .map(str::to_string);
+                }
+            }
+        }
+
+        tracker
+            .state
+            .lock()
+            .unwrap()
+            .pending
+            .record(table, RowUpdateKind::Delete, old_rowid, id);
+    }
+
+    unsafe extern "C" fn commit_hook(ctx: *mut c_void) -> c_int {
+        let tracker = unsafe { Self::from_context(ctx) };
+        let mut state = tracker.state.lock().unwrap();
+        let pending = take(&mut state.pending);
+        state.committed.extend(pending);
+
+        // Returning zero lets the commit proceed.
+        0
+    }
+
+    unsafe extern "C" fn rollback_hook(ctx: *mut c_void) {
+        let tracker = unsafe { Self::from_context(ctx) };
+        tracker.state.lock().unwrap().pending = Default::default();
+    }
+}
+
+#[cfg(test)]
+mod test {
+    use super::{RowUpdateKind, RowUpdates};
+
+    #[test]
+    fn tracks_rows() {
+        let mut updates = RowUpdates::default();
+        updates.record("a", RowUpdateKind::Insert, 1, Some("x".to_string()));
+        updates.record("a", RowUpdateKind::Update, 2, Some("y".to_string()));
+
+        assert!(updates.tables.contains("a"));
+        assert!(updates.any_row("a", |row| row.id == "y"));
+        assert!(!updates.any_row("a", |row| row.id == "z"));
+        assert!(!updates.any_row("a", |row| row.kind == RowUpdateKind::Delete));
+    }
+
+    #[test]
+    fn matches_rows_without_id() {
+        let mut updates = RowUpdates::default();
+        updates.record("a", RowUpdateKind::Insert, 1, Some("x".to_string()));
+        assert!(!updates.any_row("a", |_| false));
+
+        // Rows with an unknown id could be the ones the filter is looking for.
+        updates.record("a", RowUpdateKind::Delete, 2, None);
+        assert!(updates.any_row("a", |_| false));
+    }
+
+    #[test]
+    fn reports_names_of_views() {
+        let mut updates = RowUpdates::default();
+        updates.record(
+            "ps_data__todos",
+            RowUpdateKind::Insert,
+            1,
+            Some("x".to_string()),
+        );
+
+        assert!(updates.any_row("ps_data__todos", |row| row.table == "todos"));
+    }
+
+    #[test]
+    fn falls_back_to_table_for_large_writes() {
+        let mut updates = RowUpdates::default();
+        for i in 0..2000 {
+            updates.record("a", RowUpdateKind::Insert, i, Some(i.to_string()));
+        }
+
+        // Individual rows are no longer known, so this should match.
+        assert!(updates.any_row("a", |row| row.id == "-1"));
+    }
+
+    #[test]
+    fn extend_merges_updates() {
+        let mut committed = RowUpdates::default();
+        committed.record("a", RowUpdateKind::Insert, 1, Some("x".to_string()));
+
+        let mut pending = RowUpdates::default();
+        pending.record("a", RowUpdateKind::Delete, 2, Some("y".to_string()));
+        pending.record("b", RowUpdateKind::Insert, 3, Some("z".to_string()));
+        committed.extend(pending);
+
+        assert!(committed.tables.contains("b"));
+        assert!(committed.any_row("a", |row| row.id == "x"));
+        assert!(committed.any_row("a", |row| row.kind == RowUpdateKind::Delete));
+        assert!(!committed.any_row("b", |row| row.id == "x"));
+    }
+}
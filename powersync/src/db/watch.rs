@@ -2,28 +2,70 @@ use event_listener::{Event, EventListener};
 use futures_lite::{FutureExt, Stream, ready};
 use std::mem::take;
 use std::ops::DerefMut;
+use std::sync::RwLock;
 use std::sync::atomic::{AtomicBool, Ordering};
 use std::{
-    collections::HashSet,
+    collections::{HashMap, HashSet},
     pin::Pin,
     sync::{Arc, Mutex},
     task::{Context, Poll},
 };
 
+use crate::db::update_hook::{RowUpdate, RowUpdates};
+
 #[derive(Default)]
 pub struct TableNotifiers {
-    active: Mutex<Vec<Arc<TableListenerState>>>,
+    /// The current set of listeners.
+    ///
+    /// The registry is never modified in place: Adding or removing listeners installs an updated
+    /// copy. So dispatching updates only holds the lock for as long as it takes to clone the
+    /// [Arc], and doesn't block registering or dropping listeners.
+    registry: RwLock<Arc<ListenerRegistry>>,
+}
+
+/// Listeners indexed by the tables they're interested in.
+#[derive(Default, Clone)]
+struct ListenerRegistry {
+    by_table: HashMap<String, Vec<Arc<TableListenerState>>>,
+    all: Vec<Arc<TableListenerState>>,
 }
 
 impl TableNotifiers {
     pub fn notify_updates(&self, updates: &HashSet<String>) {
-        let guard = self.active.lock().unwrap();
+        self.dispatch(updates, None);
+    }
 
-        for listener in &*guard {
+    /// Like [Self::notify_updates], but also allows listeners with a row filter to check whether
+    /// they're interested in affected rows.
+    pub fn notify_row_updates(&self, updates: &RowUpdates) {
+        self.dispatch(&updates.tables, Some(updates));
+    }
+
+    fn dispatch(&self, updates: &HashSet<String>, rows: Option<&RowUpdates>) {
+        let registry = self.registry.read().unwrap().clone();
+
+        for table in updates {
+            if let Some(listeners) = registry.by_table.get(table) {
+                for listener in listeners {
+                    if listener.matches_rows(table, rows) {
+                        listener.dispatch_updates(updates);
+                    }
+                }
+            }
+        }
+
+        for listener in &registry.all {
             listener.dispatch_updates(updates);
         }
     }
 
+    fn update_registry(&self, update: impl FnOnce(&mut ListenerRegistry)) {
+        let mut guard = self.registry.write().unwrap();
+        let mut registry = ListenerRegistry::clone(&guard);
+        update(&mut registry);
+        *guard = Arc::new(registry);
+    }
+
     /// Returns a [Stream] emitting an empty event every time one of the tables updates.
     pub fn listen(
         self: &Arc<Self>,
@@ -35,10 +77,18 @@ impl TableNotifiers {
             config: config.0,
         });
 
-        {
-            let mut guard = self.active.lock().unwrap();
-            guard.push(listener.clone());
-        }
+        self.update_registry(|registry| match &listener.config {
+            ListenerConfigurationInner::IfMatches(matches) => {
+                for table in &matches.filter {
+                    registry
+                        .by_table
+                        .entry(table.clone())
+                        .or_default()
+                        .push(listener.clone());
+                }
+            }
+            ListenerConfigurationInner::All(_) => registry.all.push(listener.clone()),
+        });
 
         TableListener {
             state: listener,
@@ -80,8 +130,24 @@ impl Stream for TableListener {
 
 impl Drop for TableListener {
     fn drop(&mut self) {
-        let mut guard = self.state.notifiers.active.lock().unwrap();
-        guard.retain(|listener| !Arc::ptr_eq(listener, &self.state));
+        let state = &self.state;
+        let is_other = |listener: &Arc<TableListenerState>| !Arc::ptr_eq(listener, state);
+
+        state
+            .notifiers
+            .update_registry(|registry| match &state.config {
+                ListenerConfigurationInner::IfMatches(matches) => {
+                    for table in &matches.filter {
+                        if let Some(listeners) = registry.by_table.get_mut(table) {
+                            listeners.retain(is_other);
+                            if listeners.is_empty() {
+                                registry.by_table.remove(table);
+                            }
+                        }
+                    }
+                }
+                ListenerConfigurationInner::All(_) => registry.all.retain(is_other),
+            });
     }
 }
 
@@ -102,6 +168,23 @@ impl ListenerConfiguration {
     pub fn if_matches(filter: HashSet<String>, emit_initially: bool) -> Self {
         Self(ListenerConfigurationInner::IfMatches(EmitIfMatches {
             filter,
+            row_filter: None,
+            dirty: AtomicBool::new(emit_initially),
+        }))
+    }
+
+    /// Like [Self::if_matches], but only emitting when `row_filter` matches an updated row.
+    ///
+    /// Updated rows are only known if the pool tracks them, otherwise every update to a table in
+    /// `filter` is considered a match.
+    pub fn if_rows_match(
+        filter: HashSet<String>,
+        row_filter: impl Fn(&RowUpdate) -> bool + Send + Sync + 'static,
+        emit_initially: bool,
+    ) -> Self {
+        Self(ListenerConfigurationInner::IfMatches(EmitIfMatches {
+            filter,
+            row_filter: Some(Box::new(row_filter)),
             dirty: AtomicBool::new(emit_initially),
         }))
     }
@@ -140,9 +223,13 @@ impl ListenerConfigurationInner {
 /// time any filtered table is updated.
 struct EmitIfMatches {
     filter: HashSet<String>,
+    /// An optional filter further restricting updates to rows the listener is interested in.
+    row_filter: Option<RowFilter>,
     dirty: AtomicBool,
 }
 
+type RowFilter = Box<dyn Fn(&RowUpdate) -> bool + Send + Sync>;
+
 /// Emit all table updates. Updates are buffered into a set if the downstream consumer can't keep
 /// up.
 struct EmitAll {
@@ -159,12 +246,31 @@ impl TableListenerState {
         self.config.take_updates()
     }
 
+    /// Whether updates to `table` are relevant for this listener, based on the row filter of the
+    /// listener and the updated `rows` (if known).
+    fn matches_rows(&self, table: &str, rows: Option<&RowUpdates>) -> bool {
+        match (&self.config, rows) {
+            (
+                ListenerConfigurationInner::IfMatches(EmitIfMatches {
+                    row_filter: Some(row_filter),
+                    ..
+                }),
+                Some(rows),
+            ) => rows.any_row(table, row_filter),
+            _ => true,
+        }
+    }
+
+    /// Marks this listener as having pending updates.
+    ///
+    /// For listeners filtering tables, this must only be called if `updates` contains one of the
+    /// tables in the filter.
     fn dispatch_updates(&self, updates: &HashSet<String>) {
         match self.config {
             ListenerConfigurationInner::IfMatches(ref filter) => {
-                if !filter.filter.is_disjoint(updates)
-                    && !filter.dirty.fetch_or(true, Ordering::SeqCst)
-                {
+                // The registry only dispatches updates affecting at least one table in the filter,
+                // so we don't have to check that again.
+                if !filter.dirty.fetch_or(true, Ordering::SeqCst) {
                     // Not marked as dirty before, so notify pending listeners, if any.
                     self.notifier.notify(usize::MAX);
                 }
@@ -193,6 +299,7 @@ mod test {
         task::{Context, Poll, Waker},
     };
 
+    use crate::db::update_hook::{RowUpdateKind, RowUpdates};
     use crate::db::watch::{ListenerConfiguration, TableNotifiers};
 
     #[test]
@@ -257,16 +364,89 @@ mod test {
         let notifiers = Arc::new(TableNotifiers::default());
         let stream = notifiers.listen(ListenerConfiguration::all());
 
+        let filtered = notifiers.listen(ListenerConfiguration::if_matches(
+            HashSet::from(["a".to_string()]),
+            false,
+        ));
+
         {
-            let guard = notifiers.active.lock().unwrap();
-            assert_eq!(guard.len(), 1);
+            let registry = notifiers.registry.read().unwrap();
+            assert_eq!(registry.all.len(), 1);
+            assert_eq!(registry.by_table.len(), 1);
         }
 
         drop(stream);
+        drop(filtered);
 
         {
-            let guard = notifiers.active.lock().unwrap();
-            assert_eq!(guard.len(), 0);
+            let registry = notifiers.registry.read().unwrap();
+            assert_eq!(registry.all.len(), 0);
+            assert_eq!(registry.by_table.len(), 0);
         }
     }
+
+    #[test]
+    fn only_notifies_affected_listeners() {
+        let notifier = Arc::new(TableNotifiers::default());
+        let mut noop = Context::from_waker(Waker::noop());
+
+        let mut a = notifier.listen(ListenerConfiguration::if_matches(
+            HashSet::from(["a".to_string()]),
+            false,
+        ));
+        let mut b = notifier.listen(ListenerConfiguration::if_matches(
+            HashSet::from(["a".to_string(), "b".to_string()]),
+            false,
+        ));
+
+        notifier.notify_updates(&HashSet::from(["b".to_string()]));
+        assert_eq!(a.poll_next(&mut noop), Poll::Pending);
+        assert_eq!(
+            b.poll_next(&mut noop),
+            Poll::Ready(Some(Default::default()))
+        );
+
+        // Updating multiple tables in the filter emits a single event.
+        notifier.notify_updates(&HashSet::from(["a".to_string(), "b".to_string()]));
+        assert_eq!(
+            a.poll_next(&mut noop),
+            Poll::Ready(Some(Default::default()))
+        );
+        assert_eq!(
+            b.poll_next(&mut noop),
+            Poll::Ready(Some(Default::default()))
+        );
+        assert_eq!(b.poll_next(&mut noop), Poll::Pending);
+    }
+
+    #[test]
+    fn filters_rows() {
+        let notifier = Arc::new(TableNotifiers::default());
+        let mut noop = Context::from_waker(Waker::noop());
+
+        let mut stream = notifier.listen(ListenerConfiguration::if_rows_match(
+            HashSet::from(["a".to_string()]),
+            |row| row.id == "x",
+            false,
+        ));
+
+        let mut updates = RowUpdates::default();
+        updates.record("a", RowUpdateKind::Insert, 2, Some("y".to_string()));
+        notifier.notify_row_updates(&updates);
+        assert_eq!(stream.poll_next(&mut noop), Poll::Pending);
+
+        updates.record("a", RowUpdateKind::Update, 1, Some("x".to_string()));
+        notifier.notify_row_updates(&updates);
+        assert_eq!(
+            stream.poll_next(&mut noop),
+            Poll::Ready(Some(Default::default()))
+        );
+
+        // Without tracked rows, all updates to the table match.
+        notifier.notify_updates(&HashSet::from(["a".to_string()]));
+        assert_eq!(
+            stream.poll_next(&mut noop),
+            Poll::Ready(Some(Default::default()))
+        );
+    }
 }
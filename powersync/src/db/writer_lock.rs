@@ -0,0 +1,251 @@
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::{Arc, Mutex as StdMutex};
+use std::time::{Duration, Instant};
+
+use async_lock::{Mutex, MutexGuardArc, Semaphore, SemaphoreGuardArc};
+use event_listener::Event;
+use scopeguard::defer;
+
+use crate::db::connection::SqliteConnection;
+
+/// Whether a writer lease is requested on behalf of the application or for background work.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub(crate) enum WriterPriority {
+    /// Writes made by the application, including completing CRUD transactions.
+    Foreground,
+    /// Applying sync lines, which yields to foreground writers.
+    Background,
+}
+
+/// Wait times for obtaining the writer connection in a [crate::ConnectionPool].
+#[derive(Clone, Copy, Debug, Default)]
+pub struct WriterLockStats {
+    /// Waits of writers leased by the application.
+    pub foreground: LockWaitStats,
+    /// Waits of the sync client applying downloaded lines.
+    pub background: LockWaitStats,
+}
+
+/// Wait times for a kind of writer lease, see [WriterLockStats].
+#[derive(Clone, Copy, Debug, Default)]
+pub struct LockWaitStats {
+    /// The amount of times the writer has been leased.
+    pub acquisitions: u64,
+    /// The total time spent waiting for leases.
+    pub total_wait: Duration,
+    /// The longest time spent waiting for a single lease.
+    pub max_wait: Duration,
+}
+
+impl LockWaitStats {
+    fn record(&mut self, wait: Duration) {
+        self.acquisitions += 1;
+        self.total_wait += wait;
+        self.max_wait = self.max_wait.max(wait);
+    }
+}
+
+/// A mutex around the writer connection that lets foreground writers preempt background writers.
+///
+/// With a plain [Mutex], a foreground writer would queue behind the sync client, which re-acquires
+/// the writer for every batch of sync lines. Here, background writers wait for
+/// pending foreground writers before locking the connection, and hand the lock over if a
+/// foreground writer started waiting while they were queued. A foreground writer thus waits at most
+/// for the batch that is currently being applied.
+pub(crate) struct WriterLock {
+    connection: Arc<Mutex<SqliteConnection>>,
+    preemption: Preemption,
+    stats: StdMutex<WriterLockStats>,
+}
+
+impl WriterLock {
+    pub fn new(connection: SqliteConnection) -> Self {
+        Self {
+            connection: Arc::new(Mutex::new(connection)),
+            preemption: Preemption::default(),
+            stats: Default::default(),
+        }
+    }
+
+    pub async fn lock(&self, priority: WriterPriority) -> MutexGuardArc<SqliteConnection> {
+        let started = Instant::now();
+        let guard = self
+            .preemption
+            .acquire(priority, || self.connection.lock_arc())
+            .await;
+
+        self.record_wait(priority, started.elapsed());
+        guard
+    }
+
+    pub fn lock_blocking(&self) -> MutexGuardArc<SqliteConnection> {
+        let started = Instant::now();
+        self.preemption.start_foreground_wait();
+        let guard = self.connection.lock_arc_blocking();
+        self.preemption.finish_foreground_wait();
+
+        self.record_wait(WriterPriority::Foreground, started.elapsed());
+        guard
+    }
+
+    pub fn stats(&self) -> WriterLockStats {
+        *self.stats.lock().unwrap()
+    }
+
+    fn record_wait(&self, priority: WriterPriority, wait: Duration) {
+        let mut stats = self.stats.lock().unwrap();
+        match priority {
+            WriterPriority::Foreground => stats.foreground.record(wait),
+            WriterPriority::Background => stats.background.record(wait),
+        }
+    }
+}
+
+/// Permits for the writer connections of all databases of a [crate::env::PowerSyncHost], which
+/// are handed to foreground writers before background writers like a [WriterLock].
+///
+/// Permits are acquired after locking the writer of a database, so that a database only holds a
+/// permit while it's actually using its writer.
+pub(crate) struct WriterPermits {
+    semaphore: Arc<Semaphore>,
+    preemption: Preemption,
+}
+
+impl WriterPermits {
+    pub fn new(permits: usize) -> Self {
+        Self {
+            semaphore: Arc::new(Semaphore::new(permits)),
+            preemption: Preemption::default(),
+        }
+    }
+
+    pub async fn acquire(&self, priority: WriterPriority) -> SemaphoreGuardArc {
+        self.preemption
+            .acquire(priority, || self.semaphore.acquire_arc())
+            .await
+    }
+}
+
+/// Tracks waiting foreground writers so that background writers can yield to them.
+#[derive(Default)]
+struct Preemption {
+    /// The amount of foreground writers waiting.
+    foreground_waiting: AtomicUsize,
+    /// Notified when [Self::foreground_waiting] drops to zero.
+    foreground_idle: Event,
+}
+
+impl Preemption {
+    /// Acquires a guard with `acquire`.
+    ///
+    /// Background writers wait for pending foreground writers first, and drop the guard to retry
+    /// if a foreground writer started waiting while they were queued.
+    async fn acquire<G, F: Future<Output = G>>(
+        &self,
+        priority: WriterPriority,
+        acquire: impl Fn() -> F,
+    ) -> G {
+        match priority {
+            WriterPriority::Foreground => {
+                self.start_foreground_wait();
+                // Also decrement the counter if this future is dropped while waiting.
+                defer! { self.finish_foreground_wait() }
+
+                acquire().await
+            }
+            WriterPriority::Background => loop {
+                self.wait_for_foreground_writers().await;
+
+                let guard = acquire().await;
+                if self.foreground_waiting.load(Ordering::SeqCst) == 0 {
+                    break guard;
+                }
+
+                // A foreground writer has started waiting while this writer was queued, dropping
+                // the guard hands the resource to the next writer in line.
+            },
+        }
+    }
+
+    fn start_foreground_wait(&self) {
+        self.foreground_waiting.fetch_add(1, Ordering::SeqCst);
+    }
+
+    fn finish_foreground_wait(&self) {
+        if self.foreground_waiting.fetch_sub(1, Ordering::SeqCst) == 1 {
+            self.foreground_idle.notify(usize::MAX);
+        }
+    }
+
+    async fn wait_for_foreground_writers(&self) {
+        while self.foreground_waiting.load(Ordering::SeqCst) > 0 {
+            let listener = self.foreground_idle.listen();
+            if self.foreground_waiting.load(Ordering::SeqCst) == 0 {
+                return;
+            }
+
+            listener.await;
+        }
+    }
+}
+
+#[cfg(all(test, feature = "rusqlite"))]
+mod test {
+    use std::pin::pin;
+
+    use futures_lite::future::{self, poll_once};
+    use rusqlite::Connection;
+
+    use super::{WriterLock, WriterPermits, WriterPriority};
+
+    #[test]
+    fn foreground_writers_preempt_background_writers() {
+        let lock = WriterLock::new(Connection::open_in_memory().unwrap().into());
+
+        future::block_on(async {
+            let held = lock.lock(WriterPriority::Background).await;
+            let mut background = pin!(lock.lock(WriterPriority::Background));
+            assert!(poll_once(&mut background).await.is_none());
+
+            // The foreground writer starts waiting after the background writer.
+            let mut foreground = pin!(lock.lock(WriterPriority::Foreground));
+            assert!(poll_once(&mut foreground).await.is_none());
+            drop(held);
+
+            // The background writer hands the connection over instead of taking it.
+            assert!(poll_once(&mut background).await.is_none());
+            let foreground = foreground.await;
+            assert!(poll_once(&mut background).await.is_none());
+
+            drop(foreground);
+            background.await;
+        });
+
+        let stats = lock.stats();
+        assert_eq!(stats.foreground.acquisitions, 1);
+        assert_eq!(stats.background.acquisitions, 2);
+    }
+
+    #[test]
+    fn foreground_writers_preempt_background_permits() {
+        let permits = WriterPermits::new(1);
+
+        future::block_on(async {
+            let held = permits.acquire(WriterPriority::Foreground).await;
+            let mut background = pin!(permits.acquire(WriterPriority::Background));
+            assert!(poll_once(&mut background).await.is_none());
+
+            let mut foreground = pin!(permits.acquire(WriterPriority::Foreground));
+            assert!(poll_once(&mut foreground).await.is_none());
+            drop(held);
+
+            // The permit goes to the foreground writer, even though it started waiting later.
+            assert!(poll_once(&mut background).await.is_none());
+            let foreground = foreground.await;
+            assert!(poll_once(&mut background).await.is_none());
+
+            drop(foreground);
+            background.await;
+        });
+    }
+}
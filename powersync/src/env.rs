@@ -1,10 +1,14 @@
 use super::db::pool::ConnectionPool;
+use crate::db::writer_lock::{WriterPermits, WriterPriority};
 use crate::error::{PowerSyncError, RawPowerSyncError};
 use crate::http::HttpClient;
+use async_lock::{Semaphore, SemaphoreGuardArc};
 use num_traits::FromPrimitive;
 use powersync_core::powersync_init_static;
 use powersync_sqlite_nostd::ResultCode;
-use std::{pin::Pin, time::Duration};
+use std::{pin::Pin, sync::Arc, time::Duration};
+
+pub use crate::util::BlockingPool;
 
 /// All external dependencies required for the PowerSync SDK.
 ///
@@ -18,6 +22,13 @@ pub struct PowerSyncEnvironment {
     pub(crate) pool: ConnectionPool,
     /// The [Timer] implementation used to delay sync iterations after errors.
     pub(crate) timer: &'static (dyn Timer + Send + Sync),
+    /// Limits shared with other databases, if this environment has been created by a
+    /// [PowerSyncHost].
+    pub(crate) limits: Option<Arc<HostPermits>>,
+    /// Threads used to run SQLite work of the SDK, if configured.
+    pub(crate) blocking: Option<BlockingPool>,
+    /// Receives measurements of sync and database operations, if configured.
+    pub(crate) metrics: Option<Arc<dyn MetricsObserver>>,
 }
 
 impl PowerSyncEnvironment {
@@ -30,9 +41,57 @@ impl PowerSyncEnvironment {
             client: Box::new(client),
             pool,
             timer,
+            limits: None,
+            blocking: None,
+            metrics: None,
         }
     }
 
+    /// Runs SQLite work of the SDK on the threads of a [BlockingPool] instead of the futures
+    /// polling them.
+    ///
+    /// This covers applying sync lines, reading and completing local writes for uploads and the
+    /// queries of the upload actor. Watched queries still run inline in the futures polling their
+    /// streams, see [BlockingPool] for details.
+    pub fn with_blocking_pool(mut self, pool: BlockingPool) -> Self {
+        self.blocking = Some(pool);
+        self
+    }
+
+    /// Reports measurements of the sync client and connection pool to `observer`.
+    ///
+    /// The observer is also installed on the [ConnectionPool] of this environment to measure
+    /// connection waits and update notifications. A pool only reports to the first observer
+    /// installed on it.
+    pub fn with_metrics_observer(mut self, observer: Arc<dyn MetricsObserver>) -> Self {
+        self.pool.set_metrics_observer(observer.clone());
+        self.metrics = Some(observer);
+        self
+    }
+
+    /// The installed [MetricsObserver], or [None] if measurements are disabled.
+    pub(crate) fn metrics(&self) -> Option<&dyn MetricsObserver> {
+        self.metrics.as_deref()
+    }
+
+    /// Waits for a permit to use the writer connection, if a [PowerSyncHost] limits concurrent
+    /// writers.
+    ///
+    /// This must be called after locking the writer connection, see [WriterPermits].
+    pub(crate) async fn writer_permit(
+        &self,
+        priority: WriterPriority,
+    ) -> Option<SemaphoreGuardArc> {
+        let permits = self.limits.as_ref()?.writers.as_ref()?;
+        Some(permits.acquire(priority).await)
+    }
+
+    /// Waits for a permit to open a sync stream, if a [PowerSyncHost] limits concurrent streams.
+    pub(crate) async fn sync_stream_permit(&self) -> Option<SemaphoreGuardArc> {
+        let permits = self.limits.as_ref()?.sync_streams.as_ref()?;
+        Some(permits.acquire_arc().await)
+    }
+
     /// Calls `sqlite3_auto_extension` with the statically-linked core extension.
     ///
     /// This needs to be invoked before using the PowerSync SDK. It can safely be called multiple
@@ -84,6 +143,123 @@ impl PowerSyncEnvironment {
     }
 }
 
+/// Resources shared between many [crate::PowerSyncDatabase]s hosted in the same process, e.g. one
+/// database per tenant on a server.
+///
+/// All environments created with [Self::environment] share a single [HttpClient] (and thus its
+/// connection pool) and [Timer]. Optionally, the host also bounds how many databases can use their
+/// writer connection or hold an open sync stream at the same time, so that resource usage stays
+/// predictable as the amount of hosted databases grows (see [Self::with_limits]). Databases
+/// waiting for a permit don't consume resources besides a registered waker.
+///
+/// To multiplex databases onto a bounded set of workers, spawn the single future returned by
+/// `async_tasks().join()` for each database (see [crate::PowerSyncDatabase::async_tasks]) on a
+/// shared executor.
+#[derive(Clone)]
+pub struct PowerSyncHost {
+    client: Arc<dyn HttpClient>,
+    timer: &'static (dyn Timer + Send + Sync),
+    limits: Arc<HostPermits>,
+    blocking: Option<BlockingPool>,
+    metrics: Option<Arc<dyn MetricsObserver>>,
+}
+
+impl PowerSyncHost {
+    pub fn new<C: HttpClient>(client: C, timer: &'static (dyn Timer + Send + Sync)) -> Self {
+        Self::with_limits(client, timer, &HostLimits::default())
+    }
+
+    /// Creates a host bounding resources of its databases with `limits`.
+    ///
+    /// Limits are shared by all environments created by this host and its clones. They can't be
+    /// changed afterwards, since databases may already be waiting for permits.
+    pub fn with_limits<C: HttpClient>(
+        client: C,
+        timer: &'static (dyn Timer + Send + Sync),
+        limits: &HostLimits,
+    ) -> Self {
+        Self {
+            client: Arc::new(client),
+            timer,
+            limits: Arc::new(HostPermits {
+                writers: limits
+                    .max_concurrent_writers
+                    .map(|writers| WriterPermits::new(writers.max(1))),
+                sync_streams: limits
+                    .max_sync_streams
+                    .map(|streams| Arc::new(Semaphore::new(streams.max(1)))),
+            }),
+            blocking: None,
+            metrics: None,
+        }
+    }
+
+    /// Shares a [BlockingPool] between all databases of this host (see
+    /// [PowerSyncEnvironment::with_blocking_pool]).
+    pub fn with_blocking_pool(mut self, pool: BlockingPool) -> Self {
+        self.blocking = Some(pool);
+        self
+    }
+
+    /// Reports measurements of all databases of this host to a shared `observer` (see
+    /// [PowerSyncEnvironment::with_metrics_observer]).
+    pub fn with_metrics_observer(mut self, observer: Arc<dyn MetricsObserver>) -> Self {
+        self.metrics = Some(observer);
+        self
+    }
+
+    /// Creates a [PowerSyncEnvironment] for a database using the shared resources of this host.
+    pub fn environment(&self, pool: ConnectionPool) -> PowerSyncEnvironment {
+        let env = PowerSyncEnvironment {
+            client: Box::new(self.client.clone()),
+            pool,
+            timer: self.timer,
+            limits: Some(self.limits.clone()),
+            blocking: self.blocking.clone(),
+            metrics: None,
+        };
+
+        match &self.metrics {
+            Some(observer) => env.with_metrics_observer(observer.clone()),
+            None => env,
+        }
+    }
+}
+
+/// Bounds for resources shared by all databases of a [PowerSyncHost], see
+/// [PowerSyncHost::with_limits].
+#[derive(Clone, Copy, Debug, Default)]
+pub struct HostLimits {
+    max_concurrent_writers: Option<usize>,
+    max_sync_streams: Option<usize>,
+}
+
+impl HostLimits {
+    /// Limits the amount of databases that can use their writer connection concurrently.
+    ///
+    /// This includes local writes as well as the sync client applying downloaded data, which
+    /// yields to local writes waiting for a permit. At least one writer is always allowed.
+    pub fn with_max_concurrent_writers(&mut self, writers: usize) -> &mut Self {
+        self.max_concurrent_writers = Some(writers);
+        self
+    }
+
+    /// Limits the amount of sync streams that can be open concurrently.
+    ///
+    /// Databases exceeding the limit wait for another stream to close before connecting. At least
+    /// one stream is always allowed.
+    pub fn with_max_sync_streams(&mut self, streams: usize) -> &mut Self {
+        self.max_sync_streams = Some(streams);
+        self
+    }
+}
+
+/// Semaphores enforcing the [HostLimits] of a [PowerSyncHost].
+pub(crate) struct HostPermits {
+    writers: Option<WriterPermits>,
+    sync_streams: Option<Arc<Semaphore>>,
+}
+
 /// An implementation of a timer as part of an event loop or async runtime hosting the PowerSync
 /// SDK.
 ///
@@ -95,3 +271,39 @@ pub trait Timer {
     /// the context's waker to be woken after the specified `duration`.
     fn delay_once(&self, duration: Duration) -> Pin<Box<dyn Future<Output = ()> + Send>>;
 }
+
+/// Receives measurements of the sync client and the connection pool, e.g. to forward them to
+/// telemetry.
+///
+/// All methods have empty default implementations, so observers only need to implement the
+/// measurements they're interested in. Methods are called on the thread doing the measured work
+/// and should return quickly. Without an observer installed through
+/// [PowerSyncEnvironment::with_metrics_observer], the SDK doesn't take any measurements.
+pub trait MetricsObserver: Send + Sync {
+    /// A sync line of `bytes` (after decompression) has been received from the sync service.
+    fn line_received(&self, _bytes: usize) {}
+
+    /// `powersync_control` has processed a sync line or another event of the sync client.
+    fn line_applied(&self, _duration: Duration) {}
+
+    /// A batch of `lines` sync lines with a total size of `bytes` has been applied and committed
+    /// in a single transaction, taking `duration` after leasing the writer.
+    fn batch_applied(&self, _lines: usize, _bytes: usize, _duration: Duration) {}
+
+    /// A writer has waited `wait` for the writer connection. `background` is set for the sync
+    /// client applying downloaded lines.
+    fn writer_wait(&self, _background: bool, _wait: Duration) {}
+
+    /// A read has waited `wait` for a reader connection to become available.
+    fn reader_wait(&self, _wait: Duration) {}
+
+    /// Listeners have been notified about writes to `tables` tables, taking `duration`.
+    fn update_notifications(&self, _tables: usize, _duration: Duration) {}
+
+    /// A call to [crate::BackendConnector::upload_data] has completed after `duration`.
+    fn upload_completed(&self, _succeeded: bool, _duration: Duration) {}
+
+    /// The sync client reconnects after a sync iteration has ended, with `failures` being the
+    /// amount of consecutive iterations that failed to connect.
+    fn reconnecting(&self, _failures: u32) {}
+}
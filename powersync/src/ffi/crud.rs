@@ -0,0 +1,152 @@
+use std::ffi::c_char;
+use std::ptr::null_mut;
+
+use futures_lite::future;
+
+use crate::error::PowerSyncError;
+use crate::ffi::complete;
+use crate::ffi::rows::{PowerSyncRows, RowValue};
+use crate::{CrudBatch, PowerSyncDatabase, UpdateType};
+
+/// Local writes to upload to the backend, see [CrudBatch].
+pub struct PowerSyncCrudBatch {
+    db: PowerSyncDatabase,
+    last_item_id: i64,
+    has_more: bool,
+    /// One row per [crate::CrudEntry], with the columns listed in [Self::COLUMNS].
+    entries: PowerSyncRows,
+}
+
+impl PowerSyncCrudBatch {
+    const COLUMNS: [&str; 8] = [
+        "client_id",
+        "transaction_id",
+        "op",
+        "type",
+        "id",
+        "metadata",
+        "data",
+        "previous_values",
+    ];
+
+    fn new(db: &PowerSyncDatabase, batch: CrudBatch) -> Self {
+        let mut entries = PowerSyncRows::with_columns(Self::COLUMNS);
+        for entry in &batch.crud {
+            let op = match entry.update_type {
+                UpdateType::Put => "PUT",
+                UpdateType::Patch => "PATCH",
+                UpdateType::Delete => "DELETE",
+            };
+
+            entries.push_row([
+                Some(RowValue::Integer(entry.client_id)),
+                Some(RowValue::Integer(entry.transaction_id)),
+                Some(RowValue::Text(op)),
+                Some(RowValue::Text(&entry.table)),
+                Some(RowValue::Text(&entry.id)),
+                entry.metadata.as_deref().map(RowValue::Text),
+                entry.data.as_ref().map(|data| RowValue::Text(data.get())),
+                entry
+                    .previous_values
+                    .as_ref()
+                    .map(|values| RowValue::Text(values.get())),
+            ]);
+        }
+
+        Self {
+            db: db.clone(),
+            last_item_id: batch.last_item_id,
+            has_more: batch.has_more,
+            entries,
+        }
+    }
+}
+
+/// Reads the oldest local writes that haven't been uploaded, see
+/// [PowerSyncDatabase::next_crud_batch].
+///
+/// Entries are returned as rows with the columns `client_id`, `transaction_id`, `op`, `type`
+/// (the table name), `id`, `metadata`, `data` and `previous_values`, where `data` and
+/// `previous_values` are JSON objects. If there are no pending writes, null is written to
+/// `out_batch`.
+///
+/// ## Safety
+///
+/// `db` must be a valid database. `out_batch` must be valid for writes, `out_error` must be null
+/// or valid for writes.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn powersync_crud_batch_next(
+    db: *const PowerSyncDatabase,
+    limit_entries: usize,
+    limit_bytes: usize,
+    out_batch: *mut *mut PowerSyncCrudBatch,
+    out_error: *mut *mut c_char,
+) -> bool {
+    let db = unsafe { &*db };
+    let result = future::block_on(db.next_crud_batch(limit_entries, limit_bytes))
+        .map(|batch| batch.map(|batch| PowerSyncCrudBatch::new(db, batch)));
+
+    unsafe {
+        complete(result, out_batch, out_error, |batch| match batch {
+            Some(batch) => Box::into_raw(Box::new(batch)),
+            None => null_mut(),
+        })
+    }
+}
+
+/// The entries of `batch`, valid until the batch is freed.
+///
+/// ## Safety
+///
+/// `batch` must be a valid batch returned by [powersync_crud_batch_next].
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn powersync_crud_batch_entries(
+    batch: *const PowerSyncCrudBatch,
+) -> *const PowerSyncRows {
+    &unsafe { &*batch }.entries
+}
+
+/// Whether further transactions were left out of `batch` due to its limits.
+///
+/// ## Safety
+///
+/// See [powersync_crud_batch_entries].
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn powersync_crud_batch_has_more(batch: *const PowerSyncCrudBatch) -> bool {
+    unsafe { &*batch }.has_more
+}
+
+/// Removes the entries of `batch` from the local upload queue once they have been uploaded,
+/// optionally applying a custom `write_checkpoint` if it's not null.
+///
+/// ## Safety
+///
+/// See [powersync_crud_batch_entries]. `write_checkpoint` must be null or valid for reads, and
+/// `out_error` must be null or valid for writes.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn powersync_crud_batch_complete(
+    batch: *const PowerSyncCrudBatch,
+    write_checkpoint: *const i64,
+    out_error: *mut *mut c_char,
+) -> bool {
+    let batch = unsafe { &*batch };
+    let write_checkpoint = unsafe { write_checkpoint.as_ref() }.copied();
+    let result: Result<(), PowerSyncError> = future::block_on(
+        batch
+            .db
+            .inner
+            .complete_crud_items(batch.last_item_id, write_checkpoint),
+    );
+
+    unsafe { complete(result, null_mut(), out_error, |()| ()) }
+}
+
+/// Frees a batch returned by [powersync_crud_batch_next].
+///
+/// ## Safety
+///
+/// `batch` must be a valid batch and must not be used afterwards.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn powersync_crud_batch_free(batch: *mut PowerSyncCrudBatch) {
+    drop(unsafe { Box::from_raw(batch) });
+}
@@ -0,0 +1,173 @@
+//! A C API for embedding the SDK into native applications, see `include/powersync.h`.
+//!
+//! Databases are opened on the Rust side, which also configures the [crate::env::PowerSyncEnvironment]
+//! and runs the [crate::db::async_support::AsyncDatabaseTasks]. The opened database is then handed
+//! to C with [database_into_raw].
+//!
+//! Results of queries are returned as [PowerSyncRows], which store all values of a result set in
+//! two buffers that can be read without further calls into the SDK. Watched queries are polled by
+//! the host with [watch::powersync_watch_poll], and invoke a callback when they should be polled
+//! again, so that they can be integrated into the event loop of the host.
+//!
+//! Apart from polling watched queries, functions of this API block the calling thread until they
+//! complete.
+
+use std::ffi::{CStr, CString, c_char};
+use std::ptr::null_mut;
+
+use futures_lite::future;
+
+use crate::PowerSyncDatabase;
+use crate::db::connection::exec_stmt;
+use crate::error::PowerSyncError;
+
+pub mod crud;
+pub mod rows;
+pub mod watch;
+
+pub use rows::{PowerSyncCell, PowerSyncCellKind, PowerSyncParameters, PowerSyncRows};
+
+use rows::OwnedParameters;
+
+/// Moves a database to the heap, returning a pointer that can be passed to functions of the C
+/// API.
+///
+/// The pointer must be freed with [powersync_database_free].
+pub fn database_into_raw(db: PowerSyncDatabase) -> *mut PowerSyncDatabase {
+    Box::into_raw(Box::new(db))
+}
+
+/// Closes a database returned by [database_into_raw].
+///
+/// ## Safety
+///
+/// `db` must have been returned by [database_into_raw] and must not be used afterwards.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn powersync_database_free(db: *mut PowerSyncDatabase) {
+    drop(unsafe { Box::from_raw(db) });
+}
+
+/// Frees an error message reported by another function.
+///
+/// ## Safety
+///
+/// `string` must be null or have been returned by this API.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn powersync_string_free(string: *mut c_char) {
+    if !string.is_null() {
+        drop(unsafe { CString::from_raw(string) });
+    }
+}
+
+/// Runs a `SELECT` statement on a reader connection and returns all rows.
+///
+/// On success, the result is written to `out_rows` and must be freed with
+/// [rows::powersync_rows_free]. Otherwise, an error message is written to `out_error`.
+///
+/// ## Safety
+///
+/// `db` must be a valid database, `sql` a null-terminated string and `params` null or valid
+/// parameters. `out_rows` must be valid for writes, `out_error` must be null or valid for writes.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn powersync_query(
+    db: *const PowerSyncDatabase,
+    sql: *const c_char,
+    params: *const PowerSyncParameters,
+    out_rows: *mut *mut PowerSyncRows,
+    out_error: *mut *mut c_char,
+) -> bool {
+    let result = (|| -> Result<PowerSyncRows, PowerSyncError> {
+        let db = unsafe { &*db };
+        let sql = unsafe { sql_from_c(sql) }?;
+        let params = unsafe { OwnedParameters::copy_from(params) }?;
+
+        let reader = future::block_on(db.reader())?;
+        let stmt = reader.sqlite_connection().prepare_cached(sql)?;
+        params.bind_to(&stmt)?;
+        PowerSyncRows::read(&stmt)
+    })();
+
+    unsafe {
+        complete(result, out_rows, out_error, |rows| {
+            Box::into_raw(Box::new(rows))
+        })
+    }
+}
+
+/// Runs a statement on the writer connection, e.g. to insert or update rows.
+///
+/// Rows returned by the statement are ignored.
+///
+/// ## Safety
+///
+/// See [powersync_query].
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn powersync_execute(
+    db: *const PowerSyncDatabase,
+    sql: *const c_char,
+    params: *const PowerSyncParameters,
+    out_error: *mut *mut c_char,
+) -> bool {
+    let result = (|| -> Result<(), PowerSyncError> {
+        let db = unsafe { &*db };
+        let sql = unsafe { sql_from_c(sql) }?;
+        let params = unsafe { OwnedParameters::copy_from(params) }?;
+
+        let writer = future::block_on(db.writer())?;
+        let stmt = writer.sqlite_connection().prepare_cached(sql)?;
+        params.bind_to(&stmt)?;
+        exec_stmt(&stmt)
+    })();
+
+    unsafe { complete(result, null_mut(), out_error, |()| ()) }
+}
+
+unsafe fn sql_from_c<'a>(sql: *const c_char) -> Result<&'a str, PowerSyncError> {
+    unsafe { CStr::from_ptr(sql) }
+        .to_str()
+        .map_err(|_| PowerSyncError::argument_error("SQL is not valid UTF-8"))
+}
+
+/// Writes the value of a successful `result` to `out`, or its error to `out_error`.
+///
+/// Returns whether `result` was successful.
+///
+/// ## Safety
+///
+/// `out` must be null or valid for writes, as must `out_error`.
+unsafe fn complete<T, R>(
+    result: Result<T, PowerSyncError>,
+    out: *mut R,
+    out_error: *mut *mut c_char,
+    convert: impl FnOnce(T) -> R,
+) -> bool {
+    match result {
+        Ok(value) => {
+            // Only convert values that are returned, since converting may move them to the heap.
+            if !out.is_null() {
+                unsafe { out.write(convert(value)) };
+            }
+            true
+        }
+        Err(error) => {
+            unsafe { report_error(out_error, &error) };
+            false
+        }
+    }
+}
+
+/// Writes the message of `error` to `out_error`, if it's not null.
+///
+/// ## Safety
+///
+/// `out_error` must be null or valid for writes.
+unsafe fn report_error(out_error: *mut *mut c_char, error: &PowerSyncError) {
+    if out_error.is_null() {
+        return;
+    }
+
+    let mut message = error.to_string().into_bytes();
+    message.retain(|byte| *byte != 0);
+    let message = CString::new(message).expect("should not contain null bytes");
+    unsafe { out_error.write(message.into_raw()) };
+}
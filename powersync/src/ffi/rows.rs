@@ -0,0 +1,390 @@
+use std::slice;
+
+use powersync_sqlite_nostd::{ColumnType, Destructor, ManagedStmt, ResultCode};
+
+use crate::error::PowerSyncError;
+
+/// The type of a [PowerSyncCell].
+///
+/// This is a number instead of an enum since parameter cells are written by C callers, which
+/// could use values not known to the SDK.
+#[repr(transparent)]
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct PowerSyncCellKind(pub u32);
+
+impl PowerSyncCellKind {
+    pub const NULL: Self = Self(0);
+    pub const INTEGER: Self = Self(1);
+    pub const REAL: Self = Self(2);
+    /// UTF-8 text at [PowerSyncCellValue::offset] in the data buffer of the rows. The text is
+    /// followed by a null byte that isn't included in [PowerSyncCell::length].
+    pub const TEXT: Self = Self(3);
+    /// Bytes at [PowerSyncCellValue::offset] in the data buffer of the rows.
+    pub const BLOB: Self = Self(4);
+}
+
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub union PowerSyncCellValue {
+    pub integer: i64,
+    pub real: f64,
+    pub offset: usize,
+}
+
+/// A single value, either read from a result set or bound as a parameter.
+///
+/// Cells store text and blobs as ranges of a data buffer shared by all cells of a result set, so
+/// reading them doesn't require an allocation per value.
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct PowerSyncCell {
+    pub kind: PowerSyncCellKind,
+    /// For text and blob cells, the length of the value in bytes.
+    pub length: usize,
+    pub value: PowerSyncCellValue,
+}
+
+impl PowerSyncCell {
+    const NULL: Self = Self {
+        kind: PowerSyncCellKind::NULL,
+        length: 0,
+        value: PowerSyncCellValue { integer: 0 },
+    };
+
+    fn integer(integer: i64) -> Self {
+        Self {
+            kind: PowerSyncCellKind::INTEGER,
+            length: 0,
+            value: PowerSyncCellValue { integer },
+        }
+    }
+
+    fn real(real: f64) -> Self {
+        Self {
+            kind: PowerSyncCellKind::REAL,
+            length: 0,
+            value: PowerSyncCellValue { real },
+        }
+    }
+
+    /// The range of the data buffer referenced by text and blob cells.
+    fn bytes<'a>(&self, data: &'a [u8]) -> Result<&'a [u8], PowerSyncError> {
+        let offset = unsafe {
+            // Safety: Only called for text and blob cells, which store an offset.
+            self.value.offset
+        };
+
+        offset
+            .checked_add(self.length)
+            .and_then(|end| data.get(offset..end))
+            .ok_or_else(|| PowerSyncError::argument_error("Cell out of bounds of data buffer"))
+    }
+}
+
+/// A result set packed into a single allocation of cells and a data buffer for text and blobs.
+///
+/// Cells are stored row by row, so the value of column `c` in row `r` is at
+/// `cells[r * column_count + c]`.
+pub struct PowerSyncRows {
+    column_names: Vec<PowerSyncCell>,
+    cells: Vec<PowerSyncCell>,
+    data: Vec<u8>,
+}
+
+impl PowerSyncRows {
+    pub(crate) fn with_columns<'a>(names: impl IntoIterator<Item = &'a str>) -> Self {
+        let mut rows = Self {
+            column_names: Vec::new(),
+            cells: Vec::new(),
+            data: Vec::new(),
+        };
+
+        for name in names {
+            let cell = rows.push_text(name);
+            rows.column_names.push(cell);
+        }
+        rows
+    }
+
+    /// Steps through `stmt` and packs all rows it returns.
+    pub(crate) fn read(stmt: &ManagedStmt) -> Result<Self, PowerSyncError> {
+        let column_count = stmt.column_count();
+        let names = (0..column_count)
+            .map(|i| stmt.column_name(i))
+            .collect::<Result<Vec<_>, _>>()?;
+        let mut rows = Self::with_columns(names);
+
+        while stmt.step()? == ResultCode::ROW {
+            for i in 0..column_count {
+                let cell = match stmt.column_type(i)? {
+                    ColumnType::Integer => PowerSyncCell::integer(stmt.column_int64(i)),
+                    ColumnType::Float => PowerSyncCell::real(stmt.column_double(i)),
+                    ColumnType::Text => rows.push_text(stmt.column_text(i)?),
+                    ColumnType::Blob => rows.push_blob(stmt.column_blob(i)?),
+                    ColumnType::Null => PowerSyncCell::NULL,
+                };
+                rows.cells.push(cell);
+            }
+        }
+
+        Ok(rows)
+    }
+
+    /// Adds a row of values, which must have one value for each column.
+    pub(crate) fn push_row<const N: usize>(&mut self, values: [Option<RowValue>; N]) {
+        debug_assert_eq!(N, self.column_count());
+
+        for value in values {
+            let cell = match value {
+                None => PowerSyncCell::NULL,
+                Some(RowValue::Integer(value)) => PowerSyncCell::integer(value),
+                Some(RowValue::Text(value)) => self.push_text(value),
+            };
+            self.cells.push(cell);
+        }
+    }
+
+    fn push_text(&mut self, text: &str) -> PowerSyncCell {
+        let mut cell = self.push_blob(text.as_bytes());
+        cell.kind = PowerSyncCellKind::TEXT;
+        self.data.push(0);
+        cell
+    }
+
+    fn push_blob(&mut self, blob: &[u8]) -> PowerSyncCell {
+        let offset = self.data.len();
+        self.data.extend_from_slice(blob);
+
+        PowerSyncCell {
+            kind: PowerSyncCellKind::BLOB,
+            length: blob.len(),
+            value: PowerSyncCellValue { offset },
+        }
+    }
+
+    pub fn column_count(&self) -> usize {
+        self.column_names.len()
+    }
+
+    pub fn row_count(&self) -> usize {
+        self.cells
+            .len()
+            .checked_div(self.column_count())
+            .unwrap_or_default()
+    }
+
+    /// Text cells with the name of each column.
+    pub fn column_names(&self) -> &[PowerSyncCell] {
+        &self.column_names
+    }
+
+    pub fn cells(&self) -> &[PowerSyncCell] {
+        &self.cells
+    }
+
+    /// The buffer referenced by text and blob cells.
+    pub fn data(&self) -> &[u8] {
+        &self.data
+    }
+}
+
+/// A value added to [PowerSyncRows] built by the SDK instead of being read from a statement.
+pub(crate) enum RowValue<'a> {
+    Integer(i64),
+    Text(&'a str),
+}
+
+/// Parameters for a statement in the layout of [PowerSyncRows], passed from C.
+#[repr(C)]
+pub struct PowerSyncParameters {
+    pub cells: *const PowerSyncCell,
+    pub count: usize,
+    /// The buffer referenced by text and blob cells.
+    pub data: *const u8,
+    pub data_length: usize,
+}
+
+/// An owned copy of [PowerSyncParameters], which can be bound to statements again when watched
+/// queries re-run.
+#[derive(Default)]
+pub(crate) struct OwnedParameters {
+    cells: Vec<PowerSyncCell>,
+    data: Vec<u8>,
+}
+
+impl OwnedParameters {
+    /// Copies parameters from C, validating that text cells are valid UTF-8 and that all cells
+    /// are in bounds.
+    ///
+    /// ## Safety
+    ///
+    /// `parameters` must be null or point to valid parameters, whose `cells` and `data` point to
+    /// `count` cells and `data_length` bytes respectively.
+    pub unsafe fn copy_from(
+        parameters: *const PowerSyncParameters,
+    ) -> Result<Self, PowerSyncError> {
+        let Some(parameters) = (unsafe { parameters.as_ref() }) else {
+            return Ok(Self::default());
+        };
+
+        let copy = unsafe {
+            Self {
+                cells: raw_slice(parameters.cells, parameters.count).to_vec(),
+                data: raw_slice(parameters.data, parameters.data_length).to_vec(),
+            }
+        };
+
+        for cell in &copy.cells {
+            match cell.kind {
+                PowerSyncCellKind::NULL | PowerSyncCellKind::INTEGER | PowerSyncCellKind::REAL => {}
+                PowerSyncCellKind::TEXT => {
+                    std::str::from_utf8(cell.bytes(&copy.data)?).map_err(|_| {
+                        PowerSyncError::argument_error("Text parameter is not valid UTF-8")
+                    })?;
+                }
+                PowerSyncCellKind::BLOB => {
+                    cell.bytes(&copy.data)?;
+                }
+                _ => return Err(PowerSyncError::argument_error("Unknown parameter kind")),
+            }
+        }
+
+        Ok(copy)
+    }
+
+    pub fn bind_to(&self, stmt: &ManagedStmt) -> Result<(), PowerSyncError> {
+        for (index, cell) in self.cells.iter().enumerate() {
+            let index = index as i32 + 1;
+
+            // Destructor::STATIC is fine because the statement is reset before these parameters
+            // are dropped.
+            match cell.kind {
+                PowerSyncCellKind::NULL => stmt.bind_null(index),
+                PowerSyncCellKind::INTEGER => stmt.bind_int64(index, unsafe { cell.value.integer }),
+                PowerSyncCellKind::REAL => stmt.bind_double(index, unsafe { cell.value.real }),
+                PowerSyncCellKind::TEXT => {
+                    let text = std::str::from_utf8(cell.bytes(&self.data)?)
+                        .expect("validated in copy_from");
+                    stmt.bind_text(index, text, Destructor::STATIC)
+                }
+                PowerSyncCellKind::BLOB => {
+                    stmt.bind_blob(index, cell.bytes(&self.data)?, Destructor::STATIC)
+                }
+                _ => unreachable!("validated in copy_from"),
+            }?;
+        }
+
+        Ok(())
+    }
+}
+
+/// Like [slice::from_raw_parts], but allowing null pointers for empty slices.
+unsafe fn raw_slice<'a, T>(ptr: *const T, len: usize) -> &'a [T] {
+    if len == 0 {
+        &[]
+    } else {
+        unsafe { slice::from_raw_parts(ptr, len) }
+    }
+}
+
+/// The amount of columns in `rows`.
+///
+/// ## Safety
+///
+/// `rows` must be valid rows returned by this API.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn powersync_rows_column_count(rows: *const PowerSyncRows) -> usize {
+    unsafe { &*rows }.column_count()
+}
+
+/// The amount of rows in `rows`.
+///
+/// ## Safety
+///
+/// See [powersync_rows_column_count].
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn powersync_rows_row_count(rows: *const PowerSyncRows) -> usize {
+    unsafe { &*rows }.row_count()
+}
+
+/// Text cells with the name of each column, see [PowerSyncRows::column_names].
+///
+/// ## Safety
+///
+/// See [powersync_rows_column_count]. The returned pointer is valid until the rows are freed.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn powersync_rows_column_names(
+    rows: *const PowerSyncRows,
+) -> *const PowerSyncCell {
+    unsafe { &*rows }.column_names().as_ptr()
+}
+
+/// All cells of `rows`, stored row by row.
+///
+/// ## Safety
+///
+/// See [powersync_rows_column_names].
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn powersync_rows_cells(rows: *const PowerSyncRows) -> *const PowerSyncCell {
+    unsafe { &*rows }.cells().as_ptr()
+}
+
+/// The buffer that text and blob cells of `rows` point into.
+///
+/// ## Safety
+///
+/// See [powersync_rows_column_names].
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn powersync_rows_data(rows: *const PowerSyncRows) -> *const u8 {
+    unsafe { &*rows }.data().as_ptr()
+}
+
+/// Frees rows returned by this API.
+///
+/// ## Safety
+///
+/// `rows` must be valid rows returned by this API and must not be used afterwards.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn powersync_rows_free(rows: *mut PowerSyncRows) {
+    drop(unsafe { Box::from_raw(rows) });
+}
+
+#[cfg(all(test, feature = "rusqlite"))]
+mod test {
+    use rusqlite::Connection;
+
+    use super::{PowerSyncCellKind, PowerSyncRows};
+    use crate::db::connection::SqliteConnection;
+
+    #[test]
+    fn packs_result_set() {
+        let conn: SqliteConnection = Connection::open_in_memory().unwrap().into();
+        let stmt = conn
+            .prepare(
+                "SELECT 1 AS a, 2.5 AS b, 'text' AS c, x'0102' AS d, NULL AS e \
+                 UNION ALL SELECT 2, 3.5, '', x'', 1",
+            )
+            .unwrap();
+        let rows = PowerSyncRows::read(&stmt).unwrap();
+
+        assert_eq!(rows.column_count(), 5);
+        assert_eq!(rows.row_count(), 2);
+        let name = rows.column_names()[2];
+        assert_eq!(name.kind, PowerSyncCellKind::TEXT);
+        assert_eq!(name.bytes(rows.data()).unwrap(), b"c");
+
+        let cells = rows.cells();
+        assert_eq!(unsafe { cells[0].value.integer }, 1);
+        assert_eq!(unsafe { cells[1].value.real }, 2.5);
+        assert_eq!(cells[2].bytes(rows.data()).unwrap(), b"text");
+        assert_eq!(cells[3].kind, PowerSyncCellKind::BLOB);
+        assert_eq!(cells[3].bytes(rows.data()).unwrap(), [1, 2]);
+        assert_eq!(cells[4].kind, PowerSyncCellKind::NULL);
+
+        // Text values are null-terminated for C callers.
+        let text_end = unsafe { cells[2].value.offset } + cells[2].length;
+        assert_eq!(rows.data()[text_end], 0);
+        assert_eq!(cells[7].length, 0);
+        assert_eq!(cells[9].kind, PowerSyncCellKind::INTEGER);
+    }
+}
@@ -0,0 +1,287 @@
+use std::collections::HashSet;
+use std::ffi::{c_char, c_void};
+use std::pin::Pin;
+use std::sync::{Arc, Mutex};
+use std::task::{Context, Poll, Wake, Waker};
+use std::time::Duration;
+
+use futures_lite::{Stream, StreamExt, future, ready};
+use powersync_sqlite_nostd::ResultCode;
+
+use crate::db::connection::SqliteConnection;
+use crate::error::PowerSyncError;
+use crate::ffi::rows::{OwnedParameters, PowerSyncParameters, PowerSyncRows};
+use crate::ffi::{complete, report_error, sql_from_c};
+use crate::{PowerSyncDatabase, WatchOptions};
+
+/// A function invoked by a [PowerSyncWatch] when it should be polled again.
+///
+/// This may be called from any thread, e.g. the one committing a write. The callback should
+/// quickly schedule a call to [powersync_watch_poll] on the host's event loop, for instance by
+/// writing to an `eventfd`. It must not poll or free the watch itself.
+pub type PowerSyncWakeCallback = unsafe extern "C" fn(context: *mut c_void);
+
+/// Limits how often a watched query re-runs, see [WatchOptions]. Durations of zero are unset.
+#[repr(C)]
+pub struct PowerSyncWatchOptions {
+    pub min_interval_ms: u64,
+    pub debounce_ms: u64,
+    pub max_latency_ms: u64,
+}
+
+impl From<&PowerSyncWatchOptions> for WatchOptions {
+    fn from(value: &PowerSyncWatchOptions) -> Self {
+        let mut options = WatchOptions::default();
+        if value.min_interval_ms > 0 {
+            options.with_min_interval(Duration::from_millis(value.min_interval_ms));
+        }
+        if value.debounce_ms > 0 {
+            options.with_debounce(Duration::from_millis(value.debounce_ms));
+        }
+        if value.max_latency_ms > 0 {
+            options.with_max_latency(Duration::from_millis(value.max_latency_ms));
+        }
+        options
+    }
+}
+
+/// The outcome of [powersync_watch_poll].
+#[repr(C)]
+#[derive(Debug, PartialEq, Eq)]
+pub enum PowerSyncPoll {
+    /// No new results are available, the wake callback is invoked once that changes.
+    Pending = 0,
+    /// New results have been written to `out_rows`.
+    Ready = 1,
+    /// Running the query failed, with the error written to `out_error`. The watch can be polled
+    /// again to wait for the next change.
+    Error = 2,
+    /// The watch won't emit further results because the database has been closed. Further polls
+    /// keep returning this.
+    Closed = 3,
+}
+
+/// A query that is re-run whenever tables it reads from change, created with
+/// [powersync_watch_statement].
+pub struct PowerSyncWatch {
+    query: Arc<WatchedQuery>,
+    notifications: Pin<Box<dyn Stream<Item = ()> + Send>>,
+    running: Option<Pin<Box<dyn Future<Output = Result<PowerSyncRows, PowerSyncError>> + Send>>>,
+    /// Whether `notifications` has ended, which must not be polled afterwards.
+    closed: bool,
+    callback: Arc<CallbackWaker>,
+    waker: Waker,
+}
+
+struct WatchedQuery {
+    db: PowerSyncDatabase,
+    sql: String,
+    params: OwnedParameters,
+}
+
+impl PowerSyncWatch {
+    fn new(
+        db: PowerSyncDatabase,
+        sql: String,
+        params: OwnedParameters,
+        options: &WatchOptions,
+        callback: Arc<CallbackWaker>,
+    ) -> Result<Self, PowerSyncError> {
+        let tables = {
+            let reader = future::block_on(db.reader())?;
+            find_tables(reader.sqlite_connection(), &sql, &params)?
+        };
+        let notifications = db.watch_tables_with(true, tables, options).boxed();
+
+        Ok(Self {
+            query: Arc::new(WatchedQuery { db, sql, params }),
+            notifications,
+            running: None,
+            closed: false,
+            waker: Waker::from(callback.clone()),
+            callback,
+        })
+    }
+
+    /// Polls for the next results, returning [None] once no further results will be emitted.
+    fn poll(&mut self) -> Poll<Option<Result<PowerSyncRows, PowerSyncError>>> {
+        let waker = self.waker.clone();
+        let mut cx = Context::from_waker(&waker);
+
+        loop {
+            if let Some(running) = &mut self.running {
+                let result = ready!(running.as_mut().poll(&mut cx));
+                self.running = None;
+                return Poll::Ready(Some(result));
+            }
+
+            if self.closed {
+                return Poll::Ready(None);
+            }
+
+            match ready!(self.notifications.as_mut().poll_next(&mut cx)) {
+                Some(()) => self.running = Some(Box::pin(self.query.clone().run())),
+                None => self.closed = true,
+            }
+        }
+    }
+}
+
+impl WatchedQuery {
+    async fn run(self: Arc<Self>) -> Result<PowerSyncRows, PowerSyncError> {
+        // Other watchers notified about the same write can share this snapshot.
+        let snapshot = self.db.inner.shared_snapshot().await?;
+        let reader = snapshot.lock().await;
+        let stmt = reader.sqlite_connection().prepare_cached(&self.sql)?;
+        self.params.bind_to(&stmt)?;
+
+        PowerSyncRows::read(&stmt)
+    }
+}
+
+/// Finds tables read by `sql`, like [PowerSyncDatabase::watch_statement] does for rusqlite
+/// statements.
+fn find_tables(
+    conn: &SqliteConnection,
+    sql: &str,
+    params: &OwnedParameters,
+) -> Result<HashSet<String>, PowerSyncError> {
+    let explain = conn.prepare(&format!("EXPLAIN {sql}"))?;
+    params.bind_to(&explain)?;
+    let find_table = conn.prepare("SELECT tbl_name FROM sqlite_schema WHERE rootpage = ?")?;
+
+    let mut tables = HashSet::new();
+    while explain.step()? == ResultCode::ROW {
+        // Columns of EXPLAIN are addr, opcode, p1, p2, p3, p4, p5 and comment.
+        if explain.column_text(1)? == "OpenRead" && explain.column_int64(4) == 0 {
+            find_table.bind_int64(1, explain.column_int64(3))?;
+            if find_table.step()? == ResultCode::ROW {
+                let table = find_table.column_text(0)?;
+                tables.insert(PowerSyncDatabase::watched_table_name(table).to_string());
+            }
+            find_table.reset()?;
+        }
+    }
+
+    Ok(tables)
+}
+
+impl Drop for PowerSyncWatch {
+    fn drop(&mut self) {
+        // Wakers can outlive the watch, e.g. when a write notifies it concurrently.
+        *self.callback.target.lock().unwrap() = None;
+    }
+}
+
+/// Invokes a [PowerSyncWakeCallback] when a [PowerSyncWatch] is woken.
+struct CallbackWaker {
+    /// The callback, or [None] after the watch has been freed.
+    target: Mutex<Option<WakeTarget>>,
+}
+
+struct WakeTarget {
+    callback: PowerSyncWakeCallback,
+    context: *mut c_void,
+}
+
+// Safety: Callers of powersync_watch_statement guarantee that the callback can be invoked from
+// any thread.
+unsafe impl Send for WakeTarget {}
+
+impl Wake for CallbackWaker {
+    fn wake(self: Arc<Self>) {
+        self.wake_by_ref();
+    }
+
+    fn wake_by_ref(self: &Arc<Self>) {
+        // Holding the lock while invoking the callback ensures it's not called after
+        // powersync_watch_free returns.
+        if let Some(target) = &*self.target.lock().unwrap() {
+            unsafe { (target.callback)(target.context) };
+        }
+    }
+}
+
+/// Starts watching a `SELECT` statement.
+///
+/// The watch is created without running the query. Call [powersync_watch_poll] to obtain the
+/// initial results, and again whenever `callback` is invoked with `context`. `options` may be
+/// null to re-run the query after every write to a table it reads from.
+///
+/// ## Safety
+///
+/// `db` must be a valid database, `sql` a null-terminated string and `params` and `options` null
+/// or valid. `callback` must be safe to call with `context` from any thread until the watch has
+/// been freed with [powersync_watch_free]. `out_watch` must be valid for writes, `out_error` must
+/// be null or valid for writes.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn powersync_watch_statement(
+    db: *const PowerSyncDatabase,
+    sql: *const c_char,
+    params: *const PowerSyncParameters,
+    options: *const PowerSyncWatchOptions,
+    callback: PowerSyncWakeCallback,
+    context: *mut c_void,
+    out_watch: *mut *mut PowerSyncWatch,
+    out_error: *mut *mut c_char,
+) -> bool {
+    let result = (|| -> Result<PowerSyncWatch, PowerSyncError> {
+        let db = unsafe { &*db }.clone();
+        let sql = unsafe { sql_from_c(sql) }?.to_string();
+        let params = unsafe { OwnedParameters::copy_from(params) }?;
+        let options = unsafe { options.as_ref() }.map(WatchOptions::from);
+        let callback = Arc::new(CallbackWaker {
+            target: Mutex::new(Some(WakeTarget { callback, context })),
+        });
+
+        PowerSyncWatch::new(db, sql, params, &options.unwrap_or_default(), callback)
+    })();
+
+    unsafe {
+        complete(result, out_watch, out_error, |watch| {
+            Box::into_raw(Box::new(watch))
+        })
+    }
+}
+
+/// Polls a watch for new results without blocking.
+///
+/// When new results are available, they're written to `out_rows` and must be freed with
+/// [crate::ffi::rows::powersync_rows_free].
+///
+/// ## Safety
+///
+/// `watch` must be a valid watch that is not polled concurrently. `out_rows` must be valid for
+/// writes, `out_error` must be null or valid for writes.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn powersync_watch_poll(
+    watch: *mut PowerSyncWatch,
+    out_rows: *mut *mut PowerSyncRows,
+    out_error: *mut *mut c_char,
+) -> PowerSyncPoll {
+    let watch = unsafe { &mut *watch };
+
+    match watch.poll() {
+        Poll::Pending => PowerSyncPoll::Pending,
+        Poll::Ready(None) => PowerSyncPoll::Closed,
+        Poll::Ready(Some(Ok(rows))) => {
+            unsafe { out_rows.write(Box::into_raw(Box::new(rows))) };
+            PowerSyncPoll::Ready
+        }
+        Poll::Ready(Some(Err(error))) => {
+            unsafe { report_error(out_error, &error) };
+            PowerSyncPoll::Error
+        }
+    }
+}
+
+/// Stops a watch. Its callback is not invoked after this returns.
+///
+/// ## Safety
+///
+/// `watch` must have been returned by [powersync_watch_statement] and must not be used
+/// afterwards.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn powersync_watch_free(watch: *mut PowerSyncWatch) {
+    drop(unsafe { Box::from_raw(watch) });
+}
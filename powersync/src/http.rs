@@ -28,9 +28,11 @@ pub struct Request {
     pub method: &'static str,
     pub url: Url,
     pub headers: Vec<(&'static str, Cow<'static, str>)>,
-    /// This crate doesn't use streaming request bodies, so requests will contain the full request
-    /// body as a byte vector.
-    pub body: Option<Vec<u8>>,
+    /// The full request body.
+    ///
+    /// Bodies are reference-counted [Bytes], so clients can pass them to the underlying HTTP
+    /// implementation (or retain them for retries) without copying.
+    pub body: Option<Bytes>,
 }
 
 /// Information about http responses used by the PowerSync SDK.
@@ -38,6 +40,12 @@ pub struct Response {
     /// The HTTP status code of the response.
     pub status: u16,
     pub content_type: Option<String>,
+    /// The `Content-Encoding` header of the response.
+    ///
+    /// Sync requests advertise the encodings enabled through the `gzip` and `zstd` features of
+    /// this crate, and the SDK decompresses the body itself. Clients should not decompress
+    /// responses transparently, or they must report [None] here if they do.
+    pub content_encoding: Option<String>,
     /// The streamed response body.
     pub body: ResponseBody,
 }
@@ -101,6 +109,11 @@ impl HttpClient for ReqwestClient {
             .get("content-type")
             .and_then(|v| v.to_str().ok())
             .map(|v| v.to_string());
+        let content_encoding = response
+            .headers()
+            .get("content-encoding")
+            .and_then(|v| v.to_str().ok())
+            .map(|v| v.to_string());
         let content_length = response.content_length();
         let stream = response
             .bytes_stream()
@@ -114,13 +127,14 @@ impl HttpClient for ReqwestClient {
         Ok(Response {
             status,
             content_type,
+            content_encoding,
             body,
         })
     }
 }
 
 #[async_trait]
-impl<C: HttpClient> HttpClient for Arc<C> {
+impl<C: HttpClient + ?Sized> HttpClient for Arc<C> {
     async fn send(&self, req: Request) -> Result<Response, PowerSyncError> {
         let inner = Arc::as_ref(self);
         inner.send(req).await
@@ -4,20 +4,37 @@ mod sync;
 mod util;
 
 pub use db::PowerSyncDatabase;
-pub use db::crud::{CrudEntry, CrudTransaction, UpdateType};
+pub use db::crud::{CrudBatch, CrudEntry, CrudTransaction, UpdateType};
+#[cfg(feature = "rusqlite")]
+pub use db::diff::QueryDiff;
 #[cfg(feature = "ffi")]
 pub use db::internal::InnerPowerSyncState;
-pub use db::pool::{ConnectionPool, LeasedConnection};
+pub use db::pool::{ConnectionPool, LeasedConnection, PoolOptions, TempStore};
+pub use db::snapshot::ReadSnapshot;
 pub use db::streams::StreamSubscription;
 pub use db::streams::StreamSubscriptionOptions;
 pub use db::streams::SyncStream;
+pub use db::update_hook::{RowUpdate, RowUpdateKind};
+pub use db::writer_lock::{LockWaitStats, WriterLockStats};
 pub use sync::connector::{BackendConnector, PowerSyncCredentials};
-pub use sync::options::SyncOptions;
+pub use sync::download::DownloadQueueDepth;
+pub use sync::options::{DownloadBatchLimits, ReconnectPolicy, SyncOptions};
+pub use sync::progress::{PersistedDownload, ProgressCounters};
 pub use sync::status::SyncStatusData;
 pub use sync::stream_priority::StreamPriority;
+pub use util::WatchOptions;
 pub mod error;
+#[cfg(feature = "ffi")]
+pub mod ffi;
 pub mod http;
 
 pub mod schema {
     pub use super::db::schema::*;
 }
+
+/// Internal types used by the benchmarks of this crate. They're not part of the public API and
+/// may change at any time.
+#[doc(hidden)]
+pub mod bench {
+    pub use super::util::{BsonObjects, LineSplitter};
+}
@@ -11,10 +11,14 @@ pub trait BackendConnector: Send + Sync {
     async fn fetch_credentials(&self) -> Result<PowerSyncCredentials, PowerSyncError>;
 
     /// Inspects completed CRUD transactions on a database and uploads them.
+    ///
+    /// To upload many transactions with a single request, see
+    /// [crate::PowerSyncDatabase::next_crud_batch].
     async fn upload_data(&self) -> Result<(), PowerSyncError>;
 }
 
 /// Credentials used to connect to a PowerSync service instance.
+#[derive(Clone)]
 pub struct PowerSyncCredentials {
     /// PowerSync endpoint, e.g. `https://myinstance.powersync.co`.
     pub endpoint: String,
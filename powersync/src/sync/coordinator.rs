@@ -7,8 +7,9 @@ use crate::{
     SyncOptions,
     db::internal::InnerPowerSyncState,
     sync::{
-        download::DownloadActorCommand, streams::ChangedSyncSubscriptions,
-        upload::UploadActorCommand,
+        download::{DownloadActorCommand, DownloadPipelineCommand},
+        streams::ChangedSyncSubscriptions,
+        upload::{UploadActorCommand, UploadOptions},
     },
 };
 
@@ -39,19 +40,25 @@ impl<T> AsyncRequest<T> {
 pub struct SyncCoordinator {
     control_downloads: RwLock<Option<Sender<AsyncRequest<DownloadActorCommand>>>>,
     control_uploads: RwLock<Option<Sender<AsyncRequest<UploadActorCommand>>>>,
+    control_pipeline: RwLock<Option<Sender<AsyncRequest<DownloadPipelineCommand>>>>,
 }
 
 impl SyncCoordinator {
     pub async fn connect(&self, options: SyncOptions, db: &InnerPowerSyncState) {
         {
-            let mut lock = db.retry_delay.lock().unwrap();
-            *lock = Some(options.retry_delay);
+            let mut lock = db.reconnect_policy.lock().unwrap();
+            *lock = Some(options.reconnect);
         }
+        // Credentials from a previous connector must not be used with the new one.
+        db.credentials.invalidate();
 
-        let connector = options.connector.clone();
+        let upload_options = UploadOptions {
+            connector: options.connector.clone(),
+            pipelined: options.pipelined_upload,
+        };
         self.download_actor_request(DownloadActorCommand::Connect(options))
             .await;
-        self.upload_actor_request(UploadActorCommand::Connect(connector))
+        self.upload_actor_request(UploadActorCommand::Connect(upload_options))
             .await;
     }
 
@@ -126,6 +133,22 @@ impl SyncCoordinator {
         Self::install_actor_channel(&self.control_uploads)
     }
 
+    pub fn receive_pipeline_commands(&self) -> Receiver<AsyncRequest<DownloadPipelineCommand>> {
+        Self::install_actor_channel(&self.control_pipeline)
+    }
+
+    /// Hands a response stream to the download pipeline task, which starts reading from it.
+    pub async fn download_pipeline_request(&self, cmd: DownloadPipelineCommand) {
+        let pipeline = Self::obtain_channel(&self.control_pipeline);
+
+        let (request, response) = AsyncRequest::new(cmd);
+        pipeline
+            .send(request)
+            .await
+            .expect("Download pipeline not running, start it with async_tasks()");
+        let _ = response.await;
+    }
+
     async fn download_actor_request(&self, cmd: DownloadActorCommand) {
         let downloads = Self::obtain_channel(&self.control_downloads);
 
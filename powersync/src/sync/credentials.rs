@@ -0,0 +1,207 @@
+use std::pin::pin;
+use std::sync::{Arc, Mutex};
+
+use futures_lite::FutureExt;
+use futures_lite::future::{self, Boxed};
+use log::{debug, warn};
+
+use crate::{
+    db::internal::InnerPowerSyncState,
+    error::PowerSyncError,
+    sync::connector::{BackendConnector, PowerSyncCredentials},
+};
+
+/// Credentials last returned by [BackendConnector::fetch_credentials], shared between the upload
+/// and download actors.
+///
+/// Credentials are reused until the core extension reports them as expired, or until the sync
+/// service rejects them. This avoids a round trip to the backend for each reconnect or write
+/// checkpoint.
+#[derive(Default)]
+pub struct CredentialsCache {
+    current: Mutex<CachedCredentials>,
+}
+
+#[derive(Default)]
+struct CachedCredentials {
+    credentials: Option<PowerSyncCredentials>,
+    /// Incremented by [CredentialsCache::invalidate], so that fetches started before don't
+    /// store their results (which might come from a previous connector).
+    generation: u64,
+}
+
+impl CredentialsCache {
+    /// Returns cached credentials, or fetches them from the `connector` if none are available.
+    pub async fn get(
+        &self,
+        connector: &dyn BackendConnector,
+    ) -> Result<PowerSyncCredentials, PowerSyncError> {
+        let generation = {
+            let current = self.current.lock().unwrap();
+            if let Some(credentials) = &current.credentials {
+                return Ok(credentials.clone());
+            }
+
+            current.generation
+        };
+
+        let credentials = connector.fetch_credentials().await?;
+        self.store(generation, credentials.clone());
+        Ok(credentials)
+    }
+
+    /// Clears cached credentials, so that the next [Self::get] call fetches new ones.
+    ///
+    /// Fetches that are still in flight won't populate the cache once they complete.
+    pub fn invalidate(&self) {
+        let mut current = self.current.lock().unwrap();
+        current.credentials = None;
+        current.generation += 1;
+    }
+
+    /// Caches `credentials` unless the cache has been invalidated since `generation`.
+    fn store(&self, generation: u64, credentials: PowerSyncCredentials) -> bool {
+        let mut current = self.current.lock().unwrap();
+        if current.generation != generation {
+            return false;
+        }
+
+        current.credentials = Some(credentials);
+        true
+    }
+
+    /// Returns a future fetching new credentials and replacing the cached ones once they're
+    /// available.
+    ///
+    /// Until then, [Self::get] keeps returning the previous credentials.
+    pub fn refresh(
+        db: Arc<InnerPowerSyncState>,
+        connector: Arc<dyn BackendConnector>,
+    ) -> Boxed<()> {
+        let generation = db.credentials.current.lock().unwrap().generation;
+
+        async move {
+            match connector.fetch_credentials().await {
+                Ok(credentials) => {
+                    if db.credentials.store(generation, credentials) {
+                        debug!("Pre-fetched credentials");
+                    } else {
+                        debug!("Discarding pre-fetched credentials after invalidation");
+                    }
+                }
+                Err(e) => warn!("Could not pre-fetch credentials: {e}"),
+            }
+        }
+        .boxed()
+    }
+
+    /// Awaits `future` while also polling a pending `refresh` started with [Self::refresh].
+    ///
+    /// This allows refreshing credentials in the background of a task waiting for other events,
+    /// without requiring an executor to spawn tasks on.
+    pub async fn drive_refresh<T>(
+        refresh: &mut Option<Boxed<()>>,
+        future: impl Future<Output = T>,
+    ) -> T {
+        let mut future = pin!(future);
+
+        future::poll_fn(|cx| {
+            if let Some(pending) = refresh
+                && pending.poll(cx).is_ready()
+            {
+                *refresh = None;
+            }
+
+            future.as_mut().poll(cx)
+        })
+        .await
+    }
+}
+
+#[cfg(test)]
+mod test {
+    use std::pin::pin;
+    use std::sync::atomic::{AtomicUsize, Ordering};
+
+    use async_channel::Receiver;
+    use async_trait::async_trait;
+    use futures_lite::future;
+
+    use super::CredentialsCache;
+    use crate::{BackendConnector, PowerSyncCredentials, error::PowerSyncError};
+
+    #[derive(Default)]
+    struct CountingConnector {
+        fetched: AtomicUsize,
+    }
+
+    #[async_trait]
+    impl BackendConnector for CountingConnector {
+        async fn fetch_credentials(&self) -> Result<PowerSyncCredentials, PowerSyncError> {
+            let count = self.fetched.fetch_add(1, Ordering::SeqCst);
+            Ok(PowerSyncCredentials {
+                endpoint: "https://powersync.example.org".to_string(),
+                token: format!("token-{count}"),
+            })
+        }
+
+        async fn upload_data(&self) -> Result<(), PowerSyncError> {
+            Ok(())
+        }
+    }
+
+    #[test]
+    fn reuses_credentials() {
+        let cache = CredentialsCache::default();
+        let connector = CountingConnector::default();
+
+        future::block_on(async {
+            assert_eq!(cache.get(&connector).await.unwrap().token, "token-0");
+            assert_eq!(cache.get(&connector).await.unwrap().token, "token-0");
+
+            cache.invalidate();
+            assert_eq!(cache.get(&connector).await.unwrap().token, "token-1");
+        });
+        assert_eq!(connector.fetched.load(Ordering::SeqCst), 2);
+    }
+
+    /// A connector whose fetches complete once a message is sent to `release`.
+    struct BlockedConnector {
+        release: Receiver<()>,
+    }
+
+    #[async_trait]
+    impl BackendConnector for BlockedConnector {
+        async fn fetch_credentials(&self) -> Result<PowerSyncCredentials, PowerSyncError> {
+            self.release.recv().await.unwrap();
+            Ok(PowerSyncCredentials {
+                endpoint: "https://powersync.example.org".to_string(),
+                token: "previous-connector".to_string(),
+            })
+        }
+
+        async fn upload_data(&self) -> Result<(), PowerSyncError> {
+            Ok(())
+        }
+    }
+
+    #[test]
+    fn ignores_fetches_started_before_invalidation() {
+        let cache = CredentialsCache::default();
+        let (release, receiver) = async_channel::bounded(1);
+        let previous = BlockedConnector { release: receiver };
+        let next = CountingConnector::default();
+
+        future::block_on(async {
+            let mut pending = pin!(cache.get(&previous));
+            assert!(future::poll_once(pending.as_mut()).await.is_none());
+
+            // Connecting with another connector while the fetch is in flight.
+            cache.invalidate();
+            release.send(()).await.unwrap();
+            assert_eq!(pending.await.unwrap().token, "previous-connector");
+
+            assert_eq!(cache.get(&next).await.unwrap().token, "token-0");
+        });
+    }
+}
@@ -1,11 +1,11 @@
 use std::sync::Arc;
+use std::sync::atomic::{AtomicBool, Ordering};
 
 use futures_lite::{
     FutureExt,
     future::{self, Boxed},
 };
 use log::warn;
-use serde_json::Map;
 
 use crate::sync::coordinator::SyncCoordinator;
 use crate::{
@@ -14,7 +14,7 @@ use crate::{
     error::PowerSyncError,
     sync::{
         coordinator::AsyncRequest,
-        download::sync_iteration::{DownloadClient, DownloadEvent, StartDownloadIteration},
+        download::sync_iteration::{DownloadClient, DownloadEvent},
         instruction::CloseSyncStream,
         streams::ChangedSyncSubscriptions,
     },
@@ -34,6 +34,14 @@ pub struct DownloadActor {
     commands: async_channel::Receiver<AsyncRequest<DownloadActorCommand>>,
     db: Arc<InnerPowerSyncState>,
     options: Option<SyncOptions>,
+    /// Whether the current sync iteration has received a response from the sync service.
+    iteration_connected: Arc<AtomicBool>,
+    /// The amount of consecutive sync iterations that failed without connecting, used to back off
+    /// reconnects.
+    failures: u32,
+    /// Whether the current iteration was started immediately after the sync service closed the
+    /// previous one.
+    reconnected_immediately: bool,
 }
 
 impl DownloadActor {
@@ -45,6 +53,9 @@ impl DownloadActor {
             commands,
             db,
             options: None,
+            iteration_connected: Default::default(),
+            failures: 0,
+            reconnected_immediately: false,
         }
     }
 
@@ -56,15 +67,19 @@ impl DownloadActor {
 
     fn start_iteration(&mut self, options: SyncOptions) {
         let (send_events, receive_event) = async_channel::bounded(1);
-        let start = StartDownloadIteration {
-            parameters: serde_json::Value::Object(Map::new()),
-            schema: self.db.schema.clone(),
-            include_defaults: options.include_default_streams,
-            active_streams: self.db.current_streams.collect_active_streams(),
-        };
-        let future = DownloadClient::new(self.db.clone(), receive_event)
-            .run(options)
-            .boxed();
+        let start = self
+            .db
+            .start_payload
+            .get(&self.db, options.include_default_streams)
+            .expect("should serialize start payload");
+        self.iteration_connected = Default::default();
+        let future = DownloadClient::new(
+            self.db.clone(),
+            receive_event,
+            self.iteration_connected.clone(),
+        )
+        .run(options)
+        .boxed();
         send_events
             .try_send(DownloadEvent::Start(start))
             .expect("should send start message");
@@ -87,8 +102,7 @@ impl DownloadActor {
 
                 match command.command {
                     DownloadActorCommand::Connect(options) => {
-                        self.options = Some(options.clone());
-                        self.start_iteration(options);
+                        self.connect(options);
                         let _ = command.response.send(());
                     }
                     DownloadActorCommand::ResolveOfflineSyncStatusIfNotConnected => {
@@ -121,6 +135,7 @@ impl DownloadActor {
                 // So we have to listen for both.
                 enum Event {
                     ForwardedMessage,
+                    Connect(SyncOptions),
                     SyncIterationComplete(CloseSyncStream),
                     SyncIterationError(PowerSyncError),
                 }
@@ -128,9 +143,8 @@ impl DownloadActor {
                 let forwarding_request = async {
                     match self.commands.recv().await {
                         Ok(command) => match command.command {
-                            DownloadActorCommand::Connect(_) => {
-                                // We're already connected, do nothing.
-                                // TODO: Compare options and potentially reconnect
+                            DownloadActorCommand::Connect(options) => {
+                                return Event::Connect(options);
                             }
                             DownloadActorCommand::ResolveOfflineSyncStatusIfNotConnected => {
                                 // We're connected, so nothing we'd have to do.
@@ -172,22 +186,48 @@ impl DownloadActor {
                     Event::ForwardedMessage => {
                         // Message was handled, we can go on immediately.
                     }
+                    Event::Connect(options) => {
+                        let reconnect = self
+                            .options
+                            .as_ref()
+                            .is_none_or(|current| current.requires_reconnect(&options));
+
+                        if reconnect {
+                            // Dropping the current iteration closes its connection.
+                            self.connect(options);
+                        } else {
+                            // Options that don't affect the current connection (such as the
+                            // reconnect policy) apply to the next iteration.
+                            self.options = Some(options);
+                        }
+                    }
                     Event::SyncIterationComplete(close) => {
+                        let connected = self.iteration_connected.load(Ordering::SeqCst);
+                        if connected {
+                            self.failures = 0;
+                        }
+
                         let timeout = if close.hide_disconnect {
                             async {}.boxed()
+                        } else if connected && !self.reconnected_immediately {
+                            // The service closed an established connection, so reconnect right
+                            // away. If that happens again, we back off below.
+                            self.reconnected_immediately = true;
+                            async {}.boxed()
                         } else {
-                            let db = self.db.clone();
-
-                            async move { db.sync_iteration_delay().await }.boxed()
+                            self.backoff()
                         };
 
                         self.state = DownloadActorState::WaitingForReconnect { timeout }
                     }
                     Event::SyncIterationError(e) => {
+                        if self.iteration_connected.load(Ordering::SeqCst) {
+                            self.failures = 0;
+                        }
+
                         self.db.status.update(|status| status.set_download_error(e));
-                        let db = self.db.clone();
                         self.state = DownloadActorState::WaitingForReconnect {
-                            timeout: async move { db.sync_iteration_delay().await }.boxed(),
+                            timeout: self.backoff(),
                         }
                     }
                 }
@@ -197,13 +237,16 @@ impl DownloadActor {
                 // requested.
                 enum Event {
                     DisconnectRequested,
+                    ConnectRequested(SyncOptions),
                     TimeoutExpired,
                 }
 
                 let commands = self.commands.clone();
                 let disconnect_requested = async move {
-                    Self::wait_for_disconnect_request(&commands).await;
-                    Event::DisconnectRequested
+                    match Self::wait_for_connection_request(&commands).await {
+                        Some(options) => Event::ConnectRequested(options),
+                        None => Event::DisconnectRequested,
+                    }
                 };
 
                 let timeout_expired = async {
@@ -215,7 +258,14 @@ impl DownloadActor {
                     Event::DisconnectRequested => {
                         self.state = DownloadActorState::Idle;
                     }
+                    Event::ConnectRequested(options) => {
+                        // Explicit connect() calls skip the remaining delay.
+                        self.connect(options);
+                    }
                     Event::TimeoutExpired => {
+                        if let Some(metrics) = self.db.env.metrics() {
+                            metrics.reconnecting(self.failures);
+                        }
                         self.start_iteration(self.options.as_ref().unwrap().clone());
                     }
                 }
@@ -224,27 +274,48 @@ impl DownloadActor {
         };
     }
 
+    /// Starts a new sync iteration for a `connect()` call, resetting the reconnect backoff.
+    fn connect(&mut self, options: SyncOptions) {
+        self.failures = 0;
+        self.reconnected_immediately = false;
+        self.options = Some(options.clone());
+        self.start_iteration(options);
+    }
+
+    /// Increments the amount of consecutive failures and returns a future completing after the
+    /// resulting delay.
+    fn backoff(&mut self) -> Boxed<()> {
+        self.failures = self.failures.saturating_add(1);
+        self.reconnected_immediately = false;
+
+        let db = self.db.clone();
+        let failures = self.failures;
+        async move { db.sync_iteration_delay(failures).await }.boxed()
+    }
+
     /// Polls on the given channel until we receive a command indicating that the actor should
-    /// disconnect.
-    async fn wait_for_disconnect_request(
+    /// connect with new options (returning them) or disconnect (returning [None]).
+    async fn wait_for_connection_request(
         commands: &async_channel::Receiver<AsyncRequest<DownloadActorCommand>>,
-    ) {
+    ) -> Option<SyncOptions> {
         loop {
             match commands.recv().await {
                 Ok(command) => match command.command {
-                    DownloadActorCommand::Connect(_)
-                    | DownloadActorCommand::SubscriptionsChanged(_)
+                    DownloadActorCommand::Connect(options) => {
+                        return Some(options);
+                    }
+                    DownloadActorCommand::SubscriptionsChanged(_)
                     | DownloadActorCommand::ResolveOfflineSyncStatusIfNotConnected
                     | DownloadActorCommand::CrudUploadComplete => {
                         continue;
                     }
                     DownloadActorCommand::Disconnect => {
-                        return;
+                        return None;
                     }
                 },
                 Err(_) => {
                     // No clients left, treat that as a disconnect request and clean up resources.
-                    return;
+                    return None;
                 }
             }
         }
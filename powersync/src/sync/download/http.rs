@@ -1,15 +1,20 @@
 use std::borrow::Cow;
+use std::pin::Pin;
 use std::sync::Arc;
+use std::task::{Context, Poll};
 
 use crate::http::{Request, Response};
-use crate::util::LineSplitter;
+use crate::util::{ContentEncoding, LineSplitter};
 use crate::{
     db::internal::InnerPowerSyncState,
     error::{PowerSyncError, RawPowerSyncError},
     sync::{connector::PowerSyncCredentials, download::sync_iteration::DownloadEvent},
     util::BsonObjects,
 };
+use async_lock::SemaphoreGuardArc;
+use bytes::Bytes;
 use futures_lite::{Stream, StreamExt, stream};
+use pin_project_lite::pin_project;
 use serde::Deserialize;
 use serde_with::{DisplayFromStr, serde_as};
 
@@ -18,41 +23,77 @@ use serde_with::{DisplayFromStr, serde_as};
 pub fn sync_stream(
     db: Arc<InnerPowerSyncState>,
     auth: PowerSyncCredentials,
-    request_body: String,
+    request_body: Bytes,
 ) -> impl Stream<Item = Result<DownloadEvent, PowerSyncError>> {
+    let metrics = db.env.metrics.clone();
     let response = async move {
         let request = Request {
             method: "POST",
             url: auth.parsed_endpoint("sync/stream")?,
             headers: {
-                let mut headers: Vec<(&str, Cow<'_, str>)> = vec![];
-                headers.push(("Content-Type", "application/json".into()));
-                headers.push(("Authorization", format!("Token {}", auth.token).into()));
-                headers.push((
-                    "Accept",
-                    "application/vnd.powersync.bson-stream;q=0.9,application/x-ndjson;q=0.8".into(),
-                ));
+                let mut headers = service_headers(
+                    &auth,
+                    "application/vnd.powersync.bson-stream;q=0.9,application/x-ndjson;q=0.8",
+                );
+                if let Some(encodings) = ContentEncoding::ACCEPT {
+                    headers.push(("Accept-Encoding", encodings.into()));
+                }
 
                 headers
             },
-            body: Some(request_body.into_bytes()),
+            body: Some(request_body),
         };
 
+        // Hosts can limit the amount of concurrent sync streams, the permit is held until the
+        // response stream is dropped.
+        let permit = db.env.sync_stream_permit().await;
         let response = db.env.client.send(request).await?;
-        check_ok(response.status)?;
+        check_ok(&db, response.status)?;
 
-        Ok::<Response, PowerSyncError>(response)
+        Ok::<_, PowerSyncError>((response, permit))
     };
 
     let stream = stream::once_future(response);
 
-    StreamExt::flat_map(stream, |response| {
-        let items = response_to_lines(response);
-
-        stream::once(Ok(DownloadEvent::ConnectionEstablished)).chain(items)
+    StreamExt::flat_map(stream, move |response| {
+        let (response, permit) = match response {
+            Ok((response, permit)) => (Ok(response), permit),
+            Err(e) => (Err(e), None),
+        };
+        let metrics = metrics.clone();
+        let items = response_to_lines(response).map(move |item| {
+            if let (Some(metrics), Ok(event)) = (&metrics, &item) {
+                metrics.line_received(event.line_size());
+            }
+
+            item
+        });
+
+        PermittedStream {
+            inner: stream::once(Ok(DownloadEvent::ConnectionEstablished)).chain(items),
+            _permit: permit,
+        }
     })
 }
 
+pin_project! {
+    /// A [Stream] holding a sync stream permit of a [crate::env::PowerSyncHost] until it's
+    /// dropped.
+    struct PermittedStream<S> {
+        #[pin]
+        inner: S,
+        _permit: Option<SemaphoreGuardArc>,
+    }
+}
+
+impl<S: Stream> Stream for PermittedStream<S> {
+    type Item = S::Item;
+
+    fn poll_next(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<Option<Self::Item>> {
+        self.project().inner.poll_next(cx)
+    }
+}
+
 /// Requests a write checkpoint from the sync service.
 pub async fn write_checkpoint(
     db: &InnerPowerSyncState,
@@ -65,19 +106,12 @@ pub async fn write_checkpoint(
     let request = Request {
         method: "GET",
         url,
-        headers: {
-            let mut headers: Vec<(&str, Cow<'_, str>)> = vec![];
-            headers.push(("Content-Type", "application/json".into()));
-            headers.push(("Authorization", format!("Token {}", auth.token).into()));
-            headers.push(("Accept", "application/json".into()));
-
-            headers
-        },
+        headers: service_headers(&auth, "application/json"),
         body: None,
     };
 
     let response = db.env.client.send(request).await?;
-    check_ok(response.status)?;
+    check_ok(db, response.status)?;
 
     #[derive(Deserialize)]
     struct WriteCheckpointResponse {
@@ -97,10 +131,29 @@ pub async fn write_checkpoint(
     Ok(response.data.write_checkpoint)
 }
 
-fn check_ok(code: u16) -> Result<(), PowerSyncError> {
+/// The headers sent with every request to the sync service.
+///
+/// Static values are borrowed, so only the authorization header is allocated. The vector has
+/// room for the additional `Accept-Encoding` header of sync requests.
+fn service_headers(
+    auth: &PowerSyncCredentials,
+    accept: &'static str,
+) -> Vec<(&'static str, Cow<'static, str>)> {
+    let mut headers = Vec::with_capacity(4);
+    headers.push(("Content-Type", Cow::Borrowed("application/json")));
+    headers.push(("Authorization", format!("Token {}", auth.token).into()));
+    headers.push(("Accept", Cow::Borrowed(accept)));
+    headers
+}
+
+fn check_ok(db: &InnerPowerSyncState, code: u16) -> Result<(), PowerSyncError> {
     match code {
         200 => Ok(()),
-        401 => Err(RawPowerSyncError::InvalidCredentials.into()),
+        401 => {
+            // Don't use the rejected credentials for the next attempt.
+            db.credentials.invalidate();
+            Err(RawPowerSyncError::InvalidCredentials.into())
+        }
         _ => Err(RawPowerSyncError::UnexpectedStatusCode { code }.into()),
     }
 }
@@ -108,7 +161,7 @@ fn check_ok(code: u16) -> Result<(), PowerSyncError> {
 /// Reads sync lines from an HTTP response stream.
 ///
 /// For JSON responses, this splits at newline chars. For BSON responses, this tracks the length
-/// prefix to split at objects.
+/// prefix to split at objects. Compressed responses are decompressed before splitting them.
 fn response_to_lines(
     response: Result<Response, PowerSyncError>,
 ) -> impl Stream<Item = Result<DownloadEvent, PowerSyncError>> {
@@ -117,20 +170,27 @@ fn response_to_lines(
         Err(e) => return stream::once(Err::<DownloadEvent, PowerSyncError>(e)).boxed(),
     };
 
+    let reader = match ContentEncoding::from_header(response.content_encoding.as_deref())
+        .and_then(|encoding| encoding.decode(response.body.reader))
+    {
+        Ok(reader) => reader,
+        Err(e) => return stream::once(Err::<DownloadEvent, PowerSyncError>(e)).boxed(),
+    };
+
     let is_bson = match &response.content_type {
         None => false,
         Some(value) => value.contains("vnd.powersync.bson-stream"),
     };
 
     if is_bson {
-        BsonObjects::new(response.body.reader)
+        BsonObjects::new(reader)
             .map(|event| match event {
                 Ok(line) => Ok(DownloadEvent::BinaryLine { data: line }),
                 Err(e) => Err(e),
             })
             .boxed()
     } else {
-        LineSplitter::from(response.body.reader)
+        LineSplitter::from(reader)
             .map(|event| match event {
                 Ok(line) => Ok(DownloadEvent::TextLine { data: line }),
                 Err(e) => Err(e),
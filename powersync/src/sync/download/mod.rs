@@ -1,5 +1,8 @@
 mod actor;
 pub mod http;
+mod pipeline;
 mod sync_iteration;
 
 pub use actor::{DownloadActor, DownloadActorCommand};
+pub use pipeline::{DownloadPipeline, DownloadPipelineCommand, DownloadQueueDepth};
+pub use sync_iteration::StartPayloadCache;
@@ -0,0 +1,226 @@
+use std::sync::{
+    Arc,
+    atomic::{AtomicBool, AtomicUsize, Ordering},
+};
+
+use async_channel::{Receiver, Sender};
+use event_listener::Event;
+use futures_lite::{StreamExt, future, stream, stream::Boxed as BoxedStream};
+
+use crate::{
+    error::PowerSyncError,
+    sync::{
+        coordinator::{AsyncRequest, SyncCoordinator},
+        download::sync_iteration::DownloadEvent,
+    },
+};
+
+type EventStream = BoxedStream<Result<DownloadEvent, PowerSyncError>>;
+
+/// A command sent from the download client to the pipeline task.
+pub enum DownloadPipelineCommand {
+    /// Start reading events from the given stream into the queue.
+    Pump {
+        source: EventStream,
+        queue: Arc<DownloadQueue>,
+        sink: Sender<Result<DownloadEvent, PowerSyncError>>,
+    },
+}
+
+/// A task reading sync lines from the network into a [DownloadQueue].
+///
+/// Running this as its own task allows the response stream to be drained while the download client
+/// applies a previous batch of lines on the writer connection.
+pub struct DownloadPipeline {
+    commands: Receiver<AsyncRequest<DownloadPipelineCommand>>,
+}
+
+impl DownloadPipeline {
+    pub fn new(sync: &SyncCoordinator) -> Self {
+        Self {
+            commands: sync.receive_pipeline_commands(),
+        }
+    }
+
+    pub async fn run(&mut self) {
+        while let Ok(mut request) = self.commands.recv().await {
+            let _ = request.response.send(());
+
+            match request.command {
+                DownloadPipelineCommand::Pump {
+                    source,
+                    queue,
+                    sink,
+                } => Self::pump(source, &queue, sink).await,
+            }
+        }
+    }
+
+    async fn pump(
+        mut source: EventStream,
+        queue: &DownloadQueue,
+        sink: Sender<Result<DownloadEvent, PowerSyncError>>,
+    ) {
+        while queue.wait_for_capacity().await {
+            let next = future::or(async { Some(source.next().await) }, async {
+                queue.wait_for_close().await;
+                None
+            })
+            .await;
+
+            // The stream is closed or the receiving end is no longer interested in events. Dropping
+            // the sink then causes the receiver to see the end of the stream.
+            let Some(Some(event)) = next else {
+                return;
+            };
+
+            let is_error = event.is_err();
+            queue.add(&event);
+            if sink.send(event).await.is_err() || is_error {
+                return;
+            }
+        }
+    }
+}
+
+/// A byte-budgeted queue of download events that have been received from the sync service, but not
+/// yet applied to the database.
+pub struct DownloadQueue {
+    max_bytes: usize,
+    lines: AtomicUsize,
+    bytes: AtomicUsize,
+    closed: AtomicBool,
+    /// Notified when events are removed from the queue or when it is closed.
+    changed: Event,
+}
+
+impl DownloadQueue {
+    /// Creates a new queue and returns a [futures_lite::Stream] emitting events in that queue.
+    ///
+    /// The events are read from `source` by the [DownloadPipeline] task, which may buffer up to
+    /// `max_bytes` of sync lines ahead of the returned stream.
+    pub async fn pipelined(
+        sync: &SyncCoordinator,
+        source: EventStream,
+        max_bytes: usize,
+    ) -> (Arc<Self>, EventStream) {
+        let queue = Arc::new(Self {
+            max_bytes,
+            lines: AtomicUsize::new(0),
+            bytes: AtomicUsize::new(0),
+            closed: AtomicBool::new(false),
+            changed: Event::new(),
+        });
+        let (sink, receiver) = async_channel::unbounded();
+
+        sync.download_pipeline_request(DownloadPipelineCommand::Pump {
+            source,
+            queue: queue.clone(),
+            sink,
+        })
+        .await;
+
+        let receiver = QueueReceiver {
+            queue: queue.clone(),
+            receiver,
+        };
+        let events = stream::unfold(receiver, |receiver| async move {
+            let event = receiver.receiver.recv().await.ok()?;
+            receiver.queue.remove(&event);
+            Some((event, receiver))
+        });
+
+        (queue, events.boxed())
+    }
+
+    /// The amount of lines and bytes currently in this queue.
+    pub fn depth(&self) -> DownloadQueueDepth {
+        DownloadQueueDepth {
+            lines: self.lines.load(Ordering::SeqCst),
+            bytes: self.bytes.load(Ordering::SeqCst),
+        }
+    }
+
+    fn has_capacity(&self) -> bool {
+        self.bytes.load(Ordering::SeqCst) < self.max_bytes
+    }
+
+    fn is_closed(&self) -> bool {
+        self.closed.load(Ordering::SeqCst)
+    }
+
+    /// Waits until the queue has room for another event, returning `false` if the queue has been
+    /// closed instead.
+    async fn wait_for_capacity(&self) -> bool {
+        loop {
+            if self.is_closed() {
+                return false;
+            }
+            if self.has_capacity() {
+                return true;
+            }
+
+            let listener = self.changed.listen();
+            if self.is_closed() || self.has_capacity() {
+                continue;
+            }
+
+            listener.await;
+        }
+    }
+
+    async fn wait_for_close(&self) {
+        while !self.is_closed() {
+            let listener = self.changed.listen();
+            if self.is_closed() {
+                return;
+            }
+
+            listener.await;
+        }
+    }
+
+    fn add(&self, event: &Result<DownloadEvent, PowerSyncError>) {
+        if let Ok(event) = event
+            && event.is_line()
+        {
+            self.lines.fetch_add(1, Ordering::SeqCst);
+            self.bytes.fetch_add(event.line_size(), Ordering::SeqCst);
+        }
+    }
+
+    fn remove(&self, event: &Result<DownloadEvent, PowerSyncError>) {
+        if let Ok(event) = event
+            && event.is_line()
+        {
+            self.lines.fetch_sub(1, Ordering::SeqCst);
+            self.bytes.fetch_sub(event.line_size(), Ordering::SeqCst);
+            self.changed.notify(usize::MAX);
+        }
+    }
+}
+
+/// The receiving end of a [DownloadQueue], closing the queue when dropped.
+struct QueueReceiver {
+    queue: Arc<DownloadQueue>,
+    receiver: Receiver<Result<DownloadEvent, PowerSyncError>>,
+}
+
+impl Drop for QueueReceiver {
+    fn drop(&mut self) {
+        self.queue.closed.store(true, Ordering::SeqCst);
+        self.queue.changed.notify(usize::MAX);
+    }
+}
+
+/// The amount of sync lines that have been received from the sync service, but not yet applied to
+/// the local database.
+///
+/// This is only tracked for pipelined downloads, see [crate::SyncOptions::with_pipelined_download].
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct DownloadQueueDepth {
+    /// The amount of buffered sync lines.
+    pub lines: usize,
+    /// The total size of buffered sync lines, in bytes.
+    pub bytes: usize,
+}
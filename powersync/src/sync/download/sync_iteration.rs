@@ -1,27 +1,50 @@
-use std::sync::Arc;
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{Arc, Mutex};
+use std::time::Instant;
 
-use futures_lite::{StreamExt, future, stream::Boxed as BoxedStream};
+use bytes::Bytes;
+use futures_lite::{
+    StreamExt,
+    future::{self, Boxed},
+    stream::Boxed as BoxedStream,
+};
 use log::{debug, info, trace, warn};
 use powersync_sqlite_nostd::{Destructor, ManagedStmt, ResultCode};
 use serde::Serialize;
 use serde_json::value::RawValue;
 
 use crate::db::connection::{SqliteConnection, TransactionGuard};
-use crate::schema::SchemaOrCustom;
+use crate::db::pool::LeasedConnection;
 use crate::{
-    SyncOptions,
+    DownloadBatchLimits, SyncOptions,
     db::internal::InnerPowerSyncState,
+    env::MetricsObserver,
     error::PowerSyncError,
     sync::{
-        download::http::sync_stream,
+        credentials::CredentialsCache,
+        download::{DownloadQueueDepth, http::sync_stream, pipeline::DownloadQueue},
         instruction::{CloseSyncStream, Instruction, LogSeverity},
+        status::CoalescedStatusUpdates,
         streams::StreamKey,
     },
+    util::Utf8Bytes,
 };
 
 pub struct DownloadClient {
     db: Arc<InnerPowerSyncState>,
     stream: Option<BoxedStream<Result<DownloadEvent, PowerSyncError>>>,
+    /// An event received on [Self::stream] while collecting a batch that could not be added to
+    /// that batch. It is handled before polling for further events.
+    pending_event: Option<Result<DownloadEvent, PowerSyncError>>,
+    /// For pipelined downloads, the queue of events buffered ahead of [Self::stream].
+    queue: Option<Arc<DownloadQueue>>,
+    /// The [DownloadQueueDepth] last reported in the sync status.
+    reported_queue_depth: DownloadQueueDepth,
+    /// A pending [CredentialsCache::refresh], polled while waiting for events.
+    credentials_refresh: Option<Boxed<()>>,
+    /// Set once a response from the sync service has been received, used by the download actor to
+    /// reset its reconnect backoff.
+    connected: Arc<AtomicBool>,
     receive_commands: async_channel::Receiver<DownloadEvent>,
 }
 
@@ -29,31 +52,84 @@ impl DownloadClient {
     pub fn new(
         db: Arc<InnerPowerSyncState>,
         events: async_channel::Receiver<DownloadEvent>,
+        connected: Arc<AtomicBool>,
     ) -> Self {
         Self {
             db,
             stream: None,
+            pending_event: None,
+            queue: None,
+            reported_queue_depth: DownloadQueueDepth::default(),
+            credentials_refresh: None,
+            connected,
             receive_commands: events,
         }
     }
 
     pub async fn run(mut self, options: SyncOptions) -> Result<CloseSyncStream, PowerSyncError> {
+        let mut status = CoalescedStatusUpdates::new(options.status_update_interval);
+        let result = self.run_iteration(&options, &mut status).await;
+        // Don't lose progress updates that have been held back when the iteration ends.
+        status.flush(&self.db.status);
+
+        result
+    }
+
+    async fn run_iteration(
+        &mut self,
+        options: &SyncOptions,
+        status: &mut CoalescedStatusUpdates,
+    ) -> Result<CloseSyncStream, PowerSyncError> {
         'event: loop {
-            let event = match &mut self.stream {
-                Some(stream) => {
-                    future::or(
+            let event = match (self.pending_event.take(), &mut self.stream) {
+                (Some(pending), _) => pending,
+                (None, Some(stream)) => {
+                    let next = future::or(
                         Self::receive_command(&self.receive_commands),
                         Self::receive_on_stream(stream),
-                    )
-                    .await
+                    );
+
+                    // Publish held back status updates if no further events arrive in time.
+                    let deadline = status.flush_deadline(self.db.env.timer);
+                    let next = future::or(async { Some(next.await) }, async {
+                        match deadline {
+                            Some(deadline) => deadline.await,
+                            None => future::pending().await,
+                        }
+                        None
+                    });
+
+                    match CredentialsCache::drive_refresh(&mut self.credentials_refresh, next).await
+                    {
+                        Some(event) => event,
+                        None => {
+                            status.flush(&self.db.status);
+                            continue 'event;
+                        }
+                    }
                 }
-                None => Self::receive_command(&self.receive_commands).await,
+                (None, None) => Self::receive_command(&self.receive_commands).await,
             }?;
 
-            trace!("Handling event {event:?}");
-            let mut conn = self.db.writer().await?;
+            if let DownloadEvent::ConnectionEstablished = event {
+                self.connected.store(true, Ordering::SeqCst);
+            }
+            let instructions = self.apply_batch(event, &options.download_batch).await?;
+            // Only the most recent status is relevant if a batch emitted multiple status updates.
+            let last_status_update = instructions
+                .iter()
+                .rposition(|i| matches!(i, Instruction::UpdateSyncStatus { .. }));
+            let queue_depth = self
+                .queue
+                .as_ref()
+                .map(|queue| queue.depth())
+                .unwrap_or_default();
+            if last_status_update.is_none() && queue_depth != self.reported_queue_depth {
+                status.update(&self.db.status, None, queue_depth);
+                self.reported_queue_depth = queue_depth;
+            }
 
-            for instr in event.invoke_control(conn.sqlite_connection_mut())? {
+            for (index, instr) in instructions.into_iter().enumerate() {
                 trace!("Handling instruction {instr:?}");
 
                 match instr {
@@ -62,28 +138,33 @@ impl DownloadClient {
                         LogSeverity::Info => info!("{}", line),
                         LogSeverity::Warning => warn!("{}", line),
                     },
-                    Instruction::UpdateSyncStatus { status } => {
-                        self.db.status.update(|s| s.update_from_core(status))
+                    Instruction::UpdateSyncStatus { status: core } => {
+                        if Some(index) == last_status_update {
+                            status.update(&self.db.status, Some(core), queue_depth);
+                            self.reported_queue_depth = queue_depth;
+                        }
                     }
                     Instruction::EstablishSyncStream { request } => {
                         trace!("Establishing sync stream with {request}");
-                        Self::establish_sync_stream(
-                            Arc::clone(&self.db),
-                            &mut self.stream,
-                            request,
-                            &options,
-                        )
-                        .await?;
+                        self.establish_sync_stream(request, options).await?;
 
                         // Trigger a crud upload after establishing a sync stream.
                         if let Some(sync) = self.db.sync.upgrade() {
                             sync.trigger_crud_uploads().await;
                         }
                     }
-                    Instruction::FetchCredentials { .. } => {
-                        // TODO: Pre-fetching credentials
-                        // If did_expire is true, the core extension will also emit a stop
-                        // instruction. So we don't have to handle that separately.
+                    Instruction::FetchCredentials { did_expire } => {
+                        if did_expire {
+                            // The core extension will also emit a stop instruction, so we don't
+                            // have to handle that separately. The next connection attempt must
+                            // use new credentials though.
+                            self.db.credentials.invalidate();
+                        } else if self.credentials_refresh.is_none() {
+                            self.credentials_refresh = Some(CredentialsCache::refresh(
+                                self.db.clone(),
+                                options.connector.clone(),
+                            ));
+                        }
                     }
                     Instruction::CloseSyncStream(close) => {
                         break 'event Ok(close);
@@ -100,16 +181,119 @@ impl DownloadClient {
         }
     }
 
+    /// Forwards the `first` event to the core extension.
+    ///
+    /// If that event is a sync line, further lines that are immediately available on the response
+    /// stream are applied in the same transaction (up to the configured [DownloadBatchLimits]).
+    /// The writer connection is released before returning, so local writes can run between
+    /// batches.
+    ///
+    /// Batches also end after a line completing a checkpoint. With prioritized streams, the service
+    /// sends a `partial_checkpoint_complete` line once the data for higher priorities has been
+    /// sent, so committing right away makes that data visible to watchers without waiting for
+    /// lower-priority lines buffered behind it.
+    ///
+    /// Calls to `powersync_control` run through [InnerPowerSyncState::run_blocking], so they don't
+    /// block the executor polling this client if a blocking pool has been configured.
+    async fn apply_batch(
+        &mut self,
+        first: DownloadEvent,
+        limits: &DownloadBatchLimits,
+    ) -> Result<Vec<Instruction>, PowerSyncError> {
+        trace!("Handling event {first:?}");
+        // Local writes made by the application take precedence over applying sync lines.
+        let conn = self.db.background_writer().await?;
+
+        let started = Instant::now();
+        let mut lines = 1usize;
+        let mut bytes = first.line_size();
+        let mut add_lines = first.is_line() && !first.completes_checkpoint();
+        let metrics = self.db.env.metrics.clone();
+        let (mut tx, mut instructions) = self
+            .db
+            .run_blocking(move || {
+                let tx = BatchTransaction::begin(conn, metrics)?;
+                let instructions = tx.apply(first)?;
+                Ok::<_, PowerSyncError>((tx, instructions))
+            })
+            .await?;
+
+        while add_lines
+            && lines < limits.max_lines
+            && bytes < limits.max_bytes
+            && started.elapsed() < limits.max_duration
+            // Commands (e.g. a disconnect request) take precedence over further lines.
+            && self.receive_commands.is_empty()
+            && !instructions.iter().any(Instruction::ends_batch)
+        {
+            let Some(stream) = &mut self.stream else {
+                break;
+            };
+
+            // We never wait for the network while holding the writer connection, so only lines
+            // that have already been received are added to the batch.
+            let Some(next) = future::poll_once(Self::receive_on_stream(stream)).await else {
+                break;
+            };
+
+            match next {
+                Ok(event) if event.is_line() => {
+                    trace!("Handling event {event:?} in batch");
+                    lines += 1;
+                    bytes += event.line_size();
+                    add_lines = !event.completes_checkpoint();
+
+                    let (returned, applied) = self
+                        .db
+                        .run_blocking(move || {
+                            let applied = tx.apply(event);
+                            (tx, applied)
+                        })
+                        .await;
+                    tx = returned;
+                    instructions.extend(applied?);
+                }
+                other => {
+                    self.pending_event = Some(other);
+                    add_lines = false;
+                }
+            }
+        }
+
+        self.db.run_blocking(move || tx.commit()).await?;
+        if let Some(metrics) = self.db.env.metrics() {
+            metrics.batch_applied(lines, bytes, started.elapsed());
+        }
+        if lines > 1 {
+            trace!("Applied {lines} lines ({bytes} bytes) in a single transaction");
+        }
+
+        Ok(instructions)
+    }
+
     async fn establish_sync_stream(
-        db: Arc<InnerPowerSyncState>,
-        stream: &mut Option<BoxedStream<Result<DownloadEvent, PowerSyncError>>>,
+        &mut self,
         request: Box<RawValue>,
         options: &SyncOptions,
     ) -> Result<(), PowerSyncError> {
-        let credentials = options.connector.fetch_credentials().await?;
-        let request = request.get().to_string();
+        // Dropping a previous stream also stops the download pipeline from reading it.
+        self.stream = None;
+        self.queue = None;
 
-        *stream = Some(sync_stream(db, credentials, request).boxed());
+        let credentials = self.db.credentials.get(options.connector.as_ref()).await?;
+        // Reuse the allocation of the instruction for the request body.
+        let request: Box<str> = request.into();
+        let request = Bytes::from(request.into_boxed_bytes());
+        let source = sync_stream(self.db.clone(), credentials, request).boxed();
+
+        self.stream = Some(match (options.pipelined_download, self.db.sync.upgrade()) {
+            (Some(max_bytes), Some(sync)) => {
+                let (queue, events) = DownloadQueue::pipelined(&sync, source, max_bytes).await;
+                self.queue = Some(queue);
+                events
+            }
+            _ => source,
+        });
         Ok(())
     }
 
@@ -129,6 +313,56 @@ impl DownloadClient {
     }
 }
 
+/// A transaction on a leased writer connection, which can be moved to the threads of a blocking
+/// pool between sync lines.
+///
+/// Like [TransactionGuard], the transaction is rolled back if it's dropped without being
+/// committed. This includes the future applying a batch being dropped while the transaction is
+/// used on a pool thread.
+struct BatchTransaction {
+    conn: LeasedConnection,
+    active: bool,
+    metrics: Option<Arc<dyn MetricsObserver>>,
+}
+
+impl BatchTransaction {
+    fn begin(
+        mut conn: LeasedConnection,
+        metrics: Option<Arc<dyn MetricsObserver>>,
+    ) -> Result<Self, PowerSyncError> {
+        TransactionGuard::new(conn.sqlite_connection_mut())?.disarm();
+        Ok(Self {
+            conn,
+            active: true,
+            metrics,
+        })
+    }
+
+    fn apply(&self, event: DownloadEvent) -> Result<Vec<Instruction>, PowerSyncError> {
+        let Some(metrics) = &self.metrics else {
+            return event.invoke_control(self.conn.sqlite_connection());
+        };
+
+        let started = Instant::now();
+        let instructions = event.invoke_control(self.conn.sqlite_connection());
+        metrics.line_applied(started.elapsed());
+        instructions
+    }
+
+    fn commit(mut self) -> Result<(), PowerSyncError> {
+        self.active = false;
+        self.conn.sqlite_connection().exec(c"COMMIT")
+    }
+}
+
+impl Drop for BatchTransaction {
+    fn drop(&mut self) {
+        if self.active {
+            let _ = self.conn.sqlite_connection().exec(c"ROLLBACK");
+        }
+    }
+}
+
 /// An event that triggers the downloading client to advance.
 ///
 /// This is typically a received line from the PowerSync service, but local events are also
@@ -136,13 +370,20 @@ impl DownloadClient {
 #[derive(Debug)]
 pub enum DownloadEvent {
     /// `connect()` has been called and we need to start establishing a connection.
-    Start(StartDownloadIteration),
+    ///
+    /// The payload is the serialized [StartDownloadIteration], see [StartPayloadCache].
+    Start(Arc<str>),
     /// `disconnect()` has been called or the token has expired.
     Stop,
     /// A textual JSON sync line has been received from the service.
-    TextLine { data: String },
+    ///
+    /// Like binary lines, this is typically a slice of a chunk from the HTTP response.
+    TextLine { data: Utf8Bytes },
     /// A binary BSON sync line has been received from the service.
-    BinaryLine { data: Vec<u8> },
+    ///
+    /// This is typically a slice of a chunk from the HTTP response, and bound to `powersync_control`
+    /// without copying.
+    BinaryLine { data: Bytes },
     /// A CRUD upload was completed, so the client can re-try applying data.
     CompletedUpload,
     /// HTTP response headers for the sync response have been received, meaning that the sync status
@@ -159,13 +400,9 @@ impl DownloadEvent {
         use PowerSyncControlArgument::*;
 
         match self {
-            DownloadEvent::Start(start_download_iteration) => {
-                let serialized = serde_json::to_string(&start_download_iteration)
-                    .expect("should serialize to string");
-                ("start", String(serialized))
-            }
+            DownloadEvent::Start(payload) => ("start", Shared(payload)),
             DownloadEvent::Stop => ("stop", Null),
-            DownloadEvent::TextLine { data } => ("line_text", String(data)),
+            DownloadEvent::TextLine { data } => ("line_text", Text(data)),
             DownloadEvent::BinaryLine { data } => ("line_binary", Bytes(data)),
             DownloadEvent::CompletedUpload => ("completed_upload", Null),
             DownloadEvent::ConnectionEstablished => ("connection", StaticString("established")),
@@ -177,34 +414,81 @@ impl DownloadEvent {
         }
     }
 
-    /// Forwards the event to the core extension, and returns instructions that the SDK needs to
-    /// perform.
-    pub fn invoke_control(
-        self,
-        conn: &mut SqliteConnection,
-    ) -> Result<Vec<Instruction>, PowerSyncError> {
-        let tx = TransactionGuard::new(conn)?;
+    /// Whether this event is a sync line received from the sync service.
+    pub(super) fn is_line(&self) -> bool {
+        matches!(
+            self,
+            DownloadEvent::TextLine { .. } | DownloadEvent::BinaryLine { .. }
+        )
+    }
 
-        let instructions = {
-            let stmt = tx.inner.prepare("SELECT powersync_control(?, ?)")?;
-            let (op, arg) = self.into_powersync_control_argument();
+    /// The size of the sync line represented by this event, or zero for other events.
+    pub(super) fn line_size(&self) -> usize {
+        match self {
+            DownloadEvent::TextLine { data } => data.len(),
+            DownloadEvent::BinaryLine { data } => data.len(),
+            _ => 0,
+        }
+    }
 
-            stmt.bind_text(1, op, Destructor::STATIC)?;
-            arg.bind_to(&stmt, 2)?;
+    /// Whether this event is a `checkpoint_complete` or `partial_checkpoint_complete` sync line,
+    /// after which the core extension applies downloaded data to the local database.
+    ///
+    /// Sync lines are objects with a single key, so this only inspects the start of the line
+    /// instead of parsing it.
+    pub(super) fn completes_checkpoint(&self) -> bool {
+        const KEYS: [&str; 2] = ["checkpoint_complete", "partial_checkpoint_complete"];
 
-            if let ResultCode::ROW = stmt.step()? {
-                let instructions = stmt.column_text(0).map_err(|_| {
-                    PowerSyncError::argument_error("Could not read powersync_control instructions")
-                })?;
+        match self {
+            DownloadEvent::TextLine { data } => data
+                .as_str()
+                .trim_start()
+                .strip_prefix('{')
+                .and_then(|line| line.trim_start().strip_prefix('"'))
+                .is_some_and(|line| {
+                    KEYS.iter().any(|key| {
+                        line.strip_prefix(key)
+                            .is_some_and(|rest| rest.starts_with('"'))
+                    })
+                }),
+            DownloadEvent::BinaryLine { data } => {
+                // A BSON document starts with its length, followed by the type and the
+                // null-terminated name of the first element.
+                const EMBEDDED_DOCUMENT: u8 = 0x03;
 
-                serde_json::from_str(instructions)?
-            } else {
-                panic!("Expected a row") // Can't happen, scalar select
+                data.get(4) == Some(&EMBEDDED_DOCUMENT)
+                    && KEYS.iter().any(|key| {
+                        data[5..]
+                            .strip_prefix(key.as_bytes())
+                            .is_some_and(|rest| rest.first() == Some(&0))
+                    })
             }
-        };
+            _ => false,
+        }
+    }
 
-        tx.commit()?;
-        Ok(instructions)
+    /// Forwards the event to the core extension, and returns instructions that the SDK needs to
+    /// perform.
+    ///
+    /// The connection is expected to be in a transaction, which allows applying multiple events
+    /// with a single commit.
+    fn invoke_control(self, conn: &SqliteConnection) -> Result<Vec<Instruction>, PowerSyncError> {
+        // The argument needs to outlive the statement it's bound to.
+        let (op, arg) = self.into_powersync_control_argument();
+        let stmt = conn.prepare_cached("SELECT powersync_control(?, ?)")?;
+
+        stmt.bind_text(1, op, Destructor::STATIC)?;
+        arg.bind_to(&stmt, 2)?;
+
+        if let ResultCode::ROW = stmt.step()? {
+            let instructions = stmt.column_text(0).map_err(|_| {
+                PowerSyncError::argument_error("Could not read powersync_control instructions")
+            })?;
+
+            Ok(serde_json::from_str(instructions)?)
+        } else {
+            panic!("Expected a row") // Can't happen, scalar select
+        }
     }
 }
 
@@ -212,7 +496,9 @@ enum PowerSyncControlArgument {
     Null,
     StaticString(&'static str),
     String(String),
-    Bytes(Vec<u8>),
+    Shared(Arc<str>),
+    Text(Utf8Bytes),
+    Bytes(Bytes),
 }
 
 impl PowerSyncControlArgument {
@@ -225,6 +511,10 @@ impl PowerSyncControlArgument {
                 stmt.bind_text(index, str, Destructor::STATIC)
             }
             PowerSyncControlArgument::String(str) => stmt.bind_text(index, str, Destructor::STATIC),
+            PowerSyncControlArgument::Shared(str) => stmt.bind_text(index, str, Destructor::STATIC),
+            PowerSyncControlArgument::Text(text) => {
+                stmt.bind_text(index, text.as_str(), Destructor::STATIC)
+            }
             PowerSyncControlArgument::Bytes(bytes) => {
                 stmt.bind_blob(index, bytes, Destructor::STATIC)
             }
@@ -234,9 +524,105 @@ impl PowerSyncControlArgument {
 }
 
 #[derive(Debug, Serialize)]
-pub struct StartDownloadIteration {
+pub struct StartDownloadIteration<'a> {
     pub parameters: serde_json::Value,
-    pub schema: Arc<SchemaOrCustom>,
+    pub schema: &'a RawValue,
     pub include_defaults: bool,
-    pub active_streams: Vec<StreamKey>,
+    pub active_streams: &'a [StreamKey],
+}
+
+/// The serialized [StartDownloadIteration] of the last sync iteration.
+///
+/// The payload includes the schema, which can be large for apps using raw tables. Since the
+/// schema of a database doesn't change, the payload is reused for reconnects until the
+/// subscribed streams or sync options change.
+#[derive(Default)]
+pub struct StartPayloadCache {
+    last: Mutex<Option<CachedStartPayload>>,
+}
+
+struct CachedStartPayload {
+    include_defaults: bool,
+    active_streams: Vec<StreamKey>,
+    payload: Arc<str>,
+}
+
+impl StartPayloadCache {
+    /// Returns the payload of a `start` event for the current streams of `db`, serializing it
+    /// only if it differs from the previous one.
+    pub fn get(
+        &self,
+        db: &InnerPowerSyncState,
+        include_defaults: bool,
+    ) -> Result<Arc<str>, PowerSyncError> {
+        let active_streams = db.current_streams.collect_active_streams();
+        let mut last = self.last.lock().unwrap();
+        if let Some(cached) = &*last
+            && cached.include_defaults == include_defaults
+            && cached.active_streams == active_streams
+        {
+            return Ok(cached.payload.clone());
+        }
+
+        let schema = db.serialized_schema()?;
+        let payload: Arc<str> = serde_json::to_string(&StartDownloadIteration {
+            parameters: serde_json::Value::Object(Default::default()),
+            schema: &schema,
+            include_defaults,
+            active_streams: &active_streams,
+        })?
+        .into();
+
+        *last = Some(CachedStartPayload {
+            include_defaults,
+            active_streams,
+            payload: payload.clone(),
+        });
+        Ok(payload)
+    }
+}
+
+#[cfg(test)]
+mod test {
+    use bytes::Bytes;
+
+    use super::DownloadEvent;
+
+    fn text_line(line: &'static str) -> DownloadEvent {
+        DownloadEvent::TextLine {
+            data: Bytes::from_static(line.as_bytes()).try_into().unwrap(),
+        }
+    }
+
+    fn binary_line(key: &str) -> DownloadEvent {
+        // A document with a single element, the empty embedded document under `key`.
+        let mut data = vec![0; 4];
+        data.push(0x03);
+        data.extend_from_slice(key.as_bytes());
+        data.push(0);
+        data.extend_from_slice(&[5, 0, 0, 0, 0]);
+        data.push(0);
+
+        let length = data.len() as i32;
+        data[..4].copy_from_slice(&length.to_le_bytes());
+        DownloadEvent::BinaryLine { data: data.into() }
+    }
+
+    #[test]
+    fn detects_checkpoint_completion() {
+        assert!(text_line(r#"{"checkpoint_complete":{"last_op_id":"1"}}"#).completes_checkpoint());
+        assert!(
+            text_line(r#" { "partial_checkpoint_complete": {"priority": 1}}"#)
+                .completes_checkpoint()
+        );
+        assert!(!text_line(r#"{"checkpoint":{"last_op_id":"1"}}"#).completes_checkpoint());
+        assert!(!text_line(r#"{"checkpoint_completed":{}}"#).completes_checkpoint());
+        assert!(!text_line(r#"{"data":{"bucket":"a"}}"#).completes_checkpoint());
+
+        assert!(binary_line("checkpoint_complete").completes_checkpoint());
+        assert!(binary_line("partial_checkpoint_complete").completes_checkpoint());
+        assert!(!binary_line("checkpoint").completes_checkpoint());
+        assert!(!binary_line("checkpoint_complete_").completes_checkpoint());
+        assert!(!DownloadEvent::ResponseStreamEnd.completes_checkpoint());
+    }
 }
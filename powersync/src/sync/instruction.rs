@@ -25,8 +25,7 @@ pub enum Instruction {
         /// Whether the credentials currently used have expired.
         ///
         /// If false, this is a pre-fetch.
-        #[serde(rename = "did_expire")]
-        _did_expire: bool,
+        did_expire: bool,
     },
     // These are defined like this because deserializers in Kotlin can't support either an
     // object or a literal value
@@ -38,6 +37,19 @@ pub enum Instruction {
     DidCompleteSync {},
 }
 
+impl Instruction {
+    /// Whether this instruction needs to be handled before applying further sync lines.
+    ///
+    /// This is the case for instructions changing the connection to the sync service, further lines
+    /// from the current response must not be applied in the same batch.
+    pub fn ends_batch(&self) -> bool {
+        matches!(
+            self,
+            Instruction::EstablishSyncStream { .. } | Instruction::CloseSyncStream(_)
+        )
+    }
+}
+
 #[derive(Deserialize, Debug)]
 pub struct CloseSyncStream {
     /// Whether clients should hide the brief disconnected status from the public sync status and
@@ -1,5 +1,6 @@
 pub mod connector;
 pub mod coordinator;
+pub mod credentials;
 pub mod download;
 mod instruction;
 pub mod options;
@@ -9,17 +9,39 @@ pub struct SyncOptions {
     pub(crate) connector: Arc<dyn BackendConnector>,
     /// Whether to sync `auto_subscribe: true` streams automatically.
     pub(crate) include_default_streams: bool,
-    /// The retry delay between sync iterations on errors.
-    pub(crate) retry_delay: Duration,
+    /// Delays between sync iterations on errors.
+    pub(crate) reconnect: ReconnectPolicy,
+    /// Limits on how many received sync lines get applied in a single transaction.
+    pub(crate) download_batch: DownloadBatchLimits,
+    /// If set, the maximum amount of bytes to buffer when downloading sync lines ahead of applying
+    /// them.
+    pub(crate) pipelined_download: Option<usize>,
+    /// Whether to prepare write checkpoints while local writes are being uploaded.
+    pub(crate) pipelined_upload: bool,
+    /// The minimum time between published progress updates of the sync status.
+    pub(crate) status_update_interval: Duration,
 }
 
 impl SyncOptions {
     /// Creates new [SyncOptions] with default options given the [BackendConnector].
     pub fn new(connector: impl BackendConnector + 'static) -> Self {
+        Self::from_shared(Arc::new(connector))
+    }
+
+    /// Creates new [SyncOptions] with default options for a shared [BackendConnector].
+    ///
+    /// Options created with the same connector instance can be passed to
+    /// [crate::PowerSyncDatabase::connect] without restarting an active connection, since
+    /// connectors are compared by identity.
+    pub fn from_shared(connector: Arc<dyn BackendConnector>) -> Self {
         Self {
-            connector: Arc::new(connector),
+            connector,
             include_default_streams: true,
-            retry_delay: Duration::from_secs(5),
+            reconnect: ReconnectPolicy::default(),
+            download_batch: DownloadBatchLimits::default(),
+            pipelined_download: None,
+            pipelined_upload: false,
+            status_update_interval: Duration::ZERO,
         }
     }
 
@@ -30,8 +52,212 @@ impl SyncOptions {
         self.include_default_streams = include;
     }
 
-    /// Configures the delay after a failed sync iteration (the default is 5 seconds).
+    /// Configures a fixed delay after a failed sync iteration, without backoff or jitter.
+    ///
+    /// This is equivalent to [Self::with_reconnect_policy] with [ReconnectPolicy::fixed].
     pub fn with_retry_delay(&mut self, delay: Duration) {
-        self.retry_delay = delay;
+        self.reconnect = ReconnectPolicy::fixed(delay);
+    }
+
+    /// Configures delays between failed sync iterations and between uploads after errors.
+    ///
+    /// See [ReconnectPolicy] for details.
+    pub fn with_reconnect_policy(&mut self, policy: ReconnectPolicy) {
+        self.reconnect = policy;
+    }
+
+    /// Whether changing options from `self` to `other` requires restarting an active sync
+    /// iteration.
+    pub(crate) fn requires_reconnect(&self, other: &SyncOptions) -> bool {
+        !Arc::ptr_eq(&self.connector, &other.connector)
+            || self.include_default_streams != other.include_default_streams
+            || self.download_batch != other.download_batch
+            || self.pipelined_download != other.pipelined_download
+    }
+
+    /// Configures how many sync lines the client applies in a single transaction.
+    ///
+    /// See [DownloadBatchLimits] for details.
+    pub fn with_download_batch_limits(&mut self, limits: DownloadBatchLimits) {
+        self.download_batch = limits;
+    }
+
+    /// Enables pipelined downloads, in which sync lines are read from the network by a separate
+    /// task while previously received lines are being applied to the database.
+    ///
+    /// Up to `max_buffered_bytes` of sync lines are buffered ahead of the sync client. The amount
+    /// of lines currently buffered is reported in [crate::SyncStatusData::download_queue_depth].
+    /// This improves download rates on high-latency connections, where otherwise the network and
+    /// the database would take turns being idle.
+    pub fn with_pipelined_download(&mut self, max_buffered_bytes: usize) {
+        self.pipelined_download = Some(max_buffered_bytes);
+    }
+
+    /// Enables pipelined uploads, in which the SDK reads the next local transaction while
+    /// [BackendConnector::upload_data] is uploading the current one.
+    ///
+    /// Once the current transaction has been completed,
+    /// [crate::PowerSyncDatabase::next_crud_transaction] returns the prefetched transaction
+    /// without waiting for a reader connection. This only benefits connectors uploading one
+    /// transaction at a time, transactions are not prefetched for
+    /// [crate::PowerSyncDatabase::next_crud_batch].
+    ///
+    /// The write checkpoint requested after uploads is not pipelined, since the PowerSync service
+    /// must only create it once all local writes have been uploaded.
+    pub fn with_pipelined_upload(&mut self) {
+        self.pipelined_upload = true;
+    }
+
+    /// Merges progress updates of the sync status that are reported within `interval` of the
+    /// previous update, so that [crate::PowerSyncDatabase::watch_status] listeners wake up at most
+    /// once per interval while downloading.
+    ///
+    /// Changes to the connection state or the tracked streams are always reported immediately.
+    /// By default, every update is reported.
+    pub fn with_status_update_interval(&mut self, interval: Duration) {
+        self.status_update_interval = interval;
+    }
+}
+
+/// Controls how long clients wait before reconnecting after a failed sync iteration.
+///
+/// Delays start at [Self::initial_delay] and double after each consecutive failure, up to
+/// [Self::max_delay]. The counter is reset once a connection to the sync service has been
+/// established. To avoid many clients reconnecting at the same time (e.g. after the sync service
+/// restarted), each delay is reduced by a random fraction of up to [Self::jitter].
+///
+/// When the sync service closes an established connection without an error, clients reconnect
+/// immediately. If that connection also gets closed, the next reconnect is delayed.
+#[derive(Clone, Copy, Debug, PartialEq)]
+pub struct ReconnectPolicy {
+    /// The delay after the first failure.
+    pub initial_delay: Duration,
+    /// The maximum delay between attempts.
+    pub max_delay: Duration,
+    /// The maximum fraction (between `0.0` and `1.0`) by which delays are randomly shortened.
+    pub jitter: f64,
+}
+
+impl ReconnectPolicy {
+    /// A policy that always waits for `delay`, without backoff or jitter.
+    pub fn fixed(delay: Duration) -> Self {
+        Self {
+            initial_delay: delay,
+            max_delay: delay,
+            jitter: 0.0,
+        }
+    }
+
+    /// The delay to wait for after `failures` consecutive failed attempts (starting at `1`).
+    pub(crate) fn delay(&self, failures: u32) -> Duration {
+        let factor = 2u32.saturating_pow(failures.saturating_sub(1));
+        let delay = self
+            .initial_delay
+            .saturating_mul(factor)
+            .min(self.max_delay);
+
+        // The fields are public, so a NaN jitter is treated as no jitter instead of panicking.
+        let jitter = if self.jitter.is_nan() {
+            0.0
+        } else {
+            self.jitter.clamp(0.0, 1.0)
+        };
+        let factor = 1.0 - jitter * fastrand::f64();
+
+        // Converting through f64 can round above Duration::MAX for very large delays.
+        Duration::try_from_secs_f64(delay.as_secs_f64() * factor)
+            .unwrap_or(self.max_delay)
+            .min(delay)
+    }
+}
+
+impl Default for ReconnectPolicy {
+    fn default() -> Self {
+        Self {
+            initial_delay: Duration::from_secs(1),
+            max_delay: Duration::from_secs(60),
+            jitter: 0.5,
+        }
+    }
+}
+
+/// Limits for batching the application of sync lines.
+///
+/// When receiving a line from the sync service, the sync client takes the writer connection and
+/// also applies all further lines that have already been received in the same transaction. This
+/// avoids a commit per line during large downloads. These limits bound how large such a batch can
+/// get, so that local writes are not blocked on the writer connection for too long.
+///
+/// The client never waits for the network to fill a batch: Once no further line is immediately
+/// available, the batch is committed and the writer connection is released.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct DownloadBatchLimits {
+    /// The maximum amount of lines to apply in a single transaction.
+    ///
+    /// Setting this to `1` disables batching.
+    pub max_lines: usize,
+    /// The total size of lines, in bytes, after which no further lines are added to a batch.
+    pub max_bytes: usize,
+    /// The duration after which no further lines are added to a batch.
+    pub max_duration: Duration,
+}
+
+impl Default for DownloadBatchLimits {
+    fn default() -> Self {
+        Self {
+            max_lines: 1000,
+            max_bytes: 4 * 1024 * 1024,
+            max_duration: Duration::from_millis(100),
+        }
+    }
+}
+
+#[cfg(test)]
+mod test {
+    use std::time::Duration;
+
+    use super::ReconnectPolicy;
+
+    #[test]
+    fn exponential_backoff() {
+        let policy = ReconnectPolicy {
+            initial_delay: Duration::from_secs(1),
+            max_delay: Duration::from_secs(10),
+            jitter: 0.0,
+        };
+
+        assert_eq!(policy.delay(1), Duration::from_secs(1));
+        assert_eq!(policy.delay(2), Duration::from_secs(2));
+        assert_eq!(policy.delay(4), Duration::from_secs(8));
+        assert_eq!(policy.delay(5), Duration::from_secs(10));
+        assert_eq!(policy.delay(100), Duration::from_secs(10));
+    }
+
+    #[test]
+    fn jitter() {
+        let policy = ReconnectPolicy {
+            jitter: 0.5,
+            ..ReconnectPolicy::fixed(Duration::from_secs(10))
+        };
+
+        for _ in 0..100 {
+            let delay = policy.delay(1);
+            assert!(delay >= Duration::from_secs(5) && delay <= Duration::from_secs(10));
+        }
+    }
+
+    #[test]
+    fn invalid_policies() {
+        let policy = ReconnectPolicy {
+            jitter: f64::NAN,
+            ..ReconnectPolicy::fixed(Duration::from_secs(10))
+        };
+        assert_eq!(policy.delay(1), Duration::from_secs(10));
+
+        let policy = ReconnectPolicy {
+            jitter: 0.5,
+            ..ReconnectPolicy::fixed(Duration::MAX)
+        };
+        assert!(policy.delay(3) >= Duration::MAX / 2);
     }
 }
@@ -1,9 +1,15 @@
+use powersync_sqlite_nostd::ResultCode;
 use serde::{Deserialize, Serialize};
 
+use crate::{db::connection::SqliteConnection, error::PowerSyncError};
+
 /// Information about a progressing download.
 ///
 /// This reports the [Self::total] amount of operations to download, how many of them have already
 /// been [Self::downloaded] and finally a [Self::fraction] indicating relative progress.
+///
+/// Operations downloaded by an interrupted sync iteration count as downloaded when the next
+/// iteration resumes the download (see [PersistedDownload]).
 #[derive(Deserialize, Serialize, Debug, Clone)]
 pub struct ProgressCounters {
     /// How many operations need to be downloaded in total for the current donwload to complete.
@@ -25,4 +31,48 @@ impl ProgressCounters {
             _ => (self.downloaded as f32) / (self.total as f32),
         }
     }
+
+    /// The amount of operations that still need to be downloaded.
+    pub fn remaining(&self) -> i64 {
+        (self.total - self.downloaded).max(0)
+    }
+}
+
+/// Sync data that has been downloaded and stored locally, but not applied yet because its
+/// checkpoint hasn't completed.
+///
+/// The sync client commits downloaded lines after each batch (see [crate::DownloadBatchLimits]),
+/// together with the position of the last received operation in each bucket. When a download gets
+/// interrupted, e.g. because the app was closed or the connection dropped, the next sync iteration
+/// requests data after these positions instead of downloading buckets from scratch. This
+/// describes the part of an interrupted download that won't be downloaded again, see
+/// [crate::PowerSyncDatabase::persisted_download].
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct PersistedDownload {
+    /// The amount of buckets with downloaded operations that haven't been applied.
+    pub buckets: i64,
+    /// The amount of downloaded operations that haven't been applied.
+    pub operations: i64,
+}
+
+impl PersistedDownload {
+    pub(crate) fn read(conn: &SqliteConnection) -> Result<Self, PowerSyncError> {
+        let stmt = conn.prepare_cached(
+            "SELECT count(*), ifnull(sum(count_since_last), 0) FROM ps_buckets \
+            WHERE count_since_last > 0 AND name != '$local'",
+        )?;
+
+        match stmt.step()? {
+            ResultCode::ROW => Ok(Self {
+                buckets: stmt.column_int64(0),
+                operations: stmt.column_int64(1),
+            }),
+            code => Err(code.into()),
+        }
+    }
+
+    /// Whether no downloaded data is waiting for its checkpoint to complete.
+    pub fn is_empty(&self) -> bool {
+        self.operations == 0
+    }
 }
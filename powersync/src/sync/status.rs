@@ -1,9 +1,11 @@
 use std::{
     fmt::Debug,
+    pin::Pin,
     sync::{
         Arc, Mutex,
         atomic::{AtomicBool, Ordering},
     },
+    time::{Duration, Instant},
 };
 
 use event_listener::{Event, EventListener};
@@ -11,8 +13,10 @@ use powersync_sqlite_nostd::ResultCode;
 
 use crate::db::connection::SqliteConnection;
 use crate::{
+    env::Timer,
     error::PowerSyncError,
     sync::{
+        download::DownloadQueueDepth,
         instruction::{ActiveStreamSubscription, DownloadSyncStatus},
         progress::ProgressCounters,
         streams::{StreamDescription, StreamSubscriptionDescription},
@@ -51,6 +55,113 @@ impl SyncStatus {
     }
 }
 
+/// Status updates of a sync iteration, which are merged if they only report progress and arrive
+/// faster than a configured interval (see [crate::SyncOptions::with_status_update_interval]).
+///
+/// During large downloads, the core extension reports progress after every batch of sync lines.
+/// Publishing each of these would wake all [crate::PowerSyncDatabase::watch_status] listeners
+/// every time. Updates changing the connection state or the tracked streams (including a stream
+/// becoming active or synced) are always published immediately, along with progress updates held
+/// back before them.
+pub(crate) struct CoalescedStatusUpdates {
+    interval: Duration,
+    last_published: Option<Instant>,
+    /// The last published core status, see [Self::is_transition].
+    published_core: Option<Arc<DownloadSyncStatus>>,
+    pending_core: Option<DownloadSyncStatus>,
+    pending_queue_depth: Option<DownloadQueueDepth>,
+}
+
+impl CoalescedStatusUpdates {
+    pub fn new(interval: Duration) -> Self {
+        Self {
+            interval,
+            last_published: None,
+            published_core: None,
+            pending_core: None,
+            pending_queue_depth: None,
+        }
+    }
+
+    /// Publishes a status update from the core extension (if any) and the current queue depth,
+    /// or holds them back until the current interval has passed.
+    pub fn update(
+        &mut self,
+        status: &SyncStatus,
+        core: Option<DownloadSyncStatus>,
+        queue_depth: DownloadQueueDepth,
+    ) {
+        let transition = core.as_ref().is_some_and(|core| self.is_transition(core));
+        if core.is_some() {
+            self.pending_core = core;
+        }
+        self.pending_queue_depth = Some(queue_depth);
+
+        let interval_elapsed = self
+            .last_published
+            .is_none_or(|last| last.elapsed() >= self.interval);
+        if transition || interval_elapsed {
+            self.flush(status);
+        }
+    }
+
+    /// Publishes held back updates, if there are any.
+    pub fn flush(&mut self, status: &SyncStatus) {
+        let core = self.pending_core.take().map(Arc::new);
+        let queue_depth = self.pending_queue_depth.take();
+        if core.is_none() && queue_depth.is_none() {
+            return;
+        }
+
+        if let Some(core) = &core {
+            self.published_core = Some(core.clone());
+        }
+        self.last_published = Some(Instant::now());
+
+        status.update(|data| {
+            if let Some(core) = core {
+                data.update_from_core(core);
+            }
+            if let Some(depth) = queue_depth {
+                data.set_download_queue_depth(depth);
+            }
+        });
+    }
+
+    /// Returns a future completing when held back updates should be published, or [None] if
+    /// there are no pending updates.
+    pub fn flush_deadline(
+        &self,
+        timer: &(dyn Timer + Send + Sync),
+    ) -> Option<Pin<Box<dyn Future<Output = ()> + Send>>> {
+        if self.pending_core.is_none() && self.pending_queue_depth.is_none() {
+            return None;
+        }
+
+        let elapsed = self.last_published.map(|last| last.elapsed());
+        let remaining = elapsed.map_or(Duration::ZERO, |e| self.interval.saturating_sub(e));
+        Some(timer.delay_once(remaining))
+    }
+
+    /// Whether `core` changes parts of the status that are published without delay, compared to
+    /// the last published status. Everything else (i.e. download progress) can be held back.
+    fn is_transition(&self, core: &DownloadSyncStatus) -> bool {
+        let Some(published) = &self.published_core else {
+            return true;
+        };
+
+        published.connected != core.connected
+            || published.connecting != core.connecting
+            || published.downloading.is_some() != core.downloading.is_some()
+            || published.streams.len() != core.streams.len()
+            || published.streams.iter().zip(&core.streams).any(|(a, b)| {
+                a.name != b.name
+                    || a.active != b.active
+                    || a.last_synced_at.map(|t| t.0) != b.last_synced_at.map(|t| t.0)
+            })
+    }
+}
+
 #[derive(Debug, Default)]
 pub enum UploadStatus {
     #[default]
@@ -64,6 +175,7 @@ pub struct SyncStatusData {
     downloading: Arc<DownloadSyncStatus>,
     download_error: Option<PowerSyncError>,
     uploads: UploadStatus,
+    download_queue: DownloadQueueDepth,
 
     /// Raised when a new instance is installed in [SyncStatus].
     is_invalidated: AtomicBool,
@@ -77,6 +189,7 @@ impl SyncStatusData {
             downloading: self.downloading.clone(),
             download_error: self.download_error.clone(),
             uploads: Default::default(),
+            download_queue: self.download_queue,
             is_invalidated: Default::default(),
             invalidated: Default::default(),
         }
@@ -109,6 +222,13 @@ impl SyncStatusData {
         }
     }
 
+    /// The amount of sync lines that have been downloaded but not yet applied to the database.
+    ///
+    /// This is always empty unless [crate::SyncOptions::with_pipelined_download] is enabled.
+    pub fn download_queue_depth(&self) -> DownloadQueueDepth {
+        self.download_queue
+    }
+
     /// Status information for a stream, if it's a stream that is currently tracked by the sync
     /// client.
     pub fn for_stream<'a, 'b>(
@@ -179,12 +299,16 @@ impl SyncStatusData {
         };
 
         let raw_status = stmt.column_text(0)?;
-        self.update_from_core(serde_json::from_str(raw_status)?);
+        self.update_from_core(Arc::new(serde_json::from_str(raw_status)?));
         Ok(())
     }
 
-    pub(crate) fn update_from_core(&mut self, core: DownloadSyncStatus) {
-        self.downloading = Arc::new(core);
+    pub(crate) fn update_from_core(&mut self, core: Arc<DownloadSyncStatus>) {
+        self.downloading = core;
+    }
+
+    pub(crate) fn set_download_queue_depth(&mut self, depth: DownloadQueueDepth) {
+        self.download_queue = depth;
     }
 
     pub(crate) fn set_download_error(&mut self, e: PowerSyncError) {
@@ -207,6 +331,7 @@ impl Debug for SyncStatusData {
             .field("downloading", &self.downloading)
             .field("download_error", &self.download_error)
             .field("uploads", &self.uploads)
+            .field("download_queue", &self.download_queue)
             .finish()
     }
 }
@@ -215,3 +340,84 @@ pub struct SyncStreamStatus<'a> {
     pub progress: Option<ProgressCounters>,
     pub subscription: StreamSubscriptionDescription<'a>,
 }
+
+#[cfg(test)]
+mod test {
+    use std::time::Duration;
+
+    use super::{CoalescedStatusUpdates, SyncStatus};
+    use crate::sync::{download::DownloadQueueDepth, instruction::DownloadSyncStatus};
+
+    fn downloading(connected: bool) -> DownloadSyncStatus {
+        serde_json::from_str(&format!(
+            r#"{{"connected":{connected},"connecting":false,"streams":[],"downloading":{{}}}}"#
+        ))
+        .unwrap()
+    }
+
+    fn depth(lines: usize) -> DownloadQueueDepth {
+        DownloadQueueDepth { lines, bytes: 0 }
+    }
+
+    #[test]
+    fn coalesces_progress_updates() {
+        let status = SyncStatus::new();
+        let mut updates = CoalescedStatusUpdates::new(Duration::from_secs(3600));
+
+        updates.update(&status, Some(downloading(true)), depth(1));
+        let first = status.current_snapshot();
+        assert_eq!(first.download_queue_depth().lines, 1);
+
+        // Progress within the interval is held back.
+        updates.update(&status, Some(downloading(true)), depth(2));
+        updates.update(&status, None, depth(3));
+        assert!(first.listen_for_changes().is_some());
+
+        updates.flush(&status);
+        assert!(first.listen_for_changes().is_none());
+        assert_eq!(status.current_snapshot().download_queue_depth().lines, 3);
+    }
+
+    #[test]
+    fn publishes_transitions_immediately() {
+        let status = SyncStatus::new();
+        let mut updates = CoalescedStatusUpdates::new(Duration::from_secs(3600));
+
+        updates.update(&status, Some(downloading(true)), depth(0));
+        updates.update(&status, Some(downloading(false)), depth(0));
+        assert!(!status.current_snapshot().is_connected());
+    }
+
+    #[test]
+    fn publishes_synced_streams_immediately() {
+        let stream = |last_synced_at: &str| -> DownloadSyncStatus {
+            serde_json::from_str(&format!(
+                r#"{{"connected":true,"connecting":false,"downloading":{{}},"streams":[{{
+                    "name":"a","parameters":null,"active":true,"is_default":true,
+                    "has_explicit_subscription":false,"expires_at":null,
+                    "last_synced_at":{last_synced_at},"progress":{{"total":10,"downloaded":10}}
+                }}]}}"#
+            ))
+            .unwrap()
+        };
+
+        let status = SyncStatus::new();
+        let mut updates = CoalescedStatusUpdates::new(Duration::from_secs(3600));
+        updates.update(&status, Some(stream("null")), depth(0));
+        let before = status.current_snapshot();
+
+        // A partial checkpoint completing for the stream is not held back.
+        updates.update(&status, Some(stream("1700000000")), depth(0));
+        assert!(before.listen_for_changes().is_none());
+    }
+
+    #[test]
+    fn publishes_all_updates_without_interval() {
+        let status = SyncStatus::new();
+        let mut updates = CoalescedStatusUpdates::new(Duration::ZERO);
+
+        updates.update(&status, Some(downloading(true)), depth(1));
+        updates.update(&status, None, depth(2));
+        assert_eq!(status.current_snapshot().download_queue_depth().lines, 2);
+    }
+}
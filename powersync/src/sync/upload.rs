@@ -1,4 +1,4 @@
-use std::{collections::HashSet, sync::Arc};
+use std::{collections::HashSet, sync::Arc, time::Instant};
 
 use futures_lite::{
     FutureExt, StreamExt,
@@ -8,6 +8,7 @@ use log::{debug, info, warn};
 use powersync_sqlite_nostd::{Destructor, ResultCode};
 
 use crate::db::connection::{SqliteConnection, TransactionGuard};
+use crate::db::crud::CrudPrefetch;
 use crate::db::watch::ListenerConfiguration;
 use crate::sync::coordinator::SyncCoordinator;
 use crate::{
@@ -21,7 +22,7 @@ use crate::{
 };
 
 pub enum UploadActorCommand {
-    Connect(Arc<dyn BackendConnector>),
+    Connect(UploadOptions),
     TriggerCrudUpload,
     Disconnect,
 }
@@ -51,7 +52,7 @@ impl UploadActor {
 
     fn connected_state(
         db: &Arc<InnerPowerSyncState>,
-        connector: Arc<dyn BackendConnector>,
+        options: UploadOptions,
     ) -> ConnectedUploadActor {
         let mut tables = HashSet::new();
         tables.insert("ps_crud".to_string());
@@ -62,7 +63,8 @@ impl UploadActor {
             .update_notifiers()
             .listen(ListenerConfiguration::if_matches(tables, false));
         ConnectedUploadActor {
-            connector,
+            options,
+            failures: 0,
             crud_stream: stream.map(|_| ()).boxed(),
         }
     }
@@ -77,10 +79,10 @@ impl UploadActor {
                     // Already in progress, don't start another.
                     None
                 }
-                UploadActorCommand::Connect(connector) => {
+                UploadActorCommand::Connect(options) => {
                     // TODO: Only abort if the connector has changed?
                     Some(UploadActorState::Connected(Self::connected_state(
-                        db, connector,
+                        db, options,
                     )))
                 }
                 UploadActorCommand::Disconnect => Some(UploadActorState::Idle),
@@ -104,9 +106,9 @@ impl UploadActor {
                 };
 
                 match command.command {
-                    UploadActorCommand::Connect(connector) => {
+                    UploadActorCommand::Connect(options) => {
                         let _ = command.response.send(());
-                        UploadActorState::Connected(Self::connected_state(&self.db, connector))
+                        UploadActorState::Connected(Self::connected_state(&self.db, options))
                     }
                     UploadActorCommand::TriggerCrudUpload => {
                         // We can't upload because we're not connector
@@ -138,8 +140,8 @@ impl UploadActor {
                     let _ = command.response.send(());
 
                     match command.command {
-                        UploadActorCommand::Connect(connector) => Transition::Abort(
-                            UploadActorState::Connected(Self::connected_state(&self.db, connector)),
+                        UploadActorCommand::Connect(options) => Transition::Abort(
+                            UploadActorState::Connected(Self::connected_state(&self.db, options)),
                         ),
                         UploadActorCommand::TriggerCrudUpload => Transition::StartUpload,
                         UploadActorCommand::Disconnect => Transition::Abort(UploadActorState::Idle),
@@ -159,10 +161,12 @@ impl UploadActor {
                     Self::state_transition_from_command_while_uploading(&self.commands, &self.db);
 
                 let upload_done = async {
-                    let (result, state) = result.await;
+                    let (result, mut state) = result.await;
 
                     match result {
                         Ok(_) => {
+                            state.failures = 0;
+
                             // It's possible that pending CRUD uploads were preventing data from
                             // syncing. So now that that's completed, notify the download client in
                             // case it needs to retry.
@@ -176,6 +180,7 @@ impl UploadActor {
                         }
                         Err(e) => {
                             warn!("CRUD uploads failed, will retry, {e}");
+                            state.failures += 1;
                             self.db
                                 .status
                                 .update(|s| s.set_upload_state(UploadStatus::Error(e)));
@@ -183,7 +188,7 @@ impl UploadActor {
 
                             Some(UploadActorState::WaitingForReconnect {
                                 timeout: async move {
-                                    db.sync_iteration_delay().await;
+                                    db.sync_iteration_delay(state.failures).await;
                                     state
                                 }
                                 .boxed(),
@@ -220,7 +225,8 @@ impl UploadActor {
         UploadActorState::RunningUpload {
             result: async move {
                 let mut upload = CrudUpload {
-                    connector: state.connector.as_ref(),
+                    connector: state.options.connector.as_ref(),
+                    pipelined: state.options.pipelined,
                     db,
                 };
                 let result = upload.run().await;
@@ -250,15 +256,26 @@ impl UploadActorState {
     }
 }
 
-struct ConnectedUploadActor {
+/// Options for the upload actor, derived from the [crate::SyncOptions] passed when connecting.
+pub struct UploadOptions {
     /// The connector to use when uploading changes.
-    connector: Arc<dyn BackendConnector>,
+    pub connector: Arc<dyn BackendConnector>,
+    /// Whether to read the next transaction while the connector is uploading changes, see
+    /// [crate::SyncOptions::with_pipelined_upload].
+    pub pipelined: bool,
+}
+
+struct ConnectedUploadActor {
+    options: UploadOptions,
+    /// The amount of consecutive failed uploads, used to back off retries.
+    failures: u32,
     /// A stream emitting changes when the `ps_crud` table is updated locally.
     crud_stream: futures_lite::stream::Boxed<()>,
 }
 
 struct CrudUpload<'a> {
     connector: &'a dyn BackendConnector,
+    pipelined: bool,
     db: Arc<InnerPowerSyncState>,
 }
 
@@ -278,43 +295,87 @@ impl<'a> CrudUpload<'a> {
             self.db
                 .status
                 .update(|data| data.set_upload_state(UploadStatus::Uploading));
-            self.connector.upload_data().await?;
+
+            if self.pipelined {
+                // The prefetch is polled first, so that it reads the transaction following the
+                // one the connector is about to upload.
+                let ((), upload) =
+                    future::zip(self.prefetch_next_transaction(), self.upload_data()).await;
+                upload?;
+            } else {
+                self.upload_data().await?;
+            }
         }
 
-        // Uploading is completed, advance write checkpoint.
+        // Uploading is completed, advance write checkpoint. Note that this must only be checked
+        // after uploads, since completing CRUD transactions resets the target of the `$local`
+        // bucket.
         if let Some(advance_target) = self.sequence_for_checkpoint().await? {
-            let write_checkpoint = self.get_write_checkpoint().await?;
+            let client_id = self.client_id().await?;
+            let credentials = self.db.credentials.get(self.connector).await?;
+            let write_checkpoint = write_checkpoint(&self.db, &client_id, credentials).await?;
             advance_target.complete(write_checkpoint, &self.db).await?;
         }
 
         Ok(())
     }
 
-    async fn oldest_crud_item_id(&self) -> Result<Option<i64>, PowerSyncError> {
-        let reader = self.db.reader().await?;
-        Self::read_oldest_crud_item_id(reader.sqlite_connection())
+    /// Calls [BackendConnector::upload_data], reporting its duration to the metrics observer of
+    /// the database.
+    async fn upload_data(&self) -> Result<(), PowerSyncError> {
+        let Some(metrics) = self.db.env.metrics() else {
+            return self.connector.upload_data().await;
+        };
+
+        let started = Instant::now();
+        let result = self.connector.upload_data().await;
+        metrics.upload_completed(result.is_ok(), started.elapsed());
+        result
     }
 
-    async fn get_write_checkpoint(&self) -> Result<i64, PowerSyncError> {
-        let client_id = {
-            let reader = self.db.reader().await?;
+    async fn oldest_crud_item_id(&self) -> Result<Option<i64>, PowerSyncError> {
+        self.db
+            .read_blocking(|reader| {
+                CrudUpload::read_oldest_crud_item_id(reader.sqlite_connection())
+            })
+            .await
+    }
 
-            let stmt = reader
-                .sqlite_connection()
-                .prepare("SELECT powersync_client_id()")?;
-            let ResultCode::ROW = stmt.step()? else {
-                panic!("Expected row"); // Can't happen, scalar select
-            };
+    /// Reads the transaction following the oldest one into the [CrudPrefetch] of the database,
+    /// so that the connector doesn't have to wait for a reader when asking for it.
+    ///
+    /// Errors are only logged, since the connector reads the transaction again if it hasn't been
+    /// prefetched.
+    async fn prefetch_next_transaction(&self) {
+        match self
+            .db
+            .read_blocking(|reader| CrudPrefetch::read(reader.sqlite_connection()))
+            .await
+        {
+            Ok(Some(transaction)) => self.db.crud_prefetch.store(transaction),
+            Ok(None) => {}
+            Err(e) => warn!("Could not prefetch next CRUD transaction: {e}"),
+        }
+    }
 
-            stmt.column_text(0)?.to_string()
-        };
+    /// Resolves the client id used to request a write checkpoint.
+    async fn client_id(&self) -> Result<String, PowerSyncError> {
+        self.db
+            .read_blocking(|reader| {
+                let stmt = reader
+                    .sqlite_connection()
+                    .prepare_cached("SELECT powersync_client_id()")?;
+                let ResultCode::ROW = stmt.step()? else {
+                    panic!("Expected row"); // Can't happen, scalar select
+                };
 
-        let credentials = self.connector.fetch_credentials().await?;
-        write_checkpoint(&self.db, &client_id, credentials).await
+                Ok(stmt.column_text(0)?.to_string())
+            })
+            .await
     }
 
     fn read_oldest_crud_item_id(conn: &SqliteConnection) -> Result<Option<i64>, PowerSyncError> {
-        let stmt = conn.prepare("SELECT id FROM ps_crud ORDER BY id LIMIT 1")?;
+        let stmt = conn.prepare_cached("SELECT id FROM ps_crud ORDER BY id LIMIT 1")?;
 
         Ok(match stmt.step()? {
             ResultCode::ROW => Some(stmt.column_int64(0)),
@@ -323,7 +384,8 @@ impl<'a> CrudUpload<'a> {
     }
 
     fn ps_crud_sequence(conn: &SqliteConnection) -> Result<Option<i64>, PowerSyncError> {
-        let seq_before = conn.prepare("SELECT seq FROM main.sqlite_sequence WHERE name = ?")?;
+        let seq_before =
+            conn.prepare_cached("SELECT seq FROM main.sqlite_sequence WHERE name = ?")?;
         seq_before.bind_text(1, "ps_crud", Destructor::STATIC)?;
 
         let ResultCode::ROW = seq_before.step()? else {
@@ -336,24 +398,28 @@ impl<'a> CrudUpload<'a> {
     async fn sequence_for_checkpoint(
         &self,
     ) -> Result<Option<PendingCheckpointRequest>, PowerSyncError> {
-        let reader = self.db.reader().await?;
-        let reader = reader.sqlite_connection();
-        {
-            let stmt =
-                reader.prepare("SELECT 1 FROM ps_buckets WHERE name = ? AND target_op = ?")?;
-            stmt.bind_text(1, "$local", Destructor::STATIC)?;
-            stmt.bind_int64(2, MAX_OP_ID)?;
-
-            let ResultCode::ROW = stmt.step()? else {
-                // Nothing to update.
-                return Ok(None);
-            };
-        }
+        self.db
+            .read_blocking(|reader| {
+                let reader = reader.sqlite_connection();
+                {
+                    let stmt = reader.prepare_cached(
+                        "SELECT 1 FROM ps_buckets WHERE name = ? AND target_op = ?",
+                    )?;
+                    stmt.bind_text(1, "$local", Destructor::STATIC)?;
+                    stmt.bind_int64(2, MAX_OP_ID)?;
+
+                    let ResultCode::ROW = stmt.step()? else {
+                        // Nothing to update.
+                        return Ok(None);
+                    };
+                }
 
-        let seq_before = Self::ps_crud_sequence(reader)?;
-        Ok(seq_before.map(|seq_before| PendingCheckpointRequest {
-            crud_sequence: seq_before,
-        }))
+                let seq_before = CrudUpload::ps_crud_sequence(reader)?;
+                Ok(seq_before.map(|seq_before| PendingCheckpointRequest {
+                    crud_sequence: seq_before,
+                }))
+            })
+            .await
     }
 
     const DUPLICATE_ITEM_WARNING: &'static str = "
@@ -375,28 +441,28 @@ impl PendingCheckpointRequest {
     ) -> Result<(), PowerSyncError> {
         info!("Updating target to checkpoint {}", self.crud_sequence);
 
-        let mut writer = db.writer().await?;
-        let writer = TransactionGuard::new(writer.sqlite_connection_mut())?;
+        db.write_blocking(move |writer| {
+            let writer = TransactionGuard::new(writer.sqlite_connection_mut())?;
 
-        if CrudUpload::read_oldest_crud_item_id(writer.inner)?.is_some() {
-            warn!("ps_crud is not empty, won't advance target");
-            return Ok(());
-        }
-
-        let seq_after = CrudUpload::ps_crud_sequence(writer.inner)?
-            .expect("sqlite sequence should not be empty");
+            if CrudUpload::read_oldest_crud_item_id(writer.inner)?.is_some() {
+                warn!("ps_crud is not empty, won't advance target");
+                return Ok(());
+            }
 
-        if seq_after != self.crud_sequence {
-            debug!(
-                "Sequence on ps_crud changed while fetching checkpoint. From {} to {}",
-                self.crud_sequence, seq_after
-            );
-            return Ok(());
-        }
+            let seq_after = CrudUpload::ps_crud_sequence(writer.inner)?
+                .expect("sqlite sequence should not be empty");
 
-        InnerPowerSyncState::set_local_target_op(writer.inner, op_id)?;
+            if seq_after != self.crud_sequence {
+                debug!(
+                    "Sequence on ps_crud changed while fetching checkpoint. From {} to {}",
+                    self.crud_sequence, seq_after
+                );
+                return Ok(());
+            }
 
-        writer.commit()?;
-        Ok(())
+            InnerPowerSyncState::set_local_target_op(writer.inner, op_id)?;
+            writer.commit()
+        })
+        .await
     }
 }
@@ -0,0 +1,101 @@
+use std::panic::{AssertUnwindSafe, catch_unwind, resume_unwind};
+use std::thread;
+
+use async_channel::{Receiver, Sender};
+use async_oneshot::oneshot;
+
+type Job = Box<dyn FnOnce() + Send>;
+
+/// A pool of dedicated OS threads running SQLite work submitted by the SDK.
+///
+/// By default, the SDK runs queries inline in the futures polling them. Since SQLite calls are
+/// blocking, applying large sync checkpoints or reading many local writes for uploads then
+/// occupies a thread of the async runtime. When a pool is configured with
+/// [crate::env::PowerSyncEnvironment::with_blocking_pool], connections leased asynchronously are
+/// moved to one of its threads for the duration of these queries instead. This applies to sync
+/// lines, reading and completing CRUD transactions and batches, and the queries the upload actor
+/// runs to request write checkpoints.
+///
+/// Only the SDK's own work is offloaded. Connections obtained through
+/// [crate::PowerSyncDatabase::reader] or [crate::PowerSyncDatabase::writer] are unaffected, and
+/// watched queries run inline since the functions mapping their results receive borrowed
+/// statements.
+///
+/// The pool doesn't depend on an async runtime. Its threads exit once all clones of the pool
+/// have been dropped.
+#[derive(Clone)]
+pub struct BlockingPool {
+    jobs: Sender<Job>,
+}
+
+impl BlockingPool {
+    /// Starts a pool with the given amount of threads, at least one.
+    pub fn new(threads: usize) -> Self {
+        let (jobs, receive) = async_channel::unbounded::<Job>();
+        for i in 0..threads.max(1) {
+            let receive = receive.clone();
+
+            thread::Builder::new()
+                .name(format!("powersync-blocking-{i}"))
+                .spawn(move || Self::worker(receive))
+                .expect("should spawn blocking thread");
+        }
+
+        Self { jobs }
+    }
+
+    fn worker(jobs: Receiver<Job>) {
+        while let Ok(job) = jobs.recv_blocking() {
+            job();
+        }
+    }
+
+    /// Runs `work` on a thread of the pool, completing with its result.
+    ///
+    /// If `work` panics, the panic is resumed on the thread polling the returned future. When the
+    /// future is dropped before completing, `work` still runs to completion and its result (e.g.
+    /// a connection lease moved into it) is dropped on the pool thread.
+    pub(crate) async fn run<R: Send + 'static>(
+        &self,
+        work: impl FnOnce() -> R + Send + 'static,
+    ) -> R {
+        let (mut send, receive) = oneshot();
+        let job: Job = Box::new(move || {
+            let _ = send.send(catch_unwind(AssertUnwindSafe(work)));
+        });
+
+        self.jobs
+            .try_send(job)
+            .expect("blocking pool should accept jobs while referenced");
+
+        match receive.await.expect("blocking pool should complete jobs") {
+            Ok(result) => result,
+            Err(panic) => resume_unwind(panic),
+        }
+    }
+}
+
+#[cfg(test)]
+mod test {
+    use std::thread;
+
+    use futures_lite::future;
+
+    use super::BlockingPool;
+
+    #[test]
+    fn runs_on_pool_thread() {
+        let pool = BlockingPool::new(2);
+        let caller = thread::current().id();
+
+        let worker = future::block_on(pool.run(|| thread::current().id()));
+        assert_ne!(worker, caller);
+    }
+
+    #[test]
+    #[should_panic(expected = "failed job")]
+    fn resumes_panics() {
+        let pool = BlockingPool::new(1);
+        future::block_on(pool.run(|| panic!("failed job")));
+    }
+}
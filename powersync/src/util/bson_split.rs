@@ -1,6 +1,6 @@
 use crate::error::{RawPowerSyncError, Result};
 use crate::http::ResponseStream;
-use bytes::Bytes;
+use bytes::{Buf, Bytes, BytesMut};
 use futures_lite::{Stream, StreamExt, ready};
 use std::{
     cmp::min,
@@ -8,166 +8,151 @@ use std::{
     task::{Context, Poll},
 };
 
-/// A [Stream] implementation splitting an underlying [AsyncBufRead] instance into unparsed BSON
-/// objects by extracting frame information from the length prefix.
+/// A [Stream] implementation splitting an underlying [ResponseStream] into unparsed BSON objects
+/// by extracting frame information from the length prefix.
+///
+/// Frames that are fully contained in a chunk of the underlying stream are emitted as slices of
+/// that chunk without copying. Only frames spanning multiple chunks are reassembled into a buffer,
+/// which is sized with the length header of that frame.
 pub struct BsonObjects {
-    stream: ResponseStream,
-    buf: Vec<u8>,
-    remaining: RemainingBytes,
-    current_event: Option<Bytes>,
+    stream: Option<ResponseStream>,
+    /// The bytes of a frame spanning multiple chunks that have been received so far.
+    partial: BytesMut,
+    /// The total size of the frame in [Self::partial], once its length header is known.
+    partial_size: Option<usize>,
+    /// The remainder of the last chunk received from [Self::stream].
+    current_chunk: Option<Bytes>,
 }
 
 impl BsonObjects {
-    /// Creates a [BsonObjects] stream from a source reader [R].
+    /// Creates a [BsonObjects] stream from a source [ResponseStream].
     pub fn new(stream: ResponseStream) -> Self {
         Self {
-            stream,
-            buf: Vec::new(),
-            remaining: RemainingBytes::default(),
-            current_event: None,
+            stream: Some(stream),
+            partial: BytesMut::new(),
+            partial_size: None,
+            current_chunk: None,
         }
     }
 
-    fn process_bytes(
-        target: &mut Vec<u8>,
-        remaining: &mut RemainingBytes,
-        mut buf: &[u8],
-    ) -> (Poll<Option<Result<Vec<u8>>>>, usize) {
-        if buf.is_empty() {
-            // End of stream. This is an error if we were in the middle of reading an object.
-            return if remaining.is_at_object_boundary() {
-                (Poll::Ready(None), 0)
-            } else {
-                (
-                    Poll::Ready(Some(Err(RawPowerSyncError::SyncServiceResponseParsing {
-                        desc: "stream ended in object",
-                    }
-                    .into()))),
-                    0,
-                )
+    /// Reads the total size of a frame from its length header.
+    fn frame_size(header: &[u8]) -> Result<usize> {
+        // Each BSON object starts with a little-endian 32-bit integer describing its size.
+        let size = i32::from_le_bytes(header[0..4].try_into().unwrap());
+        if size < 5 {
+            // At the very least we need the 4 byte length and a zero terminator.
+            Err(RawPowerSyncError::SyncServiceResponseParsing {
+                desc: "Invalid length header for BSON",
+            }
+            .into())
+        } else {
+            Ok(size as usize)
+        }
+    }
+
+    /// Consumes bytes from the `chunk` until a frame is complete.
+    ///
+    /// Returns [None] if the chunk has been consumed entirely without completing a frame.
+    fn next_frame(&mut self, chunk: &mut Bytes) -> Option<Result<Bytes>> {
+        if self.partial.is_empty() && chunk.len() >= 4 {
+            let size = match Self::frame_size(chunk) {
+                Ok(size) => size,
+                Err(e) => return Some(Err(e)),
             };
+
+            if chunk.len() >= size {
+                // The frame is fully contained in this chunk, so we can emit it without a copy.
+                return Some(Ok(chunk.split_to(size)));
+            }
+
+            // The frame continues in the next chunk, so we have to buffer it.
+            self.partial.reserve(size);
+            self.partial_size = Some(size);
         }
 
-        let mut consumed = 0usize;
-        let result = loop {
-            let (read, switch_state) = remaining.consume(buf.len());
-            let (taken, remaining_buf) = buf.split_at(read);
-
-            target.extend_from_slice(taken);
-            buf = remaining_buf;
-            consumed += read;
-
-            break if !switch_state {
-                // We need more bytes to complete the pending object or size header.
-                Poll::Pending
-            } else {
-                match remaining.clone() {
-                    RemainingBytes::ForSize(_) => {
-                        // Done reading size => transition to reading object. Each BSON object
-                        // starts with a little-endian 32-bit integer describing its size.
-                        assert_eq!(target.len(), 4);
-
-                        let size = i32::from_le_bytes(target[0..4].try_into().unwrap());
-                        if size < 5 {
-                            // At the very least we need the 4 byte length and a zero terminator.
-                            Poll::Ready(Some(Err(RawPowerSyncError::SyncServiceResponseParsing {
-                                desc: "Invalid length header for BSON",
-                            }
-                            .into())))
-                        } else {
-                            // Length is the total size of the frame, including the 4 byte length header
-                            *remaining = RemainingBytes::ForObject(size as usize - 4);
-                            continue;
-                        }
-                    }
-                    RemainingBytes::ForObject(_) => {
-                        // Done reading the object => emit.
-                        *remaining = RemainingBytes::default();
-                        let buf = std::mem::take(target);
-                        Poll::Ready(Some(Ok(buf)))
-                    }
+        let size = match self.partial_size {
+            Some(size) => size,
+            None => {
+                // We don't know the size of this frame yet, so start by reading the header.
+                let read = min(4 - self.partial.len(), chunk.len());
+                self.partial.extend_from_slice(&chunk[..read]);
+                chunk.advance(read);
+                if self.partial.len() < 4 {
+                    return None;
                 }
-            };
+
+                let size = match Self::frame_size(&self.partial) {
+                    Ok(size) => size,
+                    Err(e) => return Some(Err(e)),
+                };
+                self.partial.reserve(size - 4);
+                self.partial_size = Some(size);
+                size
+            }
         };
 
-        (result, consumed)
+        let read = min(size - self.partial.len(), chunk.len());
+        self.partial.extend_from_slice(&chunk[..read]);
+        chunk.advance(read);
+
+        if self.partial.len() == size {
+            self.partial_size = None;
+            Some(Ok(self.partial.split().freeze()))
+        } else {
+            None
+        }
     }
 }
 
 impl Stream for BsonObjects {
-    type Item = Result<Vec<u8>>;
+    type Item = Result<Bytes>;
 
     fn poll_next(mut self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<Option<Self::Item>> {
         let this: &mut BsonObjects = &mut self;
 
         loop {
             // First, try to process a buffer we've consumed before.
-            while let Some(pending) = &mut this.current_event {
-                let (result, consumed_bytes) =
-                    Self::process_bytes(&mut this.buf, &mut this.remaining, pending);
-                if pending.len() == consumed_bytes {
-                    this.current_event = None;
-                } else {
-                    // current_event = current_event[consumed_bytes..]
-                    drop(pending.split_to(consumed_bytes));
+            if let Some(mut chunk) = this.current_chunk.take() {
+                let frame = this.next_frame(&mut chunk);
+                if !chunk.is_empty() {
+                    this.current_chunk = Some(chunk);
                 }
 
-                if result.is_ready() {
-                    return result;
+                if let Some(frame) = frame {
+                    return Poll::Ready(Some(frame));
                 }
             }
 
-            let buf = match ready!(this.stream.poll_next(cx)) {
-                Some(event) => match event {
-                    Ok(buf) => buf,
-                    Err(e) => return Poll::Ready(Some(Err(e))),
-                },
+            let Some(stream) = &mut this.stream else {
+                return Poll::Ready(None);
+            };
+
+            match ready!(stream.poll_next(cx)) {
+                Some(Ok(chunk)) => {
+                    if !chunk.is_empty() {
+                        this.current_chunk = Some(chunk);
+                    }
+                }
+                Some(Err(e)) => return Poll::Ready(Some(Err(e))),
                 None => {
-                    // End of stream, which we represent by reading an empty buffer.
-                    Bytes::new()
+                    this.stream = None;
+
+                    // End of stream. This is an error if we were in the middle of reading an
+                    // object.
+                    return Poll::Ready(if this.partial.is_empty() {
+                        None
+                    } else {
+                        Some(Err(RawPowerSyncError::SyncServiceResponseParsing {
+                            desc: "stream ended in object",
+                        }
+                        .into()))
+                    });
                 }
             };
-            this.current_event = Some(buf);
         }
     }
 }
 
-#[derive(Clone)]
-pub enum RemainingBytes {
-    /// The stream is currently reading the size of the next BSON object.
-    ///
-    /// The attached value is the amount of bytes remaining in the length, never more than 4.
-    ForSize(usize),
-    /// The stream is currently reading the contents of a BSON object.
-    ///
-    /// The attached value is the amount of bytes remaining in the object, including the trailing
-    /// zero byte.
-    ForObject(usize),
-}
-
-impl RemainingBytes {
-    pub fn consume(&mut self, max: usize) -> (usize, bool) {
-        let remaining = match self {
-            RemainingBytes::ForSize(size) => size,
-            RemainingBytes::ForObject(size) => size,
-        };
-        let readable = min(*remaining, max);
-        *remaining -= readable;
-
-        (readable, *remaining == 0)
-    }
-
-    pub fn is_at_object_boundary(&self) -> bool {
-        matches!(self, RemainingBytes::ForSize(4))
-    }
-}
-
-impl Default for RemainingBytes {
-    fn default() -> Self {
-        Self::ForSize(4)
-    }
-}
-
 #[cfg(test)]
 mod test {
     use bytes::Bytes;
@@ -211,6 +196,46 @@ mod test {
         assert!(next.is_none());
     }
 
+    #[test]
+    fn frames_are_slices_of_chunk() {
+        let source = Bytes::from_static(&[5, 0, 0, 0, 1, 6, 0, 0, 0, 0, 0]);
+        let mut bson = BsonObjects::new(stream::once(Ok(source.clone())).boxed());
+
+        let Some(Ok(bytes)) = future::block_on(async { bson.next().await }) else {
+            panic!("Expected BSON object");
+        };
+        assert_eq!(bytes.as_ptr(), source.as_ptr());
+
+        let Some(Ok(bytes)) = future::block_on(async { bson.next().await }) else {
+            panic!("Expected BSON object");
+        };
+        assert_eq!(bytes.as_ptr(), source[5..].as_ptr());
+    }
+
+    #[test]
+    fn frames_across_chunks() {
+        let mut bson = BsonObjects::new(
+            stream::iter(vec![
+                Ok(Bytes::from_static(&[5, 0])),
+                Ok(Bytes::from_static(&[])),
+                Ok(Bytes::from_static(&[0, 0, 1, 7, 0, 0, 0, 1])),
+                Ok(Bytes::from_static(&[2])),
+                Ok(Bytes::from_static(&[0, 5, 0, 0, 0, 0])),
+            ])
+            .boxed(),
+        );
+
+        let mut frames = vec![];
+        while let Some(frame) = future::block_on(async { bson.next().await }) {
+            frames.push(frame.unwrap());
+        }
+
+        assert_eq!(frames.len(), 3);
+        assert_eq!(&frames[0], &[5, 0, 0, 0, 1][..]);
+        assert_eq!(&frames[1], &[7, 0, 0, 0, 1, 2, 0][..]);
+        assert_eq!(&frames[2], &[5, 0, 0, 0, 0][..]);
+    }
+
     #[test]
     fn invalid_bson_size() {
         let source: [u8; _] = [3, 0, 0, 0];
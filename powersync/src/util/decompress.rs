@@ -0,0 +1,246 @@
+use crate::{
+    error::{PowerSyncError, RawPowerSyncError},
+    http::ResponseStream,
+};
+
+#[cfg(any(feature = "gzip", feature = "zstd"))]
+use decoder::{Decoder, Decompressed};
+
+/// A `Content-Encoding` of sync responses that the SDK can decompress.
+///
+/// Supported encodings depend on the `gzip` and `zstd` features of this crate.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum ContentEncoding {
+    Identity,
+    #[cfg(feature = "gzip")]
+    Gzip,
+    #[cfg(feature = "zstd")]
+    Zstd,
+}
+
+impl ContentEncoding {
+    /// The `Accept-Encoding` header to send for sync requests, or [None] if no compression
+    /// features are enabled.
+    pub const ACCEPT: Option<&'static str> = if cfg!(all(feature = "gzip", feature = "zstd")) {
+        Some("zstd, gzip")
+    } else if cfg!(feature = "zstd") {
+        Some("zstd")
+    } else if cfg!(feature = "gzip") {
+        Some("gzip")
+    } else {
+        None
+    };
+
+    /// Parses the `Content-Encoding` header of a response.
+    pub fn from_header(value: Option<&str>) -> Result<Self, PowerSyncError> {
+        Ok(match value.map(str::trim) {
+            None | Some("") | Some("identity") => Self::Identity,
+            #[cfg(feature = "gzip")]
+            Some("gzip") | Some("x-gzip") => Self::Gzip,
+            #[cfg(feature = "zstd")]
+            Some("zstd") => Self::Zstd,
+            Some(_) => {
+                return Err(RawPowerSyncError::SyncServiceResponseParsing {
+                    desc: "Unsupported content encoding",
+                }
+                .into());
+            }
+        })
+    }
+
+    /// Wraps a response body with this encoding into a stream of decompressed chunks.
+    pub fn decode(self, body: ResponseStream) -> Result<ResponseStream, PowerSyncError> {
+        Ok(match self {
+            Self::Identity => body,
+            #[cfg(feature = "gzip")]
+            Self::Gzip => Decompressed::new(
+                body,
+                Decoder::Gzip(flate2::write::GzDecoder::new(Vec::new())),
+            ),
+            #[cfg(feature = "zstd")]
+            Self::Zstd => Decompressed::new(
+                body,
+                Decoder::Zstd(
+                    zstd::stream::write::Decoder::new(Vec::new())
+                        .map_err(RawPowerSyncError::from)?,
+                ),
+            ),
+        })
+    }
+}
+
+/// Decoders are only compiled with a compression feature, since only the identity encoding exists
+/// otherwise.
+#[cfg(any(feature = "gzip", feature = "zstd"))]
+mod decoder {
+    use std::io::{self, Write};
+    use std::pin::Pin;
+    use std::task::{Context, Poll};
+
+    use bytes::Bytes;
+    use futures_lite::{Stream, ready};
+
+    use crate::{
+        error::{PowerSyncError, RawPowerSyncError},
+        http::ResponseStream,
+    };
+
+    /// A push-based decoder writing decompressed data into a buffer.
+    pub(super) enum Decoder {
+        #[cfg(feature = "gzip")]
+        Gzip(flate2::write::GzDecoder<Vec<u8>>),
+        #[cfg(feature = "zstd")]
+        Zstd(zstd::stream::write::Decoder<'static, Vec<u8>>),
+    }
+
+    impl Decoder {
+        fn write(&mut self, chunk: &[u8]) -> io::Result<Bytes> {
+            match self {
+                #[cfg(feature = "gzip")]
+                Self::Gzip(decoder) => {
+                    decoder.write_all(chunk)?;
+                    Ok(std::mem::take(decoder.get_mut()).into())
+                }
+                #[cfg(feature = "zstd")]
+                Self::Zstd(decoder) => {
+                    decoder.write_all(chunk)?;
+                    decoder.flush()?;
+                    Ok(std::mem::take(decoder.get_mut()).into())
+                }
+            }
+        }
+
+        fn finish(self) -> io::Result<Bytes> {
+            match self {
+                #[cfg(feature = "gzip")]
+                Self::Gzip(decoder) => Ok(decoder.finish()?.into()),
+                #[cfg(feature = "zstd")]
+                Self::Zstd(mut decoder) => {
+                    decoder.flush()?;
+                    Ok(decoder.into_inner().into())
+                }
+            }
+        }
+    }
+
+    /// A [Stream] of decompressed chunks of a response body.
+    ///
+    /// Decompressed chunks are emitted as soon as they're available, so that the line splitters
+    /// reading from this stream can forward sync lines without waiting for the full response.
+    pub(super) struct Decompressed {
+        inner: ResponseStream,
+        /// The decoder, or [None] after the inner stream has ended.
+        decoder: Option<Decoder>,
+    }
+
+    impl Decompressed {
+        pub(super) fn new(inner: ResponseStream, decoder: Decoder) -> ResponseStream {
+            Box::pin(Self {
+                inner,
+                decoder: Some(decoder),
+            })
+        }
+    }
+
+    impl Stream for Decompressed {
+        type Item = Result<Bytes, PowerSyncError>;
+
+        fn poll_next(mut self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<Option<Self::Item>> {
+            let this = &mut *self;
+
+            loop {
+                let Some(decoder) = &mut this.decoder else {
+                    return Poll::Ready(None);
+                };
+
+                let decompressed = match ready!(this.inner.as_mut().poll_next(cx)) {
+                    Some(Ok(chunk)) => decoder.write(&chunk),
+                    Some(Err(e)) => return Poll::Ready(Some(Err(e))),
+                    None => {
+                        let decoder = this.decoder.take().unwrap();
+                        decoder.finish()
+                    }
+                };
+
+                match decompressed {
+                    Ok(decompressed) if decompressed.is_empty() => {
+                        // The chunk didn't complete a block, wait for more data. After the end of the
+                        // response, the next iteration returns None.
+                        continue;
+                    }
+                    result => {
+                        return Poll::Ready(Some(
+                            result.map_err(|e| RawPowerSyncError::from(e).into()),
+                        ));
+                    }
+                }
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod test {
+    use super::ContentEncoding;
+
+    #[cfg(any(feature = "gzip", feature = "zstd"))]
+    fn sync_lines() -> String {
+        (0..1000).map(|i| format!("{{\"line\":{i}}}\n")).collect()
+    }
+
+    /// Decodes a compressed body delivered in small chunks, like a network stream would.
+    #[cfg(any(feature = "gzip", feature = "zstd"))]
+    fn decode_chunked(header: &str, compressed: &[u8]) -> Vec<u8> {
+        use bytes::Bytes;
+        use futures_lite::{StreamExt, future, stream};
+
+        let chunks: Vec<_> = compressed
+            .chunks(7)
+            .map(|chunk| Ok(Bytes::copy_from_slice(chunk)))
+            .collect();
+        let encoding = ContentEncoding::from_header(Some(header)).unwrap();
+        let mut decoded = encoding.decode(Box::pin(stream::iter(chunks))).unwrap();
+
+        let mut output = Vec::new();
+        future::block_on(async {
+            while let Some(chunk) = decoded.next().await {
+                let chunk = chunk.unwrap();
+                assert!(!chunk.is_empty());
+                output.extend_from_slice(&chunk);
+            }
+        });
+        output
+    }
+
+    #[cfg(feature = "gzip")]
+    #[test]
+    fn decompresses_chunked_gzip() {
+        use flate2::{Compression, write::GzEncoder};
+        use std::io::Write;
+
+        let lines = sync_lines();
+        let mut encoder = GzEncoder::new(Vec::new(), Compression::default());
+        encoder.write_all(lines.as_bytes()).unwrap();
+        let compressed = encoder.finish().unwrap();
+
+        assert_eq!(decode_chunked("gzip", &compressed), lines.as_bytes());
+    }
+
+    #[cfg(feature = "zstd")]
+    #[test]
+    fn decompresses_chunked_zstd() {
+        let lines = sync_lines();
+        let compressed = zstd::encode_all(lines.as_bytes(), 0).unwrap();
+
+        assert_eq!(decode_chunked("zstd", &compressed), lines.as_bytes());
+    }
+
+    #[test]
+    fn rejects_unknown_encoding() {
+        assert!(ContentEncoding::from_header(Some("br")).is_err());
+        assert_eq!(
+            ContentEncoding::from_header(None).unwrap(),
+            ContentEncoding::Identity
+        );
+    }
+}
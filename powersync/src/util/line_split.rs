@@ -1,18 +1,30 @@
 use crate::error::{PowerSyncError, RawPowerSyncError};
 use crate::http::ResponseStream;
+use bytes::{Bytes, BytesMut};
 use futures_lite::{Stream, StreamExt};
-use std::mem;
+use std::fmt::Debug;
 use std::pin::Pin;
+use std::str::Utf8Error;
 use std::task::{Context, Poll, ready};
 
+/// A [Stream] splitting an underlying [ResponseStream] into lines of text.
+///
+/// Each received chunk is only scanned for newlines once. Lines that are fully contained in a
+/// chunk are emitted as slices of that chunk without copying, only lines spanning multiple chunks
+/// are collected into a buffer.
 pub struct LineSplitter {
     stream: Option<ResponseStream>,
-    unfinished_line: Vec<u8>,
+    /// The part of the last chunk received from [Self::stream] that hasn't been scanned yet.
+    current_chunk: Bytes,
+    /// Bytes of a line spanning multiple chunks that have been received so far.
+    ///
+    /// These have already been scanned and don't contain a newline.
+    unfinished_line: BytesMut,
 }
 
 impl LineSplitter {
-    fn emit_line(line: Vec<u8>) -> Poll<Option<Result<String, PowerSyncError>>> {
-        Poll::Ready(Some(String::from_utf8(line).map_err(|_| {
+    fn emit_line(line: Bytes) -> Poll<Option<Result<Utf8Bytes, PowerSyncError>>> {
+        Poll::Ready(Some(Utf8Bytes::try_from(line).map_err(|_| {
             RawPowerSyncError::SyncServiceResponseParsing {
                 desc: "Expected text lines, but got utf-8 decoding error.",
             }
@@ -25,51 +37,97 @@ impl From<ResponseStream> for LineSplitter {
     fn from(value: ResponseStream) -> Self {
         Self {
             stream: Some(value),
-            unfinished_line: Default::default(),
+            current_chunk: Bytes::new(),
+            unfinished_line: BytesMut::new(),
         }
     }
 }
 
 impl Stream for LineSplitter {
-    type Item = Result<String, PowerSyncError>;
+    type Item = Result<Utf8Bytes, PowerSyncError>;
 
     fn poll_next(mut self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<Option<Self::Item>> {
         let this: &mut LineSplitter = &mut self;
 
         loop {
-            if let Some(idx) = this.unfinished_line.iter().position(|b| *b == b'\n') {
+            if !this.current_chunk.is_empty() {
+                let Some(idx) = memchr::memchr(b'\n', &this.current_chunk) else {
+                    // The line continues in the next chunk.
+                    this.unfinished_line.extend_from_slice(&this.current_chunk);
+                    this.current_chunk.clear();
+                    continue;
+                };
+
                 // Split into line including the \n, and the rest
-                let remainder = this.unfinished_line.split_off(idx + 1);
-                let mut completed_line = mem::replace(&mut this.unfinished_line, remainder);
+                let mut line = this.current_chunk.split_to(idx + 1);
                 // Remove \n from the completed line.
-                completed_line.pop();
-
-                return Self::emit_line(completed_line);
+                line.truncate(idx);
+
+                return Self::emit_line(if this.unfinished_line.is_empty() {
+                    line
+                } else {
+                    this.unfinished_line.extend_from_slice(&line);
+                    this.unfinished_line.split().freeze()
+                });
             }
 
             let Some(stream) = &mut this.stream else {
                 return Poll::Ready(None);
             };
 
-            let buffer = match ready!(stream.poll_next(cx)) {
+            match ready!(stream.poll_next(cx)) {
                 None => {
                     this.stream = None;
-                    return Poll::Ready(if this.unfinished_line.is_empty() {
-                        None
+                    return if this.unfinished_line.is_empty() {
+                        Poll::Ready(None)
                     } else {
                         // End of stream, but we had a pending line. Emit that now.
-                        return Self::emit_line(mem::take(&mut this.unfinished_line));
-                    });
+                        Self::emit_line(this.unfinished_line.split().freeze())
+                    };
                 }
                 Some(event) => match event {
                     Err(e) => return Poll::Ready(Some(Err(e))),
-                    Ok(bytes) => bytes,
+                    Ok(bytes) => this.current_chunk = bytes,
                 },
             };
+        }
+    }
+}
 
-            this.unfinished_line.extend(&buffer);
+/// [Bytes] that are known to be valid UTF-8.
+#[derive(Clone, PartialEq, Eq)]
+pub struct Utf8Bytes(Bytes);
+
+impl Utf8Bytes {
+    pub fn as_str(&self) -> &str {
+        unsafe {
+            // Safety: The inner bytes are validated when constructing this.
+            std::str::from_utf8_unchecked(&self.0)
         }
     }
+
+    pub fn len(&self) -> usize {
+        self.0.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.0.is_empty()
+    }
+}
+
+impl TryFrom<Bytes> for Utf8Bytes {
+    type Error = Utf8Error;
+
+    fn try_from(value: Bytes) -> Result<Self, Self::Error> {
+        std::str::from_utf8(&value)?;
+        Ok(Self(value))
+    }
+}
+
+impl Debug for Utf8Bytes {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        Debug::fmt(self.as_str(), f)
+    }
 }
 
 #[cfg(test)]
@@ -84,9 +142,9 @@ mod test {
         let mut lines = LineSplitter::from(stream::once(Ok(bytes)).boxed());
 
         let next = future::block_on(async { lines.try_next().await }).unwrap();
-        assert_eq!(next.unwrap(), "hello");
+        assert_eq!(next.unwrap().as_str(), "hello");
         let next = future::block_on(async { lines.try_next().await }).unwrap();
-        assert_eq!(next.unwrap(), "world");
+        assert_eq!(next.unwrap().as_str(), "world");
         let next = future::block_on(async { lines.try_next().await }).unwrap();
         assert!(next.is_none());
     }
@@ -104,7 +162,7 @@ mod test {
         );
 
         let next = future::block_on(async { lines.try_next().await }).unwrap();
-        assert_eq!(next.unwrap(), "café");
+        assert_eq!(next.unwrap().as_str(), "café");
         let next = future::block_on(async { lines.try_next().await }).unwrap();
         assert!(next.is_none());
     }
@@ -121,9 +179,39 @@ mod test {
         );
 
         let next = future::block_on(async { lines.try_next().await }).unwrap();
-        assert_eq!(next.unwrap(), "hello");
+        assert_eq!(next.unwrap().as_str(), "hello");
+        let next = future::block_on(async { lines.try_next().await }).unwrap();
+        assert_eq!(next.unwrap().as_str(), "world");
+        let next = future::block_on(async { lines.try_next().await }).unwrap();
+        assert!(next.is_none());
+    }
+
+    #[test]
+    fn lines_are_slices_of_chunk() {
+        let bytes = Bytes::from_static(b"hello\nworld\n");
+        let mut lines = LineSplitter::from(stream::once(Ok(bytes.clone())).boxed());
+
+        let next = future::block_on(async { lines.try_next().await }).unwrap();
+        assert_eq!(next.unwrap().as_str().as_ptr(), bytes.as_ptr());
+        let next = future::block_on(async { lines.try_next().await }).unwrap();
+        assert_eq!(next.unwrap().as_str().as_ptr(), bytes[6..].as_ptr());
+        let next = future::block_on(async { lines.try_next().await }).unwrap();
+        assert!(next.is_none());
+    }
+
+    #[test]
+    fn long_line_across_many_chunks() {
+        let mut chunks = vec![];
+        for _ in 0..100 {
+            chunks.push(Ok(Bytes::from_static(b"abc")));
+        }
+        chunks.push(Ok(Bytes::from_static(b"\nnext")));
+
+        let mut lines = LineSplitter::from(stream::iter(chunks).boxed());
+        let next = future::block_on(async { lines.try_next().await }).unwrap();
+        assert_eq!(next.unwrap().as_str(), "abc".repeat(100));
         let next = future::block_on(async { lines.try_next().await }).unwrap();
-        assert_eq!(next.unwrap(), "world");
+        assert_eq!(next.unwrap().as_str(), "next");
         let next = future::block_on(async { lines.try_next().await }).unwrap();
         assert!(next.is_none());
     }
@@ -1,14 +1,21 @@
+mod blocking;
 mod bson_split;
+mod decompress;
 mod line_split;
 mod shared_future;
+mod throttle;
 
+pub use blocking::BlockingPool;
 pub use bson_split::BsonObjects;
-pub use line_split::LineSplitter;
+pub use decompress::ContentEncoding;
+pub use line_split::{LineSplitter, Utf8Bytes};
 use serde::de::Error;
 use serde::{Deserialize, Serialize};
 use serde_json::value::to_raw_value;
 use serde_json::{Map, Value, value::RawValue};
 pub use shared_future::SharedFuture;
+pub(crate) use throttle::Throttled;
+pub use throttle::WatchOptions;
 
 /// A variant of [RawValue] that is guaranteed to be a JSON object.
 #[derive(PartialEq, Eq, Debug, Hash)]
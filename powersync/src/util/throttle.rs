@@ -0,0 +1,356 @@
+use std::pin::Pin;
+use std::task::{Context, Poll};
+use std::time::{Duration, Instant};
+
+use futures_lite::Stream;
+use pin_project_lite::pin_project;
+
+use crate::env::Timer;
+
+/// Limits how often a watched table or query emits, trading freshness of results for less work
+/// re-running queries.
+///
+/// By default, watchers emit as soon as they're polled after a write. Options can be combined:
+/// With a [Self::with_debounce] of 100 milliseconds and a [Self::with_max_latency] of one second,
+/// a watcher waits for writes to pause for 100 milliseconds, but never delays a write by more
+/// than a second. Delays are scheduled with the [Timer] of the database's
+/// [crate::env::PowerSyncEnvironment].
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct WatchOptions {
+    min_interval: Option<Duration>,
+    debounce: Option<Duration>,
+    max_latency: Option<Duration>,
+}
+
+impl WatchOptions {
+    /// Emits at most once per `interval`, merging writes made within the interval.
+    pub fn with_min_interval(&mut self, interval: Duration) -> &mut Self {
+        self.min_interval = Some(interval);
+        self
+    }
+
+    /// Waits until no writes have been made for `delay` before emitting (a trailing-edge
+    /// debounce).
+    pub fn with_debounce(&mut self, delay: Duration) -> &mut Self {
+        self.debounce = Some(delay);
+        self
+    }
+
+    /// The maximum time a pending write is delayed by [Self::with_debounce] while further writes
+    /// keep arriving.
+    ///
+    /// This only bounds the debounce delay, so it has no effect without [Self::with_debounce].
+    pub fn with_max_latency(&mut self, latency: Duration) -> &mut Self {
+        self.max_latency = Some(latency);
+        self
+    }
+
+    fn is_immediate(&self) -> bool {
+        self.min_interval.is_none() && self.debounce.is_none()
+    }
+}
+
+pin_project! {
+    /// A [Stream] delaying and merging items of an inner stream according to [WatchOptions].
+    ///
+    /// Items are assumed to be notifications, so only the most recent pending item is emitted.
+    pub(crate) struct Throttled<S: Stream> {
+        #[pin]
+        inner: S,
+        options: WatchOptions,
+        timer: &'static (dyn Timer + Send + Sync),
+        // Whether the next item is emitted without delay, used for initial query results.
+        emit_next_immediately: bool,
+        inner_done: bool,
+        pending: Option<S::Item>,
+        first_pending_at: Option<Instant>,
+        last_pending_at: Option<Instant>,
+        last_emitted_at: Option<Instant>,
+        delay: Option<(Instant, Pin<Box<dyn Future<Output = ()> + Send>>)>,
+    }
+}
+
+impl<S: Stream> Throttled<S> {
+    pub fn new(
+        inner: S,
+        options: WatchOptions,
+        timer: &'static (dyn Timer + Send + Sync),
+        emit_first_immediately: bool,
+    ) -> Self {
+        Self {
+            inner,
+            options,
+            timer,
+            emit_next_immediately: emit_first_immediately,
+            inner_done: false,
+            pending: None,
+            first_pending_at: None,
+            last_pending_at: None,
+            last_emitted_at: None,
+            delay: None,
+        }
+    }
+}
+
+impl<S: Stream> Stream for Throttled<S> {
+    type Item = S::Item;
+
+    fn poll_next(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<Option<Self::Item>> {
+        let mut this = self.project();
+
+        if this.options.is_immediate() {
+            return this.inner.poll_next(cx);
+        }
+
+        loop {
+            // Collect all items that are available right now, keeping the most recent one.
+            while !*this.inner_done {
+                match this.inner.as_mut().poll_next(cx) {
+                    Poll::Ready(Some(item)) => {
+                        let now = Instant::now();
+                        this.first_pending_at.get_or_insert(now);
+                        *this.last_pending_at = Some(now);
+                        *this.pending = Some(item);
+                    }
+                    Poll::Ready(None) => *this.inner_done = true,
+                    Poll::Pending => break,
+                }
+            }
+
+            let Some(first_pending_at) = *this.first_pending_at else {
+                return if *this.inner_done {
+                    Poll::Ready(None)
+                } else {
+                    Poll::Pending
+                };
+            };
+
+            let now = Instant::now();
+            let mut deadline = now;
+            if !*this.emit_next_immediately && !*this.inner_done {
+                if let (Some(debounce), Some(last)) = (this.options.debounce, *this.last_pending_at)
+                {
+                    let mut debounced = last + debounce;
+                    if let Some(latency) = this.options.max_latency {
+                        debounced = debounced.min(first_pending_at + latency);
+                    }
+                    deadline = deadline.max(debounced);
+                }
+                if let (Some(interval), Some(last)) =
+                    (this.options.min_interval, *this.last_emitted_at)
+                {
+                    deadline = deadline.max(last + interval);
+                }
+            }
+
+            if deadline <= now {
+                *this.emit_next_immediately = false;
+                *this.first_pending_at = None;
+                *this.last_pending_at = None;
+                *this.last_emitted_at = Some(now);
+                *this.delay = None;
+                return Poll::Ready(this.pending.take());
+            }
+
+            // Items arriving later can move the deadline, so only reuse a delay with the same
+            // target.
+            if !matches!(this.delay, Some((target, _)) if *target == deadline) {
+                *this.delay = Some((deadline, this.timer.delay_once(deadline - now)));
+            }
+            let (_, delay) = this.delay.as_mut().unwrap();
+
+            match delay.as_mut().poll(cx) {
+                Poll::Ready(()) => {
+                    *this.delay = None;
+                    // Timers may complete slightly early, re-check the deadline.
+                    if Instant::now() < deadline {
+                        *this.emit_next_immediately = true;
+                    }
+                }
+                Poll::Pending => return Poll::Pending,
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod test {
+    use std::pin::Pin;
+    use std::sync::Mutex;
+    use std::thread::sleep;
+    use std::time::Duration;
+
+    use futures_lite::{StreamExt, future, stream};
+
+    use super::{Throttled, WatchOptions};
+    use crate::env::Timer;
+
+    /// A timer completing immediately, which lets tests observe merged items without waiting.
+    struct ImmediateTimer;
+
+    impl Timer for ImmediateTimer {
+        fn delay_once(&self, _duration: Duration) -> Pin<Box<dyn Future<Output = ()> + Send>> {
+            Box::pin(async {})
+        }
+    }
+
+    /// A timer whose delays never complete, recording the requested durations.
+    struct RecordingTimer {
+        delays: Mutex<Vec<Duration>>,
+    }
+
+    impl RecordingTimer {
+        const fn new() -> Self {
+            Self {
+                delays: Mutex::new(Vec::new()),
+            }
+        }
+
+        fn last_delay(&self) -> Option<Duration> {
+            self.delays.lock().unwrap().last().copied()
+        }
+    }
+
+    impl Timer for RecordingTimer {
+        fn delay_once(&self, duration: Duration) -> Pin<Box<dyn Future<Output = ()> + Send>> {
+            self.delays.lock().unwrap().push(duration);
+            Box::pin(future::pending())
+        }
+    }
+
+    /// Asserts that a delay was requested until `expected`, allowing for time passing in the
+    /// test.
+    fn assert_delay(timer: &RecordingTimer, expected: Duration) {
+        let delay = timer.last_delay().expect("should have requested a delay");
+        assert!(delay <= expected, "{delay:?} exceeds {expected:?}");
+        assert!(
+            delay > expected - Duration::from_millis(50),
+            "{delay:?} is too short for {expected:?}"
+        );
+    }
+
+    #[test]
+    fn passes_items_without_options() {
+        let throttled = Throttled::new(
+            stream::iter([1, 2, 3]),
+            WatchOptions::default(),
+            &ImmediateTimer,
+            false,
+        );
+
+        let items: Vec<_> = future::block_on(throttled.collect());
+        assert_eq!(items, [1, 2, 3]);
+    }
+
+    #[test]
+    fn merges_available_items() {
+        let throttled = Throttled::new(
+            stream::iter([1, 2, 3]),
+            *WatchOptions::default().with_debounce(Duration::from_secs(1)),
+            &ImmediateTimer,
+            false,
+        );
+
+        let items: Vec<_> = future::block_on(throttled.collect());
+        assert_eq!(items, [3]);
+    }
+
+    #[test]
+    fn emits_first_item_immediately() {
+        let mut throttled = Throttled::new(
+            stream::iter([1]).chain(stream::pending()),
+            *WatchOptions::default().with_min_interval(Duration::from_secs(3600)),
+            &ImmediateTimer,
+            true,
+        );
+
+        assert_eq!(future::block_on(throttled.next()), Some(1));
+    }
+
+    #[test]
+    fn debounce_waits_for_last_item() {
+        static TIMER: RecordingTimer = RecordingTimer::new();
+        let debounce = Duration::from_millis(500);
+        let (send, receive) = async_channel::unbounded();
+        let mut throttled = Box::pin(Throttled::new(
+            receive,
+            *WatchOptions::default().with_debounce(debounce),
+            &TIMER,
+            false,
+        ));
+
+        send.try_send(1).unwrap();
+        assert!(future::block_on(future::poll_once(throttled.next())).is_none());
+        assert_delay(&TIMER, debounce);
+
+        // Another item restarts the debounce delay.
+        sleep(Duration::from_millis(100));
+        send.try_send(2).unwrap();
+        assert!(future::block_on(future::poll_once(throttled.next())).is_none());
+        assert_delay(&TIMER, debounce);
+        assert_eq!(TIMER.delays.lock().unwrap().len(), 2);
+    }
+
+    #[test]
+    fn max_latency_bounds_debounce() {
+        static TIMER: RecordingTimer = RecordingTimer::new();
+        let latency = Duration::from_millis(500);
+        let (send, receive) = async_channel::unbounded();
+        let mut throttled = Box::pin(Throttled::new(
+            receive,
+            *WatchOptions::default()
+                .with_debounce(Duration::from_secs(3600))
+                .with_max_latency(latency),
+            &TIMER,
+            false,
+        ));
+
+        send.try_send(1).unwrap();
+        assert!(future::block_on(future::poll_once(throttled.next())).is_none());
+        assert_delay(&TIMER, latency);
+
+        // Later items don't extend the deadline past the latency of the first pending item.
+        sleep(Duration::from_millis(100));
+        send.try_send(2).unwrap();
+        assert!(future::block_on(future::poll_once(throttled.next())).is_none());
+        assert!(TIMER.last_delay().unwrap() <= latency - Duration::from_millis(100));
+    }
+
+    #[test]
+    fn min_interval_delays_after_emitting() {
+        static TIMER: RecordingTimer = RecordingTimer::new();
+        let interval = Duration::from_secs(3600);
+        let (send, receive) = async_channel::unbounded();
+        let mut throttled = Box::pin(Throttled::new(
+            receive,
+            *WatchOptions::default().with_min_interval(interval),
+            &TIMER,
+            false,
+        ));
+
+        // Nothing has been emitted yet, so the first item is not delayed.
+        send.try_send(1).unwrap();
+        assert_eq!(
+            future::block_on(future::poll_once(throttled.next())),
+            Some(Some(1))
+        );
+        assert!(TIMER.last_delay().is_none());
+
+        send.try_send(2).unwrap();
+        assert!(future::block_on(future::poll_once(throttled.next())).is_none());
+        assert_delay(&TIMER, interval);
+    }
+
+    #[test]
+    fn max_latency_requires_debounce() {
+        let throttled = Throttled::new(
+            stream::iter([1, 2, 3]),
+            *WatchOptions::default().with_max_latency(Duration::from_secs(1)),
+            &ImmediateTimer,
+            false,
+        );
+
+        let items: Vec<_> = future::block_on(throttled.collect());
+        assert_eq!(items, [1, 2, 3]);
+    }
+}
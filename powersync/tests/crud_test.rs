@@ -67,7 +67,7 @@ fn include_old_values() {
 
         let batch = db.next_crud_transaction().await.unwrap().unwrap();
         assert_eq!(
-            serde_json::to_string(&batch.crud[0].previous_values).unwrap(),
+            serde_json::to_string(&batch.crud[0].parsed_previous_values().unwrap()).unwrap(),
             "{\"content\":\"content\",\"name\":\"entry\"}"
         );
     })
@@ -111,7 +111,7 @@ fn include_old_values_with_filter() {
 
         let batch = db.next_crud_transaction().await.unwrap().unwrap();
         assert_eq!(
-            serde_json::to_string(&batch.crud[0].previous_values).unwrap(),
+            serde_json::to_string(&batch.crud[0].parsed_previous_values().unwrap()).unwrap(),
             "{\"name\":\"entry\"}"
         );
     })
@@ -152,7 +152,7 @@ fn include_old_values_when_changed() {
 
         let batch = db.next_crud_transaction().await.unwrap().unwrap();
         assert_eq!(
-            serde_json::to_string(&batch.crud[0].previous_values).unwrap(),
+            serde_json::to_string(&batch.crud[0].parsed_previous_values().unwrap()).unwrap(),
             "{\"name\":\"entry\"}"
         );
     })
@@ -265,6 +265,119 @@ fn crud_transactions() {
     });
 }
 
+#[test]
+fn crud_transaction_with_gaps() {
+    future::block_on(async move {
+        let test = DatabaseTest::new();
+        let db = test.in_memory_database();
+
+        {
+            let mut writer = db.writer().await.unwrap();
+            let tx = writer.transaction().unwrap();
+            for _ in 0..3 {
+                tx.execute("INSERT INTO users (id) VALUES (uuid())", params![])
+                    .unwrap();
+            }
+            tx.commit().unwrap();
+
+            // Transactions don't have to consist of adjacent ids.
+            writer
+                .execute("DELETE FROM ps_crud WHERE id = 2", params![])
+                .unwrap();
+        }
+        execute(&db, "INSERT INTO users (id) VALUES (uuid())", params![]).await;
+
+        let tx = db.next_crud_transaction().await.unwrap().unwrap();
+        assert_eq!(tx.crud.len(), 2);
+        assert_eq!(tx.last_item_id, 3);
+    });
+}
+
+#[test]
+fn crud_transactions_without_tx_id() {
+    future::block_on(async move {
+        let test = DatabaseTest::new();
+        let db = test.in_memory_database();
+
+        for _ in 0..2 {
+            execute(&db, "INSERT INTO users (id) VALUES (uuid())", params![]).await;
+        }
+        execute(&db, "UPDATE ps_crud SET tx_id = NULL", params![]).await;
+
+        // Entries without a transaction id are not merged into a single transaction.
+        let tx = db.next_crud_transaction().await.unwrap().unwrap();
+        assert_eq!(tx.crud.len(), 1);
+        assert_eq!(tx.id, None);
+        tx.complete().await.unwrap();
+
+        let tx = db.next_crud_transaction().await.unwrap().unwrap();
+        assert_eq!(tx.crud.len(), 1);
+        assert_eq!(tx.id, None);
+    });
+}
+
+#[test]
+fn crud_batches_without_tx_id() {
+    future::block_on(async move {
+        let test = DatabaseTest::new();
+        let db = test.in_memory_database();
+
+        for _ in 0..3 {
+            execute(&db, "INSERT INTO users (id) VALUES (uuid())", params![]).await;
+        }
+        execute(&db, "UPDATE ps_crud SET tx_id = NULL", params![]).await;
+
+        // Each entry without a transaction id is a transaction of its own, so batches can end
+        // between them.
+        let batch = db.next_crud_batch(2, usize::MAX).await.unwrap().unwrap();
+        assert_eq!(batch.crud.len(), 2);
+        assert!(batch.has_more);
+    });
+}
+
+#[test]
+fn crud_batches() {
+    async fn create_transaction(db: &PowerSyncDatabase, amount: usize) {
+        let mut writer = db.writer().await.unwrap();
+        let writer = writer.transaction().unwrap();
+
+        for _ in 0..amount {
+            writer
+                .execute("INSERT INTO users (id) VALUES (uuid())", params![])
+                .unwrap();
+        }
+
+        writer.commit().unwrap();
+    }
+
+    future::block_on(async move {
+        let test = DatabaseTest::new();
+        let db = test.in_memory_database();
+
+        create_transaction(&db, 5).await;
+        create_transaction(&db, 10).await;
+        create_transaction(&db, 15).await;
+
+        // Transactions are never split, so the second one doesn't fit.
+        let batch = db.next_crud_batch(10, usize::MAX).await.unwrap().unwrap();
+        assert_eq!(batch.crud.len(), 5);
+        assert!(batch.has_more);
+
+        let batch = db.next_crud_batch(20, usize::MAX).await.unwrap().unwrap();
+        assert_eq!(batch.crud.len(), 15);
+        assert!(batch.has_more);
+        batch.complete().await.unwrap();
+
+        // The first transaction is included even if it exceeds limits.
+        let batch = db.next_crud_batch(1, 1).await.unwrap().unwrap();
+        assert_eq!(batch.crud.len(), 15);
+        assert!(!batch.has_more);
+        batch.complete().await.unwrap();
+
+        assert!(db.next_crud_batch(100, usize::MAX).await.unwrap().is_none());
+    });
+}
+
 #[test]
 fn raw_table_clear() {
     future::block_on(async move {
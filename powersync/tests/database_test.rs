@@ -1,12 +1,15 @@
+use std::pin::pin;
 use std::sync::Arc;
+use std::time::Duration;
 
 use async_oneshot::oneshot;
 use futures_lite::{StreamExt, future};
-use powersync::PowerSyncDatabase;
+use powersync::env::{HostLimits, PowerSyncEnvironment, PowerSyncHost};
 use powersync::error::PowerSyncError;
 use powersync::schema::{Column, Schema, Table};
-use powersync_test_utils::{DatabaseTest, UserRow, execute, query_all};
-use rusqlite::params;
+use powersync::{ConnectionPool, LeasedConnection, PoolOptions, PowerSyncDatabase, TempStore};
+use powersync_test_utils::{DatabaseTest, DisabledTimer, UserRow, execute, query_all};
+use rusqlite::{Connection, params};
 use serde_json::value::RawValue;
 use serde_json::{Value, json};
 
@@ -87,6 +90,69 @@ fn test_concurrent_reads() {
     });
 }
 
+#[test]
+fn test_configured_pool() {
+    let test = DatabaseTest::new();
+    let db = test.test_dir_database_with(
+        PoolOptions::default()
+            .with_reader_cache_size_kib(1024)
+            .with_temp_store(TempStore::Memory),
+    );
+
+    future::block_on(async {
+        let reader = db.reader().await.unwrap();
+        let cache_size: i64 = reader
+            .query_row("PRAGMA cache_size", params![], |row| row.get(0))
+            .unwrap();
+        assert_eq!(cache_size, -1024);
+
+        let temp_store: i64 = reader
+            .query_row("PRAGMA temp_store", params![], |row| row.get(0))
+            .unwrap();
+        assert_eq!(temp_store, 2);
+    });
+}
+
+#[test]
+fn test_adaptive_readers() {
+    let test = DatabaseTest::new();
+    PowerSyncEnvironment::powersync_auto_extension().unwrap();
+    let pool = ConnectionPool::open_with(
+        test.dir.path().join("test.db"),
+        PoolOptions::default()
+            .with_readers(3)
+            .with_adaptive_readers(Duration::ZERO),
+    )
+    .unwrap();
+    let env =
+        PowerSyncEnvironment::custom(test.http.clone().client(), pool.clone(), &DisabledTimer);
+    let db = PowerSyncDatabase::new(env, DatabaseTest::default_schema());
+
+    future::block_on(async {
+        // Readers are opened on demand, so all of them can be used concurrently.
+        let mut readers = vec![];
+        for _ in 0..3 {
+            readers.push(db.reader().await.unwrap());
+        }
+        for reader in &readers {
+            let _: i64 = reader
+                .query_row("SELECT 1", params![], |row| row.get(0))
+                .unwrap();
+        }
+        drop(readers);
+        assert_eq!(pool.open_readers(), 3);
+
+        // Idle readers are closed again, but one is always kept around.
+        for _ in 0..3 {
+            let reader = db.reader().await.unwrap();
+            let _: i64 = reader
+                .query_row("SELECT 1", params![], |row| row.get(0))
+                .unwrap();
+        }
+        assert_eq!(pool.open_readers(), 1);
+    });
+}
+
 #[test]
 fn test_table_updates() {
     let test = DatabaseTest::new();
@@ -236,6 +302,130 @@ fn test_watch_statement() {
     });
 }
 
+#[test]
+fn test_watch_table_rows() {
+    let test = DatabaseTest::new();
+    let db =
+        Arc::new(test.test_dir_database_with(PoolOptions::default().with_row_update_tracking()));
+
+    future::block_on(async move {
+        execute(
+            &db,
+            "INSERT INTO users (id, name) VALUES ('a', ?), ('b', ?)",
+            params!["Test", "Test2"],
+        )
+        .await;
+        let mut stream = db
+            .watch_table_rows(false, ["users"], |row| row.id == "a")
+            .boxed_local();
+
+        // Writes to other rows don't emit events.
+        execute(&db, "UPDATE users SET name = 'x' WHERE id = 'b'", params![]).await;
+        assert!(future::poll_once(stream.next()).await.is_none());
+
+        execute(&db, "UPDATE users SET name = 'x' WHERE id = 'a'", params![]).await;
+        assert_eq!(stream.next().await, Some(()));
+
+        // Replacing the row assigns a new rowid, which must not matter for filters.
+        execute(
+            &db,
+            "REPLACE INTO ps_data__users (id, data) VALUES ('a', json_object('name', 'y'))",
+            params![],
+        )
+        .await;
+        assert_eq!(stream.next().await, Some(()));
+        execute(&db, "UPDATE users SET name = 'z' WHERE id = 'a'", params![]).await;
+        assert_eq!(stream.next().await, Some(()));
+
+        // Rolled back writes are not reported.
+        {
+            let mut writer = db.writer().await.unwrap();
+            let writer = writer.transaction().unwrap();
+            writer.execute("DELETE FROM users", params![]).unwrap();
+        }
+        assert!(future::poll_once(stream.next()).await.is_none());
+    });
+}
+
+#[test]
+#[cfg(feature = "preupdate_hook")]
+fn test_watch_table_rows_deletes() {
+    let test = DatabaseTest::new();
+    let db =
+        Arc::new(test.test_dir_database_with(PoolOptions::default().with_row_update_tracking()));
+
+    future::block_on(async move {
+        execute(
+            &db,
+            "INSERT INTO users (id, name) VALUES ('a', ?), ('b', ?)",
+            params!["Test", "Test2"],
+        )
+        .await;
+        let mut stream = db
+            .watch_table_rows(false, ["users"], |row| {
+                row.id == "a" && row.kind == powersync::RowUpdateKind::Delete
+            })
+            .boxed_local();
+
+        // Deleted rows are reported with their id.
+        execute(&db, "DELETE FROM users WHERE id = 'b'", params![]).await;
+        assert!(future::poll_once(stream.next()).await.is_none());
+
+        execute(&db, "DELETE FROM users WHERE id = 'a'", params![]).await;
+        assert_eq!(stream.next().await, Some(()));
+    });
+}
+
+#[test]
+fn test_watch_statement_diff() {
+    let test = DatabaseTest::new();
+    let db = Arc::new(test.test_dir_database());
+
+    future::block_on(async move {
+        let mut stream = db
+            .watch_statement_diff(
+                "SELECT id, name FROM users".to_string(),
+                params![],
+                "id",
+                |row| Ok(row.get::<_, String>("name")?),
+            )
+            .boxed_local();
+
+        // Initial query.
+        let diff = stream.next().await.unwrap().unwrap();
+        assert!(diff.is_empty());
+
+        execute(
+            &db,
+            "INSERT INTO users (id, name) VALUES ('a', ?), ('b', ?)",
+            params!["Test", "Test2"],
+        )
+        .await;
+        let diff = stream.next().await.unwrap().unwrap();
+        assert_eq!(diff.added, ["Test", "Test2"]);
+
+        // Writes that don't change results should not emit events.
+        execute(&db, "UPDATE users SET name = name", params![]).await;
+        execute(
+            &db,
+            "UPDATE users SET name = ? WHERE id = 'b'",
+            params!["Updated"],
+        )
+        .await;
+        let diff = stream.next().await.unwrap().unwrap();
+        assert!(diff.added.is_empty());
+        assert_eq!(diff.updated, ["Updated"]);
+        assert!(diff.removed.is_empty());
+
+        execute(&db, "DELETE FROM users WHERE id = 'a'", params![]).await;
+        let diff = stream.next().await.unwrap().unwrap();
+        assert_eq!(
+            diff.removed,
+            [rusqlite::types::Value::Text("a".to_string())]
+        );
+    });
+}
+
 #[test]
 fn test_external_schema() {
     let test = DatabaseTest::new();
@@ -263,3 +453,141 @@ fn test_external_schema() {
         assert_eq!(rows, json!([{"name": "User"}]));
     });
 }
+
+#[test]
+fn skips_unchanged_schema() {
+    let test = DatabaseTest::new();
+    future::block_on(execute(
+        &test.test_dir_database(),
+        "INSERT INTO users (id, name) VALUES (uuid(), ?)",
+        params!["User"],
+    ));
+
+    let pool = ConnectionPool::open(test.dir.path().join("test.db")).unwrap();
+    let open = |schema: Schema| {
+        let env =
+            PowerSyncEnvironment::custom(test.http.clone().client(), pool.clone(), &DisabledTimer);
+        PowerSyncDatabase::new(env, schema)
+    };
+
+    future::block_on(async {
+        // The schema has been applied before, so readers don't have to wait for the writer.
+        let writer = pool.writer().await;
+        let db = open(DatabaseTest::default_schema());
+        let rows = query_all(&db, "SELECT name FROM users", params![]).await;
+        assert_eq!(rows, json!([{"name": "User"}]));
+
+        // A changed schema is applied once the writer is available.
+        let mut schema = DatabaseTest::default_schema();
+        schema
+            .tables
+            .push(Table::create("lists", vec![Column::text("name")], |_| {}));
+        let db = open(schema);
+
+        let mut reader = pin!(db.reader());
+        assert!(future::poll_once(&mut reader).await.is_none());
+        drop(writer);
+
+        let reader = reader.await.unwrap();
+        let lists: i64 = reader
+            .query_row("SELECT count(*) FROM lists", params![], |row| row.get(0))
+            .unwrap();
+        assert_eq!(lists, 0);
+    });
+}
+
+#[test]
+fn test_host_limits_concurrent_writers() {
+    let test = DatabaseTest::new();
+    let host = PowerSyncHost::with_limits(
+        test.http.clone().client(),
+        &DisabledTimer,
+        HostLimits::default().with_max_concurrent_writers(1),
+    );
+    let open = || {
+        PowerSyncEnvironment::powersync_auto_extension().unwrap();
+        let conn = Connection::open_in_memory().unwrap();
+        let env = host.environment(ConnectionPool::single_connection(conn));
+        PowerSyncDatabase::new(env, DatabaseTest::default_schema())
+    };
+    let first = open();
+    let second = open();
+
+    future::block_on(async {
+        // Initialize the second database before the first one takes the only writer permit.
+        drop(second.reader().await.unwrap());
+
+        let writer = first.writer().await.unwrap();
+        let mut waiting = pin!(second.writer());
+        assert!(future::poll_once(&mut waiting).await.is_none());
+
+        drop(writer);
+        waiting.await.unwrap();
+    });
+}
+
+#[test]
+fn snapshot_ignores_concurrent_writes() {
+    let test = DatabaseTest::new();
+    let db = test.test_dir_database();
+
+    future::block_on(async {
+        let count_users = |conn: &LeasedConnection| -> i64 {
+            conn.query_row("SELECT count(*) FROM users", params![], |row| row.get(0))
+                .unwrap()
+        };
+
+        let snapshot = db.snapshot().await?;
+        assert_eq!(count_users(&snapshot), 0);
+
+        let writer = db.writer().await?;
+        writer.execute(
+            "INSERT INTO users (id, name, email) VALUES (uuid(), ?, ?)",
+            params!["steven", "steven@journeyapps.com"],
+        )?;
+        drop(writer);
+
+        // The snapshot doesn't observe the write, but new readers do.
+        assert_eq!(count_users(&snapshot), 0);
+        assert_eq!(count_users(&db.reader().await?), 1);
+
+        drop(snapshot);
+        assert_eq!(count_users(&db.snapshot().await?), 1);
+        Ok::<(), PowerSyncError>(())
+    })
+    .unwrap();
+}
+
+#[test]
+fn watchers_release_shared_snapshots() {
+    let test = DatabaseTest::new();
+    let db = test.test_dir_database_with(PoolOptions::default().with_readers(2));
+
+    future::block_on(async {
+        let mut stream = db
+            .watch_statement(
+                "SELECT count(*) FROM users".to_string(),
+                params![],
+                |stmt, params| Ok(stmt.query_one(params, |row| row.get::<_, i64>(0))?),
+            )
+            .boxed_local();
+        assert_eq!(stream.next().await.unwrap()?, 0);
+
+        execute(
+            &db,
+            "INSERT INTO users (id, name) VALUES (uuid(), ?)",
+            params!["Test"],
+        )
+        .await;
+        assert_eq!(stream.next().await.unwrap()?, 1);
+
+        // The watcher is done with its snapshot, so no reader blocks resetting the WAL.
+        let writer = db.writer().await?;
+        let busy: i64 = writer.query_row("PRAGMA wal_checkpoint(TRUNCATE)", params![], |row| {
+            row.get(0)
+        })?;
+        assert_eq!(busy, 0);
+        Ok::<(), PowerSyncError>(())
+    })
+    .unwrap();
+}
@@ -0,0 +1,44 @@
+/*
+ * Checks the layout of types declared in include/powersync.h on 64-bit targets. The same sizes
+ * and offsets are asserted for the Rust definitions in tests/ffi_test.rs, so that a change to
+ * either side fails CI until both are updated.
+ *
+ * Compile with: cc -std=c11 -fsyntax-only -I powersync/include powersync/tests/ffi/layout.c
+ */
+
+#include <stddef.h>
+
+#include "powersync.h"
+
+_Static_assert(sizeof(PowerSyncCellKind) == 4, "PowerSyncCellKind");
+
+_Static_assert(sizeof(PowerSyncCellValue) == 8, "PowerSyncCellValue");
+
+_Static_assert(sizeof(PowerSyncCell) == 24, "PowerSyncCell");
+_Static_assert(offsetof(PowerSyncCell, kind) == 0, "PowerSyncCell.kind");
+_Static_assert(offsetof(PowerSyncCell, length) == 8, "PowerSyncCell.length");
+_Static_assert(offsetof(PowerSyncCell, value) == 16, "PowerSyncCell.value");
+
+_Static_assert(sizeof(PowerSyncParameters) == 32, "PowerSyncParameters");
+_Static_assert(offsetof(PowerSyncParameters, cells) == 0, "PowerSyncParameters.cells");
+_Static_assert(offsetof(PowerSyncParameters, count) == 8, "PowerSyncParameters.count");
+_Static_assert(offsetof(PowerSyncParameters, data) == 16, "PowerSyncParameters.data");
+_Static_assert(offsetof(PowerSyncParameters, data_length) == 24,
+               "PowerSyncParameters.data_length");
+
+_Static_assert(sizeof(PowerSyncWatchOptions) == 24, "PowerSyncWatchOptions");
+_Static_assert(offsetof(PowerSyncWatchOptions, min_interval_ms) == 0,
+               "PowerSyncWatchOptions.min_interval_ms");
+_Static_assert(offsetof(PowerSyncWatchOptions, debounce_ms) == 8,
+               "PowerSyncWatchOptions.debounce_ms");
+_Static_assert(offsetof(PowerSyncWatchOptions, max_latency_ms) == 16,
+               "PowerSyncWatchOptions.max_latency_ms");
+
+_Static_assert(sizeof(PowerSyncPoll) == 4, "PowerSyncPoll");
+_Static_assert(POWERSYNC_POLL_PENDING == 0 && POWERSYNC_POLL_READY == 1 &&
+                   POWERSYNC_POLL_ERROR == 2 && POWERSYNC_POLL_CLOSED == 3,
+               "PowerSyncPoll values");
+_Static_assert(POWERSYNC_CELL_NULL == 0 && POWERSYNC_CELL_INTEGER == 1 &&
+                   POWERSYNC_CELL_REAL == 2 && POWERSYNC_CELL_TEXT == 3 &&
+                   POWERSYNC_CELL_BLOB == 4,
+               "PowerSyncCellKind values");
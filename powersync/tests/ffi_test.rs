@@ -0,0 +1,233 @@
+#![cfg(feature = "ffi")]
+
+use std::ffi::{CStr, c_void};
+use std::ptr::{null, null_mut};
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+use powersync::PowerSyncDatabase;
+use powersync::ffi::crud::*;
+use powersync::ffi::rows::*;
+use powersync::ffi::watch::*;
+use powersync::ffi::*;
+use powersync::schema::{Column, Schema, Table};
+use powersync_test_utils::DatabaseTest;
+
+fn open_database(test: &DatabaseTest) -> *mut PowerSyncDatabase {
+    let db = PowerSyncDatabase::new(test.in_memory(), {
+        let mut schema = Schema::default();
+        schema
+            .tables
+            .push(Table::create("lists", vec![Column::text("name")], |_| {}));
+        schema
+    });
+
+    database_into_raw(db)
+}
+
+/// Reads the text of a cell in `rows`.
+unsafe fn cell_text<'a>(rows: *const PowerSyncRows, cell: &PowerSyncCell) -> &'a str {
+    assert_eq!(cell.kind, PowerSyncCellKind::TEXT);
+    let data = unsafe { powersync_rows_data(rows).add(cell.value.offset) };
+    unsafe { CStr::from_ptr(data.cast()) }.to_str().unwrap()
+}
+
+unsafe fn execute(db: *const PowerSyncDatabase, sql: &CStr) {
+    assert!(unsafe { powersync_execute(db, sql.as_ptr(), null(), null_mut()) });
+}
+
+#[test]
+fn query_with_parameters() {
+    let test = DatabaseTest::new();
+    let db = open_database(&test);
+
+    let data = b"hello";
+    let params = [PowerSyncCell {
+        kind: PowerSyncCellKind::TEXT,
+        length: data.len(),
+        value: PowerSyncCellValue { offset: 0 },
+    }];
+    let params = PowerSyncParameters {
+        cells: params.as_ptr(),
+        count: params.len(),
+        data: data.as_ptr(),
+        data_length: data.len(),
+    };
+
+    unsafe {
+        let mut rows = null_mut();
+        assert!(powersync_query(
+            db,
+            c"SELECT ? AS greeting, 42 AS answer".as_ptr(),
+            &params,
+            &mut rows,
+            null_mut()
+        ));
+
+        assert_eq!(powersync_rows_column_count(rows), 2);
+        assert_eq!(powersync_rows_row_count(rows), 1);
+        assert_eq!(
+            cell_text(rows, &*powersync_rows_column_names(rows)),
+            "greeting"
+        );
+
+        let cells = powersync_rows_cells(rows);
+        assert_eq!(cell_text(rows, &*cells), "hello");
+        assert_eq!((*cells.add(1)).value.integer, 42);
+
+        powersync_rows_free(rows);
+        powersync_database_free(db);
+    }
+}
+
+#[test]
+fn reports_errors() {
+    let test = DatabaseTest::new();
+    let db = open_database(&test);
+
+    unsafe {
+        let mut error = null_mut();
+        assert!(!powersync_execute(
+            db,
+            c"SELECT * FROM does_not_exist".as_ptr(),
+            null(),
+            &mut error
+        ));
+        assert!(!error.is_null());
+        powersync_string_free(error);
+
+        powersync_database_free(db);
+    }
+}
+
+unsafe extern "C" fn count_wakeups(context: *mut c_void) {
+    let counter = unsafe { &*context.cast::<AtomicUsize>() };
+    counter.fetch_add(1, Ordering::SeqCst);
+}
+
+#[test]
+fn watch_statement() {
+    let test = DatabaseTest::new();
+    let db = open_database(&test);
+    let wakeups = AtomicUsize::new(0);
+
+    unsafe {
+        let mut watch = null_mut();
+        assert!(powersync_watch_statement(
+            db,
+            c"SELECT name FROM lists".as_ptr(),
+            null(),
+            null(),
+            count_wakeups,
+            (&raw const wakeups).cast_mut().cast(),
+            &mut watch,
+            null_mut(),
+        ));
+
+        let mut rows = null_mut();
+        assert_eq!(
+            powersync_watch_poll(watch, &mut rows, null_mut()),
+            PowerSyncPoll::Ready
+        );
+        assert_eq!(powersync_rows_row_count(rows), 0);
+        powersync_rows_free(rows);
+        assert_eq!(
+            powersync_watch_poll(watch, &mut rows, null_mut()),
+            PowerSyncPoll::Pending
+        );
+
+        execute(db, c"INSERT INTO lists (id, name) VALUES (uuid(), 'list')");
+        assert!(wakeups.load(Ordering::SeqCst) > 0);
+
+        assert_eq!(
+            powersync_watch_poll(watch, &mut rows, null_mut()),
+            PowerSyncPoll::Ready
+        );
+        assert_eq!(powersync_rows_row_count(rows), 1);
+        assert_eq!(cell_text(rows, &*powersync_rows_cells(rows)), "list");
+        powersync_rows_free(rows);
+
+        powersync_watch_free(watch);
+        powersync_database_free(db);
+    }
+}
+
+#[test]
+fn crud_batch() {
+    let test = DatabaseTest::new();
+    let db = open_database(&test);
+
+    unsafe {
+        execute(db, c"INSERT INTO lists (id, name) VALUES ('a', 'list')");
+
+        let mut batch = null_mut();
+        assert!(powersync_crud_batch_next(
+            db,
+            10,
+            1 << 20,
+            &mut batch,
+            null_mut()
+        ));
+        assert!(!batch.is_null());
+        assert!(!powersync_crud_batch_has_more(batch));
+
+        let rows = powersync_crud_batch_entries(batch);
+        assert_eq!(powersync_rows_row_count(rows), 1);
+        let cells = powersync_rows_cells(rows);
+        assert_eq!(cell_text(rows, &*cells.add(2)), "PUT");
+        assert_eq!(cell_text(rows, &*cells.add(3)), "lists");
+        assert_eq!(cell_text(rows, &*cells.add(4)), "a");
+        assert_eq!(cell_text(rows, &*cells.add(6)), r#"{"name":"list"}"#);
+
+        assert!(powersync_crud_batch_complete(batch, null(), null_mut()));
+        powersync_crud_batch_free(batch);
+
+        assert!(powersync_crud_batch_next(
+            db,
+            10,
+            1 << 20,
+            &mut batch,
+            null_mut()
+        ));
+        assert!(batch.is_null());
+
+        powersync_database_free(db);
+    }
+}
+
+/// Keep in sync with `tests/ffi/layout.c`, which asserts the same layout for `powersync.h`.
+#[test]
+#[cfg(target_pointer_width = "64")]
+fn layout_matches_header() {
+    use std::mem::{offset_of, size_of};
+
+    assert_eq!(size_of::<PowerSyncCellKind>(), 4);
+    assert_eq!(size_of::<PowerSyncCellValue>(), 8);
+
+    assert_eq!(size_of::<PowerSyncCell>(), 24);
+    assert_eq!(offset_of!(PowerSyncCell, kind), 0);
+    assert_eq!(offset_of!(PowerSyncCell, length), 8);
+    assert_eq!(offset_of!(PowerSyncCell, value), 16);
+
+    assert_eq!(size_of::<PowerSyncParameters>(), 32);
+    assert_eq!(offset_of!(PowerSyncParameters, cells), 0);
+    assert_eq!(offset_of!(PowerSyncParameters, count), 8);
+    assert_eq!(offset_of!(PowerSyncParameters, data), 16);
+    assert_eq!(offset_of!(PowerSyncParameters, data_length), 24);
+
+    assert_eq!(size_of::<PowerSyncWatchOptions>(), 24);
+    assert_eq!(offset_of!(PowerSyncWatchOptions, min_interval_ms), 0);
+    assert_eq!(offset_of!(PowerSyncWatchOptions, debounce_ms), 8);
+    assert_eq!(offset_of!(PowerSyncWatchOptions, max_latency_ms), 16);
+
+    assert_eq!(size_of::<PowerSyncPoll>(), 4);
+    assert_eq!(PowerSyncPoll::Pending as u32, 0);
+    assert_eq!(PowerSyncPoll::Ready as u32, 1);
+    assert_eq!(PowerSyncPoll::Error as u32, 2);
+    assert_eq!(PowerSyncPoll::Closed as u32, 3);
+
+    assert_eq!(PowerSyncCellKind::NULL.0, 0);
+    assert_eq!(PowerSyncCellKind::INTEGER.0, 1);
+    assert_eq!(PowerSyncCellKind::REAL.0, 2);
+    assert_eq!(PowerSyncCellKind::TEXT.0, 3);
+    assert_eq!(PowerSyncCellKind::BLOB.0, 4);
+}
@@ -1,14 +1,25 @@
+use std::pin::Pin;
+use std::sync::Arc;
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::time::Duration;
+
 use async_task::Task;
+use async_trait::async_trait;
 use futures_lite::{StreamExt, future};
 use powersync::{
+    BackendConnector, DownloadBatchLimits, PersistedDownload, PoolOptions, PowerSyncCredentials,
     PowerSyncDatabase, StreamPriority, StreamSubscription, StreamSubscriptionOptions, SyncOptions,
-    SyncStatusData, error::PowerSyncError,
+    SyncStatusData,
+    env::{BlockingPool, MetricsObserver, Timer},
+    error::PowerSyncError,
 };
 use powersync_test_utils::{
-    DatabaseTest,
-    mock_sync_service::TestConnector,
+    DatabaseTest, execute,
+    mock_sync_service::{PendingSyncResponse, TestConnector, WriteCheckpointResponse},
+    query_all,
     sync_line::{Checkpoint, SyncLine},
 };
+use rusqlite::params;
 use serde_json::json;
 
 struct SyncStreamTest {
@@ -22,6 +33,10 @@ impl SyncStreamTest {
         let test = DatabaseTest::new();
         let db = test.in_memory_database();
 
+        Self::with_database(test, db)
+    }
+
+    fn with_database(test: DatabaseTest, db: PowerSyncDatabase) -> Self {
         let tasks = db.async_tasks().spawn_with(|f| test.ex.spawn(f));
         Self { db, test, tasks }
     }
@@ -66,6 +81,28 @@ impl SyncStreamTest {
         })
         .await
     }
+
+    /// Waits for the client to connect, and then downloads a checkpoint with a single data line
+    /// containing `operations` operations for bucket `a`.
+    ///
+    /// The returned response should be kept alive to avoid the client reconnecting.
+    async fn download_single_checkpoint(&self, operations: i64) -> PendingSyncResponse {
+        let mut oplog_id = 0;
+        let request = self.test.http.receive_requests.recv().await.unwrap();
+        self.wait_for_status(|s| s.is_connected()).await;
+
+        request
+            .send_checkpoint(Checkpoint::single_bucket("a", operations, None))
+            .await;
+        request
+            .bogus_data_line(&mut oplog_id, "a", operations as usize)
+            .await;
+        self.wait_for_progress("a", operations, operations).await;
+
+        request.send_checkpoint_complete(oplog_id, None).await;
+        self.wait_for_status(|s| !s.is_downloading()).await;
+        request
+    }
 }
 
 #[test]
@@ -333,3 +370,388 @@ fn progress_without_priorities() {
         sync.wait_for_status(|s| !s.is_downloading()).await;
     });
 }
+
+#[test]
+fn pipelined_download() {
+    let sync = SyncStreamTest::new();
+    sync.connect_options(|o| o.with_pipelined_download(1024));
+
+    sync.run(async {
+        let mut oplog_id = 0;
+        let request = sync.test.http.receive_requests.recv().await.unwrap();
+        sync.wait_for_status(|s| s.is_connected()).await;
+
+        request
+            .send_checkpoint(Checkpoint::single_bucket("a", 10, None))
+            .await;
+        for _ in 0..10 {
+            request.bogus_data_line(&mut oplog_id, "a", 1).await;
+        }
+        sync.wait_for_progress("a", 10, 10).await;
+
+        request.send_checkpoint_complete(oplog_id, None).await;
+        sync.wait_for_status(|s| !s.is_downloading()).await;
+        assert_eq!(sync.db.status().download_queue_depth().lines, 0);
+    });
+}
+
+#[test]
+fn applies_lines_on_blocking_pool() {
+    let test = DatabaseTest::new();
+    let env = test.in_memory().with_blocking_pool(BlockingPool::new(1));
+    let db = PowerSyncDatabase::new(env, DatabaseTest::default_schema());
+    let sync = SyncStreamTest::with_database(test, db);
+    sync.connect();
+
+    sync.run(sync.download_single_checkpoint(10));
+}
+
+#[test]
+fn reports_metrics() {
+    #[derive(Default)]
+    struct CountingObserver {
+        lines_received: AtomicUsize,
+        lines_applied: AtomicUsize,
+        batches: AtomicUsize,
+        background_writes: AtomicUsize,
+    }
+
+    impl MetricsObserver for CountingObserver {
+        fn line_received(&self, bytes: usize) {
+            assert!(bytes > 0);
+            self.lines_received.fetch_add(1, Ordering::SeqCst);
+        }
+
+        fn line_applied(&self, _duration: Duration) {
+            self.lines_applied.fetch_add(1, Ordering::SeqCst);
+        }
+
+        fn batch_applied(&self, _lines: usize, _bytes: usize, _duration: Duration) {
+            self.batches.fetch_add(1, Ordering::SeqCst);
+        }
+
+        fn writer_wait(&self, background: bool, _wait: Duration) {
+            if background {
+                self.background_writes.fetch_add(1, Ordering::SeqCst);
+            }
+        }
+    }
+
+    let observer = Arc::new(CountingObserver::default());
+    let test = DatabaseTest::new();
+    let env = test.in_memory().with_metrics_observer(observer.clone());
+    let db = PowerSyncDatabase::new(env, DatabaseTest::default_schema());
+    let sync = SyncStreamTest::with_database(test, db);
+    sync.connect();
+
+    sync.run(sync.download_single_checkpoint(10));
+
+    // The checkpoint, data and checkpoint_complete lines.
+    assert_eq!(observer.lines_received.load(Ordering::SeqCst), 3);
+    // Applied events also include starting the iteration and the established connection.
+    assert!(observer.lines_applied.load(Ordering::SeqCst) >= 3);
+    let batches = observer.batches.load(Ordering::SeqCst);
+    assert!(batches > 0);
+    assert!(observer.background_writes.load(Ordering::SeqCst) >= batches);
+}
+
+#[test]
+fn resumes_interrupted_download() {
+    let sync = SyncStreamTest::new();
+    sync.connect();
+
+    sync.run(async {
+        let mut oplog_id = 0;
+        let request = sync.test.http.receive_requests.recv().await.unwrap();
+        sync.wait_for_status(|s| s.is_connected()).await;
+        assert!(sync.db.persisted_download().await.unwrap().is_empty());
+
+        request
+            .send_checkpoint(Checkpoint::single_bucket("a", 20, None))
+            .await;
+        request.bogus_data_line(&mut oplog_id, "a", 10).await;
+        sync.wait_for_progress("a", 10, 20).await;
+
+        // Interrupt the download before the checkpoint completes.
+        sync.db.disconnect().await;
+        drop(request);
+
+        assert_eq!(
+            sync.db.persisted_download().await.unwrap(),
+            PersistedDownload {
+                buckets: 1,
+                operations: 10
+            }
+        );
+    });
+
+    sync.connect();
+    sync.run(async {
+        // The next iteration requests data after the last persisted operation.
+        let request = sync.test.http.receive_requests.recv().await.unwrap();
+        let buckets = request.request_data.get("buckets").unwrap();
+        assert_eq!(buckets, &json!([{"name": "a", "after": "9"}]));
+    });
+}
+
+#[test]
+fn publishes_held_back_progress_after_interval() {
+    /// Completes delays immediately, counting how many have been requested.
+    struct ImmediateTimer {
+        delays: AtomicUsize,
+    }
+
+    impl Timer for ImmediateTimer {
+        fn delay_once(&self, _duration: Duration) -> Pin<Box<dyn Future<Output = ()> + Send>> {
+            self.delays.fetch_add(1, Ordering::SeqCst);
+            Box::pin(async {})
+        }
+    }
+
+    static TIMER: ImmediateTimer = ImmediateTimer {
+        delays: AtomicUsize::new(0),
+    };
+
+    let test = DatabaseTest::new();
+    let env = test.in_memory_with_timer(&TIMER);
+    let db = PowerSyncDatabase::new(env, DatabaseTest::default_schema());
+    let sync = SyncStreamTest::with_database(test, db);
+    sync.connect_options(|o| o.with_status_update_interval(Duration::from_secs(3600)));
+
+    sync.run(async {
+        let mut oplog_id = 0;
+        let request = sync.test.http.receive_requests.recv().await.unwrap();
+        sync.wait_for_status(|s| s.is_connected()).await;
+
+        // Starting to download is a transition and published immediately.
+        request
+            .send_checkpoint(Checkpoint::single_bucket("a", 10, None))
+            .await;
+        sync.wait_for_progress("a", 0, 10).await;
+
+        // Progress is held back, and published by the flush deadline since no further lines
+        // arrive.
+        let delays = TIMER.delays.load(Ordering::SeqCst);
+        request.bogus_data_line(&mut oplog_id, "a", 5).await;
+        sync.wait_for_progress("a", 5, 10).await;
+        assert!(TIMER.delays.load(Ordering::SeqCst) > delays);
+    });
+}
+
+#[test]
+fn connect_only_reconnects_for_changed_options() {
+    let sync = SyncStreamTest::new();
+    let connector: Arc<dyn BackendConnector> = Arc::new(TestConnector);
+    sync.run(sync.db.connect(SyncOptions::from_shared(connector.clone())));
+
+    sync.run(async {
+        let request = sync.test.http.receive_requests.recv().await.unwrap();
+        sync.wait_for_status(|s| s.is_connected()).await;
+
+        // The same connector and download options keep the current sync stream, even if other
+        // options change.
+        let mut same = SyncOptions::from_shared(connector.clone());
+        same.with_retry_delay(Duration::from_secs(10));
+        sync.db.connect(same).await;
+        assert!(!request.channel.is_closed());
+        assert!(sync.test.http.receive_requests.is_empty());
+
+        // Changing how lines are applied requires a new sync stream.
+        let mut changed = SyncOptions::from_shared(connector.clone());
+        changed.with_download_batch_limits(DownloadBatchLimits {
+            max_lines: 1,
+            ..Default::default()
+        });
+        sync.db.connect(changed).await;
+        assert!(request.channel.is_closed());
+        sync.test.http.receive_requests.recv().await.unwrap();
+    });
+}
+
+#[test]
+fn pipelined_upload() {
+    /// Completes local writes one transaction at a time, counting transactions that were
+    /// available without a reader connection.
+    struct CompletingConnector {
+        db: PowerSyncDatabase,
+        uploads: AtomicUsize,
+        prefetched: AtomicUsize,
+    }
+
+    #[async_trait]
+    impl BackendConnector for CompletingConnector {
+        async fn fetch_credentials(&self) -> Result<PowerSyncCredentials, PowerSyncError> {
+            TestConnector.fetch_credentials().await
+        }
+
+        async fn upload_data(&self) -> Result<(), PowerSyncError> {
+            let mut tx = None;
+            if self.uploads.fetch_add(1, Ordering::SeqCst) > 0 {
+                // Hold the only reader, so that only prefetched transactions are available
+                // without waiting.
+                let _reader = self.db.reader().await?;
+                if let Some(prefetched) = future::poll_once(self.db.next_crud_transaction()).await {
+                    self.prefetched.fetch_add(1, Ordering::SeqCst);
+                    tx = prefetched?;
+                }
+            }
+
+            if tx.is_none() {
+                tx = self.db.next_crud_transaction().await?;
+            }
+            if let Some(tx) = tx {
+                tx.complete().await?;
+            }
+            Ok(())
+        }
+    }
+
+    let test = DatabaseTest::new();
+    let db = test.test_dir_database_with(PoolOptions::default().with_readers(1));
+    let sync = SyncStreamTest::with_database(test, db);
+    let (send_checkpoint, receive_checkpoint) = async_channel::unbounded();
+    *sync.test.http.write_checkpoints.lock().unwrap() = Box::new(move || {
+        send_checkpoint.try_send(()).unwrap();
+        WriteCheckpointResponse::new("10".to_string())
+    });
+
+    let connector = Arc::new(CompletingConnector {
+        db: sync.db.clone(),
+        uploads: AtomicUsize::new(0),
+        prefetched: AtomicUsize::new(0),
+    });
+    let mut options = SyncOptions::from_shared(connector.clone());
+    options.with_pipelined_upload();
+    sync.run(sync.db.connect(options));
+
+    sync.run(async {
+        let _request = sync.test.http.receive_requests.recv().await.unwrap();
+        sync.wait_for_status(|s| s.is_connected()).await;
+
+        {
+            // Three transactions, written before the upload actor is notified.
+            let writer = sync.db.writer().await.unwrap();
+            for name in ["a", "b", "c"] {
+                writer
+                    .execute(
+                        "INSERT INTO users (id, name) VALUES (uuid(), ?)",
+                        params![name],
+                    )
+                    .unwrap();
+            }
+        }
+
+        // The write checkpoint is requested after all transactions have been uploaded.
+        receive_checkpoint.recv().await.unwrap();
+        assert_eq!(
+            query_all(&sync.db, "SELECT * FROM ps_crud", params![]).await,
+            json!([])
+        );
+
+        // The second and third transaction were read while the one before was being uploaded.
+        assert_eq!(connector.uploads.load(Ordering::SeqCst), 3);
+        assert_eq!(connector.prefetched.load(Ordering::SeqCst), 2);
+        sync.db.disconnect().await;
+    });
+}
+
+#[test]
+#[cfg(feature = "gzip")]
+fn decompresses_gzip_responses() {
+    use std::io::Write;
+
+    use flate2::{Compression, write::GzEncoder};
+    use powersync_test_utils::mock_sync_service::ResponseCompression;
+
+    struct Gzip(GzEncoder<Vec<u8>>);
+
+    impl ResponseCompression for Gzip {
+        fn content_encoding(&self) -> &'static str {
+            "gzip"
+        }
+
+        fn compress(&mut self, line: &[u8]) -> Vec<u8> {
+            self.0.write_all(line).unwrap();
+            self.0.flush().unwrap();
+            std::mem::take(self.0.get_mut())
+        }
+    }
+
+    let sync = SyncStreamTest::new();
+    *sync.test.http.compression.lock().unwrap() = Some(Box::new(|| {
+        Box::new(Gzip(GzEncoder::new(Vec::new(), Compression::default())))
+    }));
+    sync.connect();
+
+    // Each line is decoded as soon as it arrives, without waiting for the end of the stream.
+    let request = sync.run(sync.download_single_checkpoint(10));
+    assert!(request.accept_encoding.as_deref().unwrap().contains("gzip"));
+}
+
+#[test]
+fn applies_received_lines_in_batches() {
+    #[derive(Default)]
+    struct BatchObserver {
+        lines_received: AtomicUsize,
+        batches: std::sync::Mutex<Vec<usize>>,
+    }
+
+    impl MetricsObserver for BatchObserver {
+        fn line_received(&self, _bytes: usize) {
+            self.lines_received.fetch_add(1, Ordering::SeqCst);
+        }
+
+        fn batch_applied(&self, lines: usize, _bytes: usize, _duration: Duration) {
+            self.batches.lock().unwrap().push(lines);
+        }
+    }
+
+    async fn wait_until(condition: impl Fn() -> bool) {
+        while !condition() {
+            future::yield_now().await;
+        }
+    }
+
+    let observer = Arc::new(BatchObserver::default());
+    let test = DatabaseTest::new();
+    let env = test.in_memory().with_metrics_observer(observer.clone());
+    let db = PowerSyncDatabase::new(env, DatabaseTest::default_schema());
+    let sync = SyncStreamTest::with_database(test, db);
+    sync.connect_options(|o| {
+        o.with_pipelined_download(1024 * 1024);
+        o.with_download_batch_limits(DownloadBatchLimits {
+            max_lines: 4,
+            max_duration: Duration::from_secs(3600),
+            ..Default::default()
+        });
+    });
+
+    sync.run(async {
+        let mut oplog_id = 0;
+        let request = sync.test.http.receive_requests.recv().await.unwrap();
+        sync.wait_for_status(|s| s.is_connected()).await;
+
+        // Hold the writer so that all lines are buffered by the download pipeline before the
+        // client can apply them.
+        let writer = sync.db.writer().await.unwrap();
+        observer.batches.lock().unwrap().clear();
+
+        request
+            .send_checkpoint(Checkpoint::single_bucket("a", 7, None))
+            .await;
+        for _ in 0..7 {
+            request.bogus_data_line(&mut oplog_id, "a", 1).await;
+        }
+        request.send_checkpoint_complete(oplog_id, None).await;
+        wait_until(|| observer.lines_received.load(Ordering::SeqCst) == 9).await;
+        drop(writer);
+
+        // The nine lines are applied in three transactions, limited to four lines each.
+        wait_until(|| observer.batches.lock().unwrap().len() == 3).await;
+        assert_eq!(*observer.batches.lock().unwrap(), [4, 4, 1]);
+        assert_eq!(
+            query_all(&sync.db, "SELECT count(*) AS rows FROM ps_oplog", params![]).await,
+            json!([{"rows": 7}])
+        );
+    });
+}
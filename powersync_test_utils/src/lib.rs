@@ -42,11 +42,22 @@ impl DatabaseTest {
         Self::default()
     }
 
+    /// Creates a test without the verbose logging enabled for tests, e.g. for benchmarks.
+    pub fn quiet() -> Self {
+        let test = Self::new();
+        log::set_max_level(LevelFilter::Warn);
+        test
+    }
+
     pub fn in_test_dir(&self) -> PowerSyncEnvironment {
+        self.in_test_dir_with(&PoolOptions::default())
+    }
+
+    pub fn in_test_dir_with(&self, options: &PoolOptions) -> PowerSyncEnvironment {
         PowerSyncEnvironment::powersync_auto_extension().expect("should load core extension");
 
         let db = self.dir.path().to_path_buf().join("test.db");
-        let pool = ConnectionPool::open(db).expect("should open pool");
+        let pool = ConnectionPool::open_with(db, options).expect("should open pool");
         self.env(pool)
     }
 
@@ -54,11 +65,27 @@ impl DatabaseTest {
         PowerSyncDatabase::new(self.in_test_dir(), Self::default_schema())
     }
 
+    pub fn test_dir_database_with(&self, options: &PoolOptions) -> PowerSyncDatabase {
+        PowerSyncDatabase::new(self.in_test_dir_with(options), Self::default_schema())
+    }
+
     pub fn in_memory(&self) -> PowerSyncEnvironment {
+        self.in_memory_with_timer(&DisabledTimer)
+    }
+
+    /// An in-memory environment scheduling delays with the given `timer`.
+    pub fn in_memory_with_timer(
+        &self,
+        timer: &'static (dyn Timer + Send + Sync),
+    ) -> PowerSyncEnvironment {
         PowerSyncEnvironment::powersync_auto_extension().expect("should load core extension");
         let conn = Connection::open_in_memory().expect("should open connection");
 
-        self.env(ConnectionPool::single_connection(conn))
+        PowerSyncEnvironment::custom(
+            self.http.clone().client(),
+            ConnectionPool::single_connection(conn),
+            timer,
+        )
     }
 
     pub fn in_memory_database(&self) -> PowerSyncDatabase {
@@ -67,18 +94,6 @@ impl DatabaseTest {
 
     fn env(&self, pool: ConnectionPool) -> PowerSyncEnvironment {
         PowerSyncEnvironment::powersync_auto_extension().expect("should load core extension");
-
-        struct DisabledTimer;
-
-        impl Timer for DisabledTimer {
-            fn delay_once(
-                &self,
-                _duration: std::time::Duration,
-            ) -> std::pin::Pin<Box<dyn Future<Output = ()> + Send>> {
-                panic!("Tests should not run into a delay")
-            }
-        }
-
         PowerSyncEnvironment::custom(self.http.clone().client(), pool, &DisabledTimer)
     }
 
@@ -90,6 +105,18 @@ impl DatabaseTest {
     }
 }
 
+/// A [Timer] panicking when used, for tests that should not run into a delay.
+pub struct DisabledTimer;
+
+impl Timer for DisabledTimer {
+    fn delay_once(
+        &self,
+        _duration: std::time::Duration,
+    ) -> std::pin::Pin<Box<dyn Future<Output = ()> + Send>> {
+        panic!("Tests should not run into a delay")
+    }
+}
+
 /// Runs a query and returns rows as a `serde_json` array.
 pub async fn query_all(db: &PowerSyncDatabase, sql: &str, params: impl Params) -> Value {
     let reader = db.reader().await.unwrap();
@@ -18,6 +18,18 @@ pub struct MockSyncService {
     pub receive_requests: async_channel::Receiver<PendingSyncResponse>,
     send_requests: async_channel::Sender<PendingSyncResponse>,
     pub write_checkpoints: Mutex<Box<dyn Fn() -> WriteCheckpointResponse + Send>>,
+    /// If set, creates a [ResponseCompression] for each sync stream response.
+    pub compression: Mutex<Option<Box<dyn Fn() -> Box<dyn ResponseCompression> + Send>>>,
+}
+
+/// Compresses sync lines sent by the [MockSyncService].
+pub trait ResponseCompression: Send {
+    /// The `Content-Encoding` header of compressed responses.
+    fn content_encoding(&self) -> &'static str;
+
+    /// Compresses a sync line, flushing it so that the client can decode it without waiting for
+    /// further lines.
+    fn compress(&mut self, line: &[u8]) -> Vec<u8>;
 }
 
 impl Default for MockSyncService {
@@ -30,6 +42,7 @@ impl Default for MockSyncService {
             write_checkpoints: Mutex::new(Box::new(|| {
                 WriteCheckpointResponse::new("10".to_string())
             })),
+            compression: Mutex::new(None),
         }
     }
 }
@@ -70,19 +83,39 @@ impl MockSyncService {
         let body: serde_json::Value =
             serde_json::from_slice(&req.body.unwrap_or_default()).unwrap();
 
+        let accept_encoding = req
+            .headers
+            .iter()
+            .find(|(name, _)| name.eq_ignore_ascii_case("Accept-Encoding"))
+            .map(|(_, value)| value.to_string());
+        let compression = self
+            .compression
+            .lock()
+            .unwrap()
+            .as_ref()
+            .map(|create| create());
+
         let (send, recv) = async_channel::bounded(1);
         let response = Response {
             status: 200,
+            content_type: Some("application/json".to_string()),
+            content_encoding: compression
+                .as_ref()
+                .map(|compression| compression.content_encoding().to_string()),
             body: ResponseBody {
-                reader: MockSyncLinesResponse { receive: recv }.boxed(),
+                reader: MockSyncLinesResponse {
+                    receive: recv,
+                    compression,
+                }
+                .boxed(),
                 length: None,
             },
-            content_type: Some("application/json".to_string()),
         };
 
         self.send_requests
             .send(PendingSyncResponse {
                 request_data: body,
+                accept_encoding,
                 channel: send,
             })
             .await
@@ -98,6 +131,7 @@ impl MockSyncService {
         Response {
             status: 200,
             content_type: Some("application/json".to_string()),
+            content_encoding: None,
             body: ResponseBody {
                 length: Some(data.len() as u64),
                 reader: stream::once(Ok(data)).boxed(),
@@ -109,6 +143,7 @@ impl MockSyncService {
         Response {
             status: 400,
             content_type: None,
+            content_encoding: None,
             body: ResponseBody {
                 reader: stream::empty().boxed(),
                 length: Some(0),
@@ -119,6 +154,8 @@ impl MockSyncService {
 
 pub struct PendingSyncResponse {
     pub request_data: serde_json::Value,
+    /// The `Accept-Encoding` header of the sync request.
+    pub accept_encoding: Option<String>,
     pub channel: async_channel::Sender<SyncLine<'static>>,
 }
 
@@ -173,6 +210,7 @@ pin_project! {
     struct MockSyncLinesResponse {
         #[pin]
         receive: async_channel::Receiver<SyncLine<'static>>,
+        compression: Option<Box<dyn ResponseCompression>>,
     }
 }
 
@@ -185,6 +223,9 @@ impl Stream for MockSyncLinesResponse {
             let mut writer = Vec::new();
             serde_json::to_writer(&mut writer, &line).unwrap();
             writer.push(b'\n');
+            if let Some(compression) = this.compression {
+                writer = compression.compress(&writer);
+            }
             Ok(Bytes::from(writer))
         });
 